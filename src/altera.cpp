@@ -8,12 +8,14 @@
 #include <string.h>
 
 #include <string>
+#include <vector>
 
 #include "jtag.hpp"
 #include "device.hpp"
 #include "epcq.hpp"
 #include "progressBar.hpp"
 #include "rawParser.hpp"
+#include "usbStats.hpp"
 
 #define IDCODE 6
 #define USER0  0x0C
@@ -75,8 +77,6 @@ void Altera::programMem(RawParser &_bit)
 	int byte_length = _bit.getLength()/8;
 	uint8_t *data = _bit.getData();
 
-	uint32_t clk_period = 1e9/static_cast<float>(_jtag->getClkFreq());
-
 	unsigned char cmd[2];
 	unsigned char tx[864/8], rx[864/8];
 
@@ -90,25 +90,12 @@ void Altera::programMem(RawParser &_bit)
 	_jtag->shiftIR(cmd, NULL, IRLENGTH, Jtag::PAUSE_IR);
 	/* RUNTEST IDLE 12000 TCK ENDSTATE IDLE; */
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000000/clk_period);
+	_jtag->waitUs(1000);
 	/* write */
 	ProgressBar progress("Flash SRAM", byte_length, 50, _quiet);
 
-	int xfer_len = 512;
-	int tx_len;
-	int tx_end;
-
-	for (int i=0; i < byte_length; i+=xfer_len) {
-		if (i + xfer_len > byte_length) {  // last packet with some size
-			tx_len = (byte_length - i) * 8;
-			tx_end = Jtag::EXIT1_DR;
-		} else {
-			tx_len = xfer_len * 8;
-			tx_end = Jtag::SHIFT_DR;
-		}
-		_jtag->shiftDR(data+i, NULL, tx_len, tx_end);
-		progress.display(i);
-	}
+	_jtag->shiftDR_stream(data, byte_length, Jtag::EXIT1_DR,
+		[&progress](uint32_t done) { progress.display(done); });
 	progress.done();
 
 	/* reboot */
@@ -117,7 +104,7 @@ void Altera::programMem(RawParser &_bit)
 	_jtag->shiftIR(cmd, NULL, IRLENGTH, Jtag::PAUSE_IR);
 	/* RUNTEST 60 TCK; */
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(5000/clk_period);
+	_jtag->waitUs(5, 60);
 	/*
 	 * SDR 864 TDI
 	 * (000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000)
@@ -133,7 +120,7 @@ void Altera::programMem(RawParser &_bit)
 	_jtag->shiftIR(cmd, NULL, IRLENGTH, Jtag::PAUSE_IR);
 	/* RUNTEST 49152 TCK; */
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(4099645/clk_period);
+	_jtag->waitUs(4100);
 	/* RUNTEST 512 TCK; */
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
 	_jtag->toggleClk(512);
@@ -143,13 +130,14 @@ void Altera::programMem(RawParser &_bit)
 
 	/* RUNTEST 12000 TCK; */
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000000/clk_period);
+	_jtag->waitUs(1000);
 	/* -> idle */
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
 }
 
 bool Altera::load_bridge()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_BRIDGE);
 	if (_device_package.empty()) {
 		printError("Can't program SPI flash: missing device-package information");
 		return false;
@@ -244,8 +232,8 @@ int Altera::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 	 * one bit
 	 */
 	int xfer_len = len + 1 + ((rx == NULL) ? 0 : 1);
-	uint8_t jtx[xfer_len];
-	uint8_t jrx[xfer_len];
+	std::vector<uint8_t> jtx(xfer_len);
+	std::vector<uint8_t> jrx(xfer_len);
 
 	if (tx != NULL) {
 		for (uint32_t i = 0; i < len; i++)
@@ -253,7 +241,7 @@ int Altera::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 	}
 
 	shiftVIR(RawParser::reverseByte(cmd));
-	shiftVDR(jtx, (rx) ? jrx : NULL, 8 * xfer_len);
+	shiftVDR(jtx.data(), (rx) ? jrx.data() : NULL, 8 * xfer_len);
 
 	if (rx) {
 		for (uint32_t i = 0; i < len; i++) {
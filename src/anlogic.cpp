@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include <stdexcept>
+#include <vector>
 
 #include "anlogic.hpp"
 #include "anlogicBitParser.hpp"
@@ -114,21 +115,8 @@ void Anlogic::program(unsigned int offset, bool unprotect_flash)
 		_jtag->toggleClk(15);
 
 		ProgressBar progress("Loading", len, 50, _quiet);
-		int pos = 0;
-		uint8_t *ptr = data;
-		while (len > 0) {
-			int xfer_len = (len > 512)?512:len;
-			int tx_end;
-			if (len - xfer_len == 0)
-				tx_end = Jtag::RUN_TEST_IDLE;
-			else
-				tx_end = Jtag::SHIFT_DR;
-			_jtag->shiftDR(ptr, NULL, xfer_len * 8, tx_end);
-			len -= xfer_len;
-			progress.display(pos);
-			pos += xfer_len;
-			ptr+=xfer_len;
-		}
+		_jtag->shiftDR_stream(data, len, Jtag::RUN_TEST_IDLE,
+			[&progress](uint32_t done) { progress.display(done); });
 
 		progress.done();
 		_jtag->toggleClk(100);
@@ -194,8 +182,8 @@ int Anlogic::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 	int xfer_len = len + 1;
 	if (rx)
 		xfer_len++;
-	uint8_t jtx[xfer_len];
-	uint8_t jrx[xfer_len];
+	std::vector<uint8_t> jtx(xfer_len);
+	std::vector<uint8_t> jrx(xfer_len);
 
 	jtx[0] = AnlogicBitParser::reverseByte(cmd);
 	if (tx != NULL) {
@@ -207,7 +195,7 @@ int Anlogic::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 	uint8_t op = 0x60;
 	_jtag->shiftDR(&op, NULL, 8);
 
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
+	_jtag->shiftDR(jtx.data(), (rx == NULL)? NULL: jrx.data(), 8*xfer_len);
 	if (rx != NULL) {
 		for (uint32_t i=0; i < len; i++)
 			rx[i] = AnlogicBitParser::reverseByte(jrx[i+1]>>1)
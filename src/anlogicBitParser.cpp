@@ -16,7 +16,9 @@
 #include <vector>
 
 #include "anlogicBitParser.hpp"
+#include "bitOps.hpp"
 #include "display.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -74,6 +76,7 @@ int AnlogicBitParser::parseHeader()
 
 int AnlogicBitParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	int end_header = 0;
 
 	/* parse header */
@@ -106,13 +109,11 @@ int AnlogicBitParser::parse()
 
 
 	_bit_data.clear();
-	for (auto it = blocks.begin(); it != blocks.end(); it++) {
-		for (size_t pos = 0; pos < it->size(); pos++) {
-			if (_reverseOrder == true)
-				_bit_data += reverseByte(((*it)[pos]));
-			else
-				_bit_data += ((*it)[pos]);
-		}
+	for (auto it = blocks.begin(); it != blocks.end(); it++)
+		_bit_data.append(it->begin(), it->end());
+	if (_reverseOrder == true) {
+		uint8_t *data = reinterpret_cast<uint8_t *>(&_bit_data[0]);
+		reverseBytes(data, data, _bit_data.size());
 	}
 	_bit_length = _bit_data.size() * 8;
 
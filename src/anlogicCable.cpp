@@ -13,7 +13,9 @@
 #include <string>
 
 #include "anlogicCable.hpp"
+#include "bitOps.hpp"
 #include "display.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -222,6 +224,7 @@ int AnlogicCable::flush()
 int AnlogicCable::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 {
 	uint8_t buf[512];
+	uint8_t tdi_bits[512];
 	uint8_t mask = (ANLOGICCABLE_TCK_PIN << 4);
 
 	int full_len = len;
@@ -237,12 +240,10 @@ int AnlogicCable::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 		if (!tx) {
 			memset(buf, mask, xfer_len);
 		} else {
-			for (int i = 0; i < xfer_len; i++) {
-				buf[i] = mask;
-				if (tx_ptr[i >> 3] & (1 << (i & 0x07)))
-					buf[i] |= (ANLOGICCABLE_TDI_PIN |
-						(ANLOGICCABLE_TDI_PIN << 4));
-			}
+			expandBits(tdi_bits, tx_ptr, xfer_len);
+			for (int i = 0; i < xfer_len; i++)
+				buf[i] = mask | (tdi_bits[i] & (ANLOGICCABLE_TDI_PIN |
+					(ANLOGICCABLE_TDI_PIN << 4)));
 			tx_ptr += (xfer_len >> 3);
 		}
 
@@ -274,15 +275,19 @@ int AnlogicCable::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 int AnlogicCable::write(uint8_t *in_buf, uint8_t *out_buf, int len, int rd_len)
 {
 	int actual_length;
+	uint64_t start = UsbStats::now();
 	int ret = libusb_bulk_transfer(dev_handle, ANLOGICCABLE_WRITE_EP,
 			in_buf, len, &actual_length, 1000);
+	UsbStats::write(actual_length, start);
 	if (ret < 0) {
 		cerr << "write: usb bulk write failed " << ret << endl;
 		return -EXIT_FAILURE;
 	}
 	/* all write must be followed by a read */
+	start = UsbStats::now();
 	ret = libusb_bulk_transfer(dev_handle, ANLOGICCABLE_READ_EP,
 			in_buf, len, &actual_length, 1000);
+	UsbStats::read(actual_length, start);
 	if (ret < 0) {
 		cerr << "write: usb bulk read failed " << ret << endl;
 		return -EXIT_FAILURE;
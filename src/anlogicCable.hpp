@@ -30,6 +30,10 @@ class AnlogicCable : public JtagInterface {
 	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) override;
 	/* clk */
 	int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override;
+	/* delay: host sleep (one byte by clock cycle) */
+	int waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms) override {
+		return sleepUs(min_us, min_clocks, tms);
+	}
 
 	/*!
 	 * \brief return internal buffer size (in byte).
@@ -0,0 +1,709 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+/*
+ * Host side microbenchmarks (openFPGALoader-bench, BUILD_BENCHMARKS=ON):
+ * bitstream parsers on synthetic inputs, gzip decompression, JTAG state
+ * machine and MPSSE command encoding. Cables are replaced by null
+ * implementations so results only reflect CPU cost.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#include "anlogicBitParser.hpp"
+#include "bitparser.hpp"
+#include "cable.hpp"
+#include "colognechipCfgParser.hpp"
+#include "configBitstreamParser.hpp"
+#include "cxxopts.hpp"
+#include "dfuFileParser.hpp"
+#include "display.hpp"
+#include "efinixHexParser.hpp"
+#include "fsparser.hpp"
+#include "ihexParser.hpp"
+#include "jedParser.hpp"
+#include "jtag.hpp"
+#include "jtagInterface.hpp"
+#include "latticeBitParser.hpp"
+#include "mcsParser.hpp"
+#include "rawParser.hpp"
+#include "usbStats.hpp"
+#ifdef BENCH_NULL_FTDI
+#include "ftdiJtagBitbang.hpp"
+#include "ftdiJtagMPSSE.hpp"
+#include "ftdispi.hpp"
+#endif
+
+using namespace std;
+
+struct bench_args {
+	uint32_t size;         /*!< synthetic bitstream size (bytes) */
+	uint32_t min_ms;       /*!< minimal duration of a benchmark */
+	string filter;         /*!< only run benchmarks containing this */
+	string tmp_dir;        /*!< synthetic files location */
+};
+
+static bench_args args;
+
+/* ----------- */
+/* measurement */
+/* ----------- */
+
+/*!
+ * \brief run func until min_ms is reached (at least 3 times) after
+ *        one warm up call, and display time per call and throughput
+ * \param[in] name: benchmark name
+ * \param[in] bytes: bytes processed by one call
+ * \param[in] func: code to measure
+ */
+static void run_bench(const string &name, uint64_t bytes,
+		function<void()> func)
+{
+	if (!args.filter.empty() && name.find(args.filter) == string::npos)
+		return;
+
+	func();
+
+	uint64_t min_ns = static_cast<uint64_t>(args.min_ms) * 1000000ULL;
+	uint64_t best = UINT64_MAX, total = 0;
+	uint32_t iter = 0;
+	while (iter < 3 || total < min_ns) {
+		uint64_t start = UsbStats::now();
+		func();
+		uint64_t elapsed = UsbStats::now() - start;
+		best = min(best, elapsed);
+		total += elapsed;
+		iter++;
+	}
+
+	double avg_ms = static_cast<double>(total) / iter / 1e6;
+	double best_ms = static_cast<double>(best) / 1e6;
+	printf("%-28s %6u %10.3f %10.3f", name.c_str(), iter, avg_ms, best_ms);
+	if (bytes != 0)
+		printf(" %10.1f", static_cast<double>(bytes) / (1 << 20) /
+			(best_ms / 1000));
+	printf("\n");
+}
+
+/* ------------------ */
+/* synthetic bitstreams */
+/* ------------------ */
+
+/* deterministic pseudo random content (xorshift32) */
+static void fill_random(uint8_t *buf, size_t len)
+{
+	uint32_t x = 0x12345678;
+	for (size_t i = 0; i < len; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		buf[i] = x & 0xff;
+	}
+}
+
+static string random_data(size_t len)
+{
+	string data(len, '\0');
+	fill_random(reinterpret_cast<uint8_t *>(&data[0]), len);
+	return data;
+}
+
+static vector<string> created_files;
+
+static string write_file(const string &name, const string &content)
+{
+	string filename = args.tmp_dir + "/openFPGALoader-bench-" + name;
+	FILE *fd = fopen(filename.c_str(), "wb");
+	if (!fd)
+		throw runtime_error("fail to create " + filename);
+	size_t ret = fwrite(content.data(), 1, content.size(), fd);
+	fclose(fd);
+	if (ret != content.size())
+		throw runtime_error("fail to write " + filename);
+	created_files.push_back(filename);
+	return filename;
+}
+
+static void append_hex(string &s, uint32_t val, int nb_digit)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	for (int i = nb_digit - 1; i >= 0; i--)
+		s += hex[(val >> (4 * i)) & 0x0f];
+}
+
+/* Intel HEX record */
+static void append_ihex(string &s, uint8_t type, uint16_t addr,
+		const uint8_t *data, uint8_t len)
+{
+	uint8_t sum = len + type + (addr & 0xff) + (addr >> 8);
+	s += ':';
+	append_hex(s, len, 2);
+	append_hex(s, addr, 4);
+	append_hex(s, type, 2);
+	for (int i = 0; i < len; i++) {
+		append_hex(s, data[i], 2);
+		sum += data[i];
+	}
+	append_hex(s, static_cast<uint8_t>(~sum + 1), 2);
+	s += "\r\n";
+}
+
+/* Xilinx .bit: header fields a to e followed by raw data */
+static string gen_bit(const string &data)
+{
+	static const uint8_t field1[] = {0x00, 0x09, 0x0f, 0xf0, 0x0f, 0xf0,
+		0x0f, 0xf0, 0x0f, 0xf0, 0x00, 0x00, 0x01};
+	string s(reinterpret_cast<const char *>(field1), sizeof(field1));
+	const char *fields[] = {"top;UserID=0XFFFFFFFF;Version=2020.2",
+		"7a35tcsg324", "2020/10/10", "10:10:10"};
+	for (int i = 0; i < 4; i++) {
+		uint16_t len = strlen(fields[i]) + 1;
+		s += static_cast<char>('a' + i);
+		s += static_cast<char>(len >> 8);
+		s += static_cast<char>(len & 0xff);
+		s.append(fields[i], len);
+	}
+	s += 'e';
+	for (int i = 3; i >= 0; i--)
+		s += static_cast<char>((data.size() >> (8 * i)) & 0xff);
+	return s + data;
+}
+
+/* MCS: 16 bytes data records, extended linear address every 64KB */
+static string gen_mcs(const string &data)
+{
+	string s;
+	s.reserve(data.size() * 3);
+	const uint8_t *ptr = reinterpret_cast<const uint8_t *>(data.data());
+	for (size_t addr = 0; addr < data.size(); addr += 16) {
+		if ((addr & 0xffff) == 0) {
+			uint8_t ext[2] = {static_cast<uint8_t>(addr >> 24),
+				static_cast<uint8_t>(addr >> 16)};
+			append_ihex(s, 4, 0, ext, 2);
+		}
+		uint8_t len = min(static_cast<size_t>(16), data.size() - addr);
+		append_ihex(s, 0, addr & 0xffff, ptr + addr, len);
+	}
+	append_ihex(s, 1, 0, NULL, 0);
+	return s;
+}
+
+/* IhexParser only knows 16 bits addresses: the same 64KB window is
+ * written again until the requested size is reached
+ */
+static string gen_ihex(const string &data)
+{
+	string s;
+	s.reserve(data.size() * 3);
+	const uint8_t *ptr = reinterpret_cast<const uint8_t *>(data.data());
+	for (size_t addr = 0; addr < data.size(); addr += 16) {
+		uint8_t len = min(static_cast<size_t>(16), data.size() - addr);
+		append_ihex(s, 0, addr & 0xffff, ptr + addr, len);
+	}
+	append_ihex(s, 1, 0, NULL, 0);
+	return s;
+}
+
+/* JEDEC: one L field, 128 fuses by line, fuses checksum */
+static string gen_jed(const string &data)
+{
+	uint32_t nb_fuses = data.size() * 8;
+	uint16_t checksum = 0;
+	string s = "\x02*\nQF" + to_string(nb_fuses) + "*\nF0*\nL000000\n";
+	s.reserve(nb_fuses + nb_fuses / 128 + 64);
+	for (size_t i = 0; i < data.size(); i++) {
+		uint8_t val = data[i];
+		for (int b = 0; b < 8; b++)
+			s += ((val >> b) & 0x01) ? '1' : '0';
+		checksum += val;
+		if ((i & 0x0f) == 0x0f)
+			s += (i == data.size() - 1) ? "*\n" : "\n";
+	}
+	s += "C";
+	append_hex(s, checksum, 4);
+	s += "*\n\x03" "0000\n";
+	return s;
+}
+
+static string to_bits(uint64_t val, int len)
+{
+	string s;
+	for (int i = len - 1; i >= 0; i--)
+		s += ((val >> i) & 0x01) ? '1' : '0';
+	return s;
+}
+
+/* Gowin .fs: GW1N-9 header (uncompressed, no crc) and 712 frames */
+static string gen_fs(const string &data)
+{
+	const int nb_line = 712;
+	size_t line_len = max(static_cast<size_t>(16),
+		(data.size() / nb_line) & ~static_cast<size_t>(1));
+	string s = "//synthetic\n";
+	s += to_bits(0xffffffffULL, 32) + "\n";
+	s += to_bits(0x060000001100581bULL, 64) + "\n";
+	s += to_bits(0x1000000000000000ULL, 64) + "\n";
+	s += to_bits(0x3b0002c8ULL, 32) + "\n";
+	s.reserve(nb_line * (line_len * 8 + 1) + s.size());
+	for (int l = 0; l < nb_line; l++) {
+		for (size_t i = 0; i < line_len; i++)
+			s += to_bits(static_cast<uint8_t>(data[(l * line_len + i) %
+				data.size()]), 8);
+		s += "\n";
+	}
+	return s;
+}
+
+/* Lattice .bit: comment area, preamble then VERIFY_ID command */
+static string gen_lattice_bit(const string &data)
+{
+	string s("\xff\x00", 2);
+	s += string("Part: LFE5U-25F-6CABGA256") + '\0';
+	s += string("Date: Oct 10 10:10:10 2020") + '\0';
+	s += string("\xff\xff\xff\xbd\xb3", 5);
+	s += string("\xe2\x00\x00\x00\x41\x11\x10\x43", 8);
+	return s + data;
+}
+
+/* Efinix .hex and Cologne Chip .cfg: one hexadecimal byte by line */
+static string gen_hex_lines(const string &data, const char *comment)
+{
+	string s;
+	s.reserve(data.size() * (3 + strlen(comment)));
+	for (size_t i = 0; i < data.size(); i++) {
+		append_hex(s, static_cast<uint8_t>(data[i]), 2);
+		s += comment;
+		s += "\n";
+	}
+	return s;
+}
+
+/* Anlogic .bit: text header then blocks prefixed by their size (bits) */
+static string gen_anlogic(const string &data)
+{
+	string s = "# Tang Dynasty\n# Device: EG4S20BG256\n\n";
+	/* first block size must be < 256 bits (header ends with 0x00) */
+	size_t pos = 0;
+	size_t len = 16;
+	while (pos < data.size()) {
+		len = min(len, data.size() - pos);
+		uint16_t nb_bits = len * 8;
+		s += static_cast<char>(nb_bits >> 8);
+		s += static_cast<char>(nb_bits & 0xff);
+		s.append(data, pos, len);
+		pos += len;
+		len = 1024;
+	}
+	return s;
+}
+
+/* DFU: raw data followed by DFU suffix and CRC (without final xor) */
+static string gen_dfu(const string &data)
+{
+	string s = data;
+	static const uint8_t suffix[] = {0x00, 0x01, 0x34, 0x12, 0x09, 0x12,
+		0x1a, 0x01, 'U', 'F', 'D', 16};
+	s.append(reinterpret_cast<const char *>(suffix), sizeof(suffix));
+	uint32_t crc = 0xffffffff;
+	for (size_t i = 0; i < s.size(); i++) {
+		crc ^= static_cast<uint8_t>(s[i]);
+		for (int b = 0; b < 8; b++)
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+	}
+	for (int i = 0; i < 4; i++)
+		s += static_cast<char>((crc >> (8 * i)) & 0xff);
+	return s;
+}
+
+#ifdef HAS_ZLIB
+static string gzip(const string &data)
+{
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK)
+		throw runtime_error("deflateInit2 failed");
+	string out(deflateBound(&strm, data.size()), '\0');
+	strm.next_in = (Bytef *)data.data();
+	strm.avail_in = data.size();
+	strm.next_out = (Bytef *)&out[0];
+	strm.avail_out = out.size();
+	int ret = deflate(&strm, Z_FINISH);
+	out.resize(strm.total_out);
+	deflateEnd(&strm);
+	if (ret != Z_STREAM_END)
+		throw runtime_error("deflate failed");
+	return out;
+}
+#endif
+
+/* --------------------- */
+/* parsers and compression */
+/* --------------------- */
+
+typedef function<ConfigBitstreamParser *(const string &)> parser_factory_t;
+
+/*!
+ * \brief file read and parse (the constructor reads the file)
+ */
+static void bench_parser(const string &name, const string &content,
+		parser_factory_t factory)
+{
+	if (!args.filter.empty() && name.find(args.filter) == string::npos)
+		return;
+	string filename = write_file(name, content);
+	run_bench(name, content.size(), [&]() {
+		unique_ptr<ConfigBitstreamParser> parser(factory(filename));
+		if (parser->parse() != EXIT_SUCCESS)
+			throw runtime_error(name + ": parse failed");
+	});
+}
+
+static void bench_parsers()
+{
+	string data = random_data(args.size);
+
+	bench_parser("bit", gen_bit(data), [](const string &f) {
+		return new BitParser(f, true); });
+	bench_parser("mcs", gen_mcs(data), [](const string &f) {
+		return new McsParser(f, true, false); });
+	bench_parser("ihex", gen_ihex(data), [](const string &f) {
+		return new IhexParser(f, false, false); });
+	bench_parser("jed", gen_jed(data), [](const string &f) {
+		return new JedParser(f, false); });
+	bench_parser("fs", gen_fs(data), [](const string &f) {
+		return new FsParser(f, true, false); });
+	bench_parser("lattice.bit", gen_lattice_bit(data), [](const string &f) {
+		return new LatticeBitParser(f, false); });
+	bench_parser("efinix.hex", gen_hex_lines(data, ""), [](const string &f) {
+		return new EfinixHexParser(f); });
+	bench_parser("anlogic.bit", gen_anlogic(data), [](const string &f) {
+		return new AnlogicBitParser(f, true, false); });
+	bench_parser("cfg", gen_hex_lines(data, " // cfg"), [](const string &f) {
+		return new CologneChipCfgParser(f); });
+	/* parse also checks the CRC */
+	bench_parser("dfu_crc", gen_dfu(data), [](const string &f) {
+		return new DFUFileParser(f, false); });
+#ifdef HAS_ZLIB
+	/* decompress_bitstream is private: measured through a raw file
+	 * load, compare with raw.bin to exclude file read
+	 */
+	bench_parser("raw.bin", data, [](const string &f) {
+		return new RawParser(f, false); });
+	bench_parser("raw.bin.gz", gzip(data), [](const string &f) {
+		return new RawParser(f, false); });
+#endif
+}
+
+/* ---- */
+/* JTAG */
+/* ---- */
+
+/*!
+ * \class NullCable
+ * \brief JTAG converter accepting everything without any transfer
+ */
+class NullCable : public JtagInterface {
+ public:
+	NullCable() { _clkHZ = 6000000; }
+	int setClkFreq(uint32_t clkHZ) override { _clkHZ = clkHZ; return clkHZ; }
+	int writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer) override
+	{
+		(void)tms; (void)flush_buffer;
+		return len;
+	}
+	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) override
+	{
+		(void)tx; (void)end;
+		if (rx)
+			memset(rx, 0, (len + 7) / 8);
+		return len;
+	}
+	int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override
+	{
+		(void)tms; (void)tdi;
+		return clk_len;
+	}
+	int get_buffer_size() override { return 4096; }
+	bool isFull() override { return false; }
+	int flush() override { return 0; }
+};
+
+static void bench_jtag()
+{
+	/* the simulated cable is only used for chain detection */
+	Jtag jtag(cable_list["sim"], NULL, "", "", 6000000, 0, false, "",
+		Jtag::DETECT_FULL, "", "artix7");
+	delete jtag._jtag;
+	jtag._jtag = new NullCable();
+
+	const int nb_loop = 100000;
+	run_bench("jtag_set_state", 0, [&]() {
+		for (int i = 0; i < nb_loop; i++) {
+			jtag.set_state(Jtag::SHIFT_DR);
+			jtag.set_state(Jtag::PAUSE_DR);
+			jtag.set_state(Jtag::SHIFT_IR);
+			jtag.set_state(Jtag::RUN_TEST_IDLE);
+			jtag.set_state(Jtag::TEST_LOGIC_RESET);
+		}
+	});
+
+	const int nb_tms = 8 * 1024 * 1024;
+	run_bench("jtag_tms_packing", nb_tms / 8, [&]() {
+		for (int i = 0; i < nb_tms; i++)
+			jtag.setTMS(i & 0x01);
+		jtag.flushTMS();
+	});
+
+	vector<uint8_t> tx(args.size), rx(args.size);
+	fill_random(tx.data(), tx.size());
+	run_bench("jtag_shiftDR_msb", tx.size(), [&]() {
+		jtag.shiftDR(tx.data(), rx.data(), tx.size() * 8,
+			Jtag::RUN_TEST_IDLE, true);
+	});
+}
+
+/* ----- */
+/* MPSSE */
+/* ----- */
+
+#ifdef BENCH_NULL_FTDI
+/* null libftdi: the bench is linked with --wrap for each function used
+ * by FTDIpp_MPSSE and FtdiJtagMPSSE. Writes are accepted, reads return
+ * zeros.
+ */
+extern "C" {
+struct ftdi_context *__wrap_ftdi_new(void)
+{
+	struct ftdi_context *ftdi = (struct ftdi_context *)calloc(1,
+		sizeof(struct ftdi_context));
+	ftdi->type = TYPE_2232H;
+	ftdi->max_packet_size = 512;
+	ftdi->usb_dev = (libusb_device_handle *)ftdi;
+	ftdi->error_str = "null cable";
+	return ftdi;
+}
+void __wrap_ftdi_free(struct ftdi_context *ftdi) { free(ftdi); }
+int __wrap_ftdi_set_interface(struct ftdi_context *ftdi,
+		enum ftdi_interface interface)
+{
+	ftdi->interface = (interface == INTERFACE_ANY) ? 0 : interface - 1;
+	return 0;
+}
+int __wrap_ftdi_usb_open_desc(struct ftdi_context *, int, int,
+		const char *, const char *) { return 0; }
+int __wrap_ftdi_usb_open_bus_addr(struct ftdi_context *, uint8_t,
+		uint8_t) { return 0; }
+int __wrap_ftdi_usb_close(struct ftdi_context *) { return 0; }
+int __wrap_ftdi_usb_reset(struct ftdi_context *) { return 0; }
+int __wrap_ftdi_usb_purge_buffers(struct ftdi_context *) { return 0; }
+int __wrap_ftdi_usb_purge_rx_buffer(struct ftdi_context *) { return 0; }
+int __wrap_ftdi_usb_purge_tx_buffer(struct ftdi_context *) { return 0; }
+int __wrap_ftdi_tciflush(struct ftdi_context *) { return 0; }
+int __wrap_ftdi_tcoflush(struct ftdi_context *) { return 0; }
+int __wrap_ftdi_tcioflush(struct ftdi_context *) { return 0; }
+int __wrap_ftdi_set_baudrate(struct ftdi_context *, int) { return 0; }
+int __wrap_ftdi_set_bitmode(struct ftdi_context *, unsigned char,
+		unsigned char) { return 0; }
+int __wrap_ftdi_set_latency_timer(struct ftdi_context *,
+		unsigned char) { return 0; }
+int __wrap_ftdi_read_data_set_chunksize(struct ftdi_context *,
+		unsigned int) { return 0; }
+int __wrap_ftdi_write_data_set_chunksize(struct ftdi_context *,
+		unsigned int) { return 0; }
+int __wrap_ftdi_read_data(struct ftdi_context *, unsigned char *buf,
+		int size)
+{
+	memset(buf, 0, size);
+	return size;
+}
+int __wrap_ftdi_write_data(struct ftdi_context *, const unsigned char *,
+		int size) { return size; }
+static struct ftdi_transfer_control *null_transfer(struct ftdi_context *ftdi,
+		unsigned char *buf, int size)
+{
+	struct ftdi_transfer_control *tc = (struct ftdi_transfer_control *)
+		calloc(1, sizeof(struct ftdi_transfer_control));
+	tc->completed = 1;
+	tc->buf = buf;
+	tc->size = size;
+	tc->offset = size;
+	tc->ftdi = ftdi;
+	return tc;
+}
+struct ftdi_transfer_control *__wrap_ftdi_write_data_submit(
+		struct ftdi_context *ftdi, unsigned char *buf, int size)
+{
+	return null_transfer(ftdi, buf, size);
+}
+struct ftdi_transfer_control *__wrap_ftdi_read_data_submit(
+		struct ftdi_context *ftdi, unsigned char *buf, int size)
+{
+	memset(buf, 0, size);
+	return null_transfer(ftdi, buf, size);
+}
+int __wrap_ftdi_transfer_data_done(struct ftdi_transfer_control *tc)
+{
+	int ret = tc->offset;
+	free(tc);
+	return ret;
+}
+const char *__wrap_ftdi_get_error_string(struct ftdi_context *ftdi)
+{
+	return ftdi->error_str;
+}
+libusb_device *__wrap_libusb_get_device(libusb_device_handle *dev_handle)
+{
+	return (libusb_device *)dev_handle;
+}
+int __wrap_libusb_get_device_descriptor(libusb_device *,
+		struct libusb_device_descriptor *desc)
+{
+	memset(desc, 0, sizeof(*desc));
+	return 0;
+}
+int __wrap_libusb_get_string_descriptor_ascii(libusb_device_handle *,
+		uint8_t, unsigned char *data, int length)
+{
+	return snprintf((char *)data, length, "null");
+}
+int __wrap_libusb_handle_events_timeout_completed(libusb_context *,
+		struct timeval *, int *) { return 0; }
+void __wrap_libusb_close(libusb_device_handle *) {}
+int __wrap_libusb_release_interface(libusb_device_handle *, int) { return 0; }
+int __wrap_libusb_attach_kernel_driver(libusb_device_handle *, int)
+{
+	return 0;
+}
+}
+
+static void bench_mpsse()
+{
+	FtdiJtagMPSSE mpsse(cable_list["ft2232"].config, "", "", 6000000, false);
+
+	vector<uint8_t> tx(args.size), rx(args.size);
+	fill_random(tx.data(), tx.size());
+	run_bench("mpsse_writeTDI", tx.size(), [&]() {
+		mpsse.writeTDI(tx.data(), NULL, tx.size() * 8, true);
+	});
+	run_bench("mpsse_writeTDI_read", tx.size(), [&]() {
+		mpsse.writeTDI(tx.data(), rx.data(), tx.size() * 8, true);
+	});
+	/* small scans: per call encoding overhead */
+	run_bench("mpsse_writeTDI_32bits", 0, [&]() {
+		for (int i = 0; i < 100000; i++)
+			mpsse.writeTDI(tx.data(), rx.data(), 32, true);
+	});
+	uint8_t tms[16];
+	memset(tms, 0x5a, sizeof(tms));
+	run_bench("mpsse_writeTMS", 0, [&]() {
+		for (int i = 0; i < 100000; i++)
+			mpsse.writeTMS(tms, 128, false);
+		mpsse.flush();
+	});
+
+	/* FT232R/FT231X bitbang: two samples per bit */
+	const jtag_pins_conf_t pins = {0x08, 0x01, 0x02, 0x04};
+	FtdiJtagBitBang bitbang(cable_list["ft232RL"].config, &pins, "", "",
+		3000000, 0);
+	run_bench("bitbang_writeTDI", tx.size(), [&]() {
+		bitbang.writeTDI(tx.data(), NULL, tx.size() * 8, true);
+		bitbang.flush();
+	});
+	run_bench("bitbang_writeTDI_read", tx.size(), [&]() {
+		bitbang.writeTDI(tx.data(), rx.data(), tx.size() * 8, true);
+	});
+
+	/* SPI flash read/program commands: opcode + address + payload */
+	FtdiSpi spi(cable_list["ft2232"].config, spi_pins_conf_t(), 6000000,
+		false);
+	uint8_t addr[3] = {0, 0, 0};
+	const SPIInterface::spi_seg_t rd_seg[2] = {
+		{addr, NULL, 3}, {NULL, rx.data(), args.size}};
+	run_bench("ftdispi_read", rx.size(), [&]() {
+		spi.spi_xfer(0x03, rd_seg, 2);
+	});
+	run_bench("ftdispi_page_program", tx.size(), [&]() {
+		for (uint32_t i = 0; i < args.size; i += 256) {
+			const SPIInterface::spi_seg_t wr_seg[2] = {
+				{addr, NULL, 3}, {tx.data() + i, NULL, 256}};
+			spi.spi_xfer(0x02, wr_seg, 2);
+		}
+	});
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	const char *tmp = getenv("TMPDIR");
+	args.tmp_dir = (tmp) ? tmp : "/tmp";
+	args.size = 4;
+	args.min_ms = 500;
+
+	cxxopts::Options options(argv[0], "openFPGALoader host side benchmarks",
+		"<gwenhael.goavec-merou@trabucayre.com>");
+	options.positional_help("[filter]").show_positional_help();
+	options
+		.add_options()
+		("filter", "only run benchmarks whose name contains this",
+			cxxopts::value<string>(args.filter))
+		("size", "synthetic bitstream size (MB)",
+			cxxopts::value<uint32_t>(args.size))
+		("time", "minimal duration of each benchmark (ms)",
+			cxxopts::value<uint32_t>(args.min_ms))
+		("tmp-dir", "directory for synthetic files",
+			cxxopts::value<string>(args.tmp_dir))
+		("h,help", "Give this help list");
+	options.parse_positional({"filter"});
+
+	try {
+		auto result = options.parse(argc, argv);
+		if (result.count("help")) {
+			cout << options.help() << endl;
+			return EXIT_SUCCESS;
+		}
+	} catch (const cxxopts::OptionException &e) {
+		printError("Error parsing options: " + string(e.what()));
+		return EXIT_FAILURE;
+	}
+	args.size *= 1024 * 1024;
+
+	printf("%-28s %6s %10s %10s %10s\n", "benchmark", "iter", "avg (ms)",
+		"best (ms)", "MB/s");
+
+	int ret = EXIT_SUCCESS;
+	try {
+		bench_parsers();
+		bench_jtag();
+#ifdef BENCH_NULL_FTDI
+		bench_mpsse();
+#else
+		printWarn("mpsse: needs linker --wrap support, skipped");
+#endif
+	} catch (std::exception &e) {
+		printError(e.what());
+		ret = EXIT_FAILURE;
+	}
+
+	for (auto &&f : created_files)
+		remove(f.c_str());
+
+	return ret;
+}
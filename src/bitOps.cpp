@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITOPS_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define BITOPS_NEON
+#include <arm_neon.h>
+#endif
+
+#include "configBitstreamParser.hpp"
+#include "bitOps.hpp"
+
+typedef void (*reverse_fn_t)(uint8_t *dst, const uint8_t *src, size_t len);
+typedef void (*expand_fn_t)(uint8_t *dst, const uint8_t *src, size_t nb_bits);
+
+/* ------------- */
+/* scalar kernel */
+/* ------------- */
+
+static void reverse_scalar(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		dst[i] = ConfigBitstreamParser::reverseByte(src[i]);
+}
+
+static void expand_scalar(uint8_t *dst, const uint8_t *src, size_t nb_bits)
+{
+	for (size_t i = 0; i < nb_bits; i++)
+		dst[i] = ((src[i >> 3] >> (i & 0x07)) & 0x01) ? 0xff : 0x00;
+}
+
+/* ----------- */
+/* x86 kernels */
+/* ----------- */
+
+#ifdef BITOPS_X86
+/* a byte is reversed by swapping its nibbles, each nibble
+ * being reversed with a 16 entries lookup (pshufb)
+ */
+__attribute__((target("ssse3")))
+static void reverse_ssse3(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	const __m128i lo_tbl = _mm_setr_epi8(
+		0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e,
+		0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f);
+	const __m128i hi_tbl = _mm_slli_epi16(lo_tbl, 4);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i lo = _mm_and_si128(v, mask);
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		v = _mm_or_si128(_mm_shuffle_epi8(hi_tbl, lo),
+			_mm_shuffle_epi8(lo_tbl, hi));
+		_mm_storeu_si128((__m128i *)(dst + i), v);
+	}
+	reverse_scalar(dst + i, src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static void reverse_avx2(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	const __m256i lo_tbl = _mm256_setr_epi8(
+		0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e,
+		0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f,
+		0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e,
+		0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f);
+	const __m256i hi_tbl = _mm256_slli_epi16(lo_tbl, 4);
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	size_t i = 0;
+
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i lo = _mm256_and_si256(v, mask);
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+		v = _mm256_or_si256(_mm256_shuffle_epi8(hi_tbl, lo),
+			_mm256_shuffle_epi8(lo_tbl, hi));
+		_mm256_storeu_si256((__m256i *)(dst + i), v);
+	}
+	reverse_ssse3(dst + i, src + i, len - i);
+}
+
+/* each source byte is broadcasted to 8 lanes, then tested against
+ * a per lane bit mask
+ */
+__attribute__((target("ssse3")))
+static void expand_ssse3(uint8_t *dst, const uint8_t *src, size_t nb_bits)
+{
+	const __m128i bcast = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0,
+		1, 1, 1, 1, 1, 1, 1, 1);
+	const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+		1, 2, 4, 8, 16, 32, 64, -128);
+	size_t i = 0;
+
+	for (; i + 16 <= nb_bits; i += 16) {
+		uint16_t word;
+		memcpy(&word, src + (i >> 3), 2);
+		__m128i v = _mm_shuffle_epi8(_mm_cvtsi32_si128(word), bcast);
+		v = _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits);
+		_mm_storeu_si128((__m128i *)(dst + i), v);
+	}
+	expand_scalar(dst + i, src + (i >> 3), nb_bits - i);
+}
+
+__attribute__((target("avx2")))
+static void expand_avx2(uint8_t *dst, const uint8_t *src, size_t nb_bits)
+{
+	const __m256i bcast = _mm256_setr_epi8(
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+		2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+	const __m256i bits = _mm256_setr_epi8(
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	size_t i = 0;
+
+	for (; i + 32 <= nb_bits; i += 32) {
+		uint32_t word;
+		memcpy(&word, src + (i >> 3), 4);
+		/* pshufb works by 128 bits lane: source bytes must be
+		 * present in both lanes
+		 */
+		__m256i v = _mm256_set1_epi32(static_cast<int>(word));
+		v = _mm256_shuffle_epi8(v, bcast);
+		v = _mm256_cmpeq_epi8(_mm256_and_si256(v, bits), bits);
+		_mm256_storeu_si256((__m256i *)(dst + i), v);
+	}
+	expand_ssse3(dst + i, src + (i >> 3), nb_bits - i);
+}
+#endif
+
+/* ------------ */
+/* NEON kernels */
+/* ------------ */
+
+#ifdef BITOPS_NEON
+static void reverse_neon(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16)
+		vst1q_u8(dst + i, vrbitq_u8(vld1q_u8(src + i)));
+	reverse_scalar(dst + i, src + i, len - i);
+}
+
+static void expand_neon(uint8_t *dst, const uint8_t *src, size_t nb_bits)
+{
+	static const uint8_t bits_arr[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+		1, 2, 4, 8, 16, 32, 64, 128};
+	const uint8x16_t bits = vld1q_u8(bits_arr);
+	size_t i = 0;
+
+	for (; i + 16 <= nb_bits; i += 16) {
+		uint8x16_t v = vcombine_u8(vdup_n_u8(src[i >> 3]),
+			vdup_n_u8(src[(i >> 3) + 1]));
+		vst1q_u8(dst + i, vtstq_u8(v, bits));
+	}
+	expand_scalar(dst + i, src + (i >> 3), nb_bits - i);
+}
+#endif
+
+/* ------------------ */
+/* runtime dispatcher */
+/* ------------------ */
+
+static reverse_fn_t select_reverse()
+{
+#if defined(BITOPS_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return reverse_avx2;
+	if (__builtin_cpu_supports("ssse3"))
+		return reverse_ssse3;
+#elif defined(BITOPS_NEON)
+	return reverse_neon;
+#endif
+	return reverse_scalar;
+}
+
+static expand_fn_t select_expand()
+{
+#if defined(BITOPS_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return expand_avx2;
+	if (__builtin_cpu_supports("ssse3"))
+		return expand_ssse3;
+#elif defined(BITOPS_NEON)
+	return expand_neon;
+#endif
+	return expand_scalar;
+}
+
+void reverseBytes(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	static const reverse_fn_t fn = select_reverse();
+	fn(dst, src, len);
+}
+
+void expandBits(uint8_t *dst, const uint8_t *src, size_t nb_bits)
+{
+	static const expand_fn_t fn = select_expand();
+	fn(dst, src, nb_bits);
+}
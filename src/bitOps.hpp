@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#ifndef SRC_BITOPS_HPP_
+#define SRC_BITOPS_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*!
+ * \file bitOps.hpp
+ * \brief bulk bit manipulation used to prepare bitstreams and
+ *        bitbang buffers. SIMD kernels (SSSE3, AVX2, NEON) are
+ *        selected at runtime, with a scalar fallback
+ */
+
+/*!
+ * \brief reverse bit order of each byte (bit 0 <-> bit 7)
+ * \param[out] dst: destination buffer (may be equal to src)
+ * \param[in] src: source buffer
+ * \param[in] len: number of bytes
+ */
+void reverseBytes(uint8_t *dst, const uint8_t *src, size_t len);
+
+/*!
+ * \brief expand packed bits (LSB first) to one byte per bit:
+ *        0xff when the bit is set, 0x00 otherwise
+ * \param[out] dst: destination buffer (nb_bits bytes)
+ * \param[in] src: packed bits
+ * \param[in] nb_bits: number of bits to expand
+ */
+void expandBits(uint8_t *dst, const uint8_t *src, size_t nb_bits);
+
+#endif  // SRC_BITOPS_HPP_
@@ -3,8 +3,10 @@
  * Copyright (C) 2019 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
  */
 
+#include "bitOps.hpp"
 #include "bitparser.hpp"
 #include "display.hpp"
+#include "usbStats.hpp"
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
@@ -106,6 +108,7 @@ int BitParser::parseHeader()
 
 int BitParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	/* process all field */
 	int pos = parseHeader();
 
@@ -115,9 +118,8 @@ int BitParser::parse()
 	_bit_length = _bit_data.size();
 
 	if (_reverseOrder) {
-		for (int i = 0; i < _bit_length; i++) {
-			_bit_data[i] = reverseByte(_bit_data[i]);
-		}
+		uint8_t *data = reinterpret_cast<uint8_t *>(&_bit_data[0]);
+		reverseBytes(data, data, _bit_length);
 	}
 
 	/* convert size to bit */
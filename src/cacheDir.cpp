@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <string>
+
+#include "cacheDir.hpp"
+
+#ifndef _WIN32
+/* create dir and all missing parents (mkdir -p) */
+static void mkdir_p(const std::string &dir)
+{
+	for (size_t pos = dir.find('/', 1); pos != std::string::npos;
+			pos = dir.find('/', pos + 1))
+		mkdir(dir.substr(0, pos).c_str(), 0755);
+	mkdir(dir.c_str(), 0755);
+}
+#endif
+
+std::string cache_dir()
+{
+	std::string dir;
+#ifdef _WIN32
+	const char *base = getenv("LOCALAPPDATA");
+	if (!base)
+		return "";
+	dir = std::string(base) + "\\openFPGALoader";
+	_mkdir(dir.c_str());
+#else
+	const char *base = getenv("XDG_CACHE_HOME");
+	if (base && base[0] != '\0') {
+		dir = std::string(base);
+	} else {
+		base = getenv("HOME");
+		if (!base)
+			return "";
+		dir = std::string(base) + "/.cache";
+	}
+	dir += "/openFPGALoader";
+	mkdir_p(dir);
+#endif
+	return dir;
+}
@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#ifndef SRC_CACHEDIR_HPP_
+#define SRC_CACHEDIR_HPP_
+
+#include <string>
+
+/*!
+ * \brief openFPGALoader cache directory (JTAG chain topology, SPI flash
+ *        parameters), created if required
+ * \return directory path, empty string if no location is available
+ */
+std::string cache_dir();
+
+#endif  // SRC_CACHEDIR_HPP_
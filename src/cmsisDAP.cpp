@@ -20,6 +20,7 @@
 #include "display.hpp"
 
 #include "cmsisDAP.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -32,10 +33,12 @@ enum datalink_cmd {
 	DAP_HOSTSTATUS    = 0x01,
 	DAP_CONNECT       = 0x02,  // Connect to device and select mode
 	DAP_DISCONNECT    = 0x03,  // Disconnect to device
+	DAP_DELAY         = 0x09,  // Wait for delay (us)
 	DAP_RESETTARGET   = 0x0A,  // reset the target
 	DAP_SWJ_CLK       = 0x11,  // Select maximum frequency
 	DAP_SWJ_SEQUENCE  = 0x12,  // Generate TMS sequence
-	DAP_JTAG_SEQUENCE = 0x14   // Generate TMS, TDI and capture TDO Sequence
+	DAP_JTAG_SEQUENCE = 0x14,  // Generate TMS, TDI and capture TDO Sequence
+	DAP_EXECUTE_CMDS  = 0x7F   // Execute multiple commands in one packet
 };
 
 enum cmsisdap_connect_mode {
@@ -90,7 +93,8 @@ enum cmsisdap_status {
 
 CmsisDAP::CmsisDAP(int vid, int pid, uint8_t verbose):_verbose(verbose),
 		_device_idx(0),  _vid(vid), _pid(pid),
-		_serial_number(L""), _dev(NULL), _num_tms(0), _is_connect(false)
+		_serial_number(L""), _dev(NULL), _num_tms(0), _is_connect(false),
+		_exec_cmds(true)
 {
 	std::vector<struct hid_device_info *> dev_found;
 	_ll_buffer = (unsigned char *)malloc(sizeof(unsigned char) * 65);
@@ -457,6 +461,95 @@ int CmsisDAP::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 	return writeJtagSequence(tms, tx, NULL, clk_len, false);
 }
 
+/* pending TMS, clock cycles and DAP_Delay sent in the same packet with
+ * DAP_ExecuteCommands: one round trip for the whole wait
+ * return 1 when done, 0 when not supported by the probe, -1 on error
+ */
+int CmsisDAP::execWait(uint32_t min_us, uint32_t min_clocks, uint8_t tms)
+{
+	uint8_t tms_buf[32];
+	int nb_tms = _num_tms;
+	int pos = 1, nb_cmd = 0;
+
+	/* TMS states are stored after SWJ_SEQUENCE length: keep them
+	 * to restore buffer if probe doesn't know DAP_ExecuteCommands
+	 */
+	memcpy(tms_buf, &_buffer[1], (nb_tms + 7) / 8);
+
+	if (nb_tms > 0) {
+		_buffer[pos++] = DAP_SWJ_SEQUENCE;
+		_buffer[pos++] = nb_tms & 0xff;
+		memcpy(&_buffer[pos], tms_buf, (nb_tms + 7) / 8);
+		pos += (nb_tms + 7) / 8;
+		nb_cmd++;
+	}
+	if (min_clocks > 0) {
+		_buffer[pos++] = DAP_JTAG_SEQUENCE;
+		_buffer[pos++] = 1;
+		_buffer[pos++] = DAP_JTAG_SEQ_TMS_SHIFT(tms) |
+			DAP_JTAG_SEQ_NB_TCK((min_clocks == 64) ? 0 : min_clocks);
+		memset(&_buffer[pos], 0, (min_clocks + 7) / 8);
+		pos += (min_clocks + 7) / 8;
+		nb_cmd++;
+	}
+	if (min_us > 0) {
+		_buffer[pos++] = DAP_DELAY;
+		_buffer[pos++] = min_us & 0xff;
+		_buffer[pos++] = (min_us >> 8) & 0xff;
+		nb_cmd++;
+	}
+	_buffer[0] = nb_cmd;
+
+	/* no answer check: DAP_Invalid is expected from older probes */
+	_ll_buffer[1] = DAP_EXECUTE_CMDS;
+	if (xfer(pos + 1, NULL, 0) <= 0)
+		return -1;
+	if (_ll_buffer[0] != DAP_EXECUTE_CMDS) {
+		/* DAP_Invalid: nothing done */
+		_exec_cmds = false;
+		memcpy(&_buffer[1], tms_buf, (nb_tms + 7) / 8);
+		return 0;
+	}
+	_num_tms = 0;
+
+	/* each answer: command ID and status */
+	for (int i = 0; i < nb_cmd; i++) {
+		if (_ll_buffer[2 + 2 * i + 1] != DAP_OK) {
+			printError("waitUs: command failed");
+			return -1;
+		}
+	}
+	return 1;
+}
+
+int CmsisDAP::waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms)
+{
+	/* common case (a few clock cycles, short delay): one packet */
+	if (_exec_cmds && min_clocks <= 64 && min_us <= 0xffff) {
+		int ret = execWait(min_us, min_clocks, tms);
+		if (ret != 0)
+			return (ret < 0) ? -1 : 0;
+	}
+
+	if (min_clocks > 0 && toggleClk(tms, 0, min_clocks) <= 0)
+		return -1;
+	if (flush() < 0)
+		return -1;
+
+	/* DAP_Delay: 16bits delay */
+	while (min_us > 0) {
+		uint16_t delay = (min_us > 0xffff) ? 0xffff : min_us;
+		_buffer[0] = delay & 0xff;
+		_buffer[1] = (delay >> 8) & 0xff;
+		if (xfer(DAP_DELAY, 2, NULL, 0) <= 0) {
+			printError("waitUs: failed to send delay");
+			return -1;
+		}
+		min_us -= delay;
+	}
+	return 0;
+}
+
 /* flush buffer filled with TMS states
  */
 int CmsisDAP::flush()
@@ -486,13 +579,17 @@ int CmsisDAP::xfer(uint8_t instruction, int tx_len,
 	_ll_buffer[0] = 0;
 	_ll_buffer[1] = instruction;
 
+	uint64_t start = UsbStats::now();
 	int ret = hid_write(_dev, _ll_buffer, 65);
+	UsbStats::write(65, start);
 	if (ret == -1) {
 		printf("Error\n");
 		return ret;
 	}
 
+	start = UsbStats::now();
 	ret = hid_read_timeout(_dev, _ll_buffer, 65, 1000);
+	UsbStats::read((ret > 0) ? ret : 0, start);
 	if (ret <= 0) {
 		if (ret == 0)
 			printError("Error timeout\n");
@@ -522,13 +619,17 @@ int CmsisDAP::xfer(int tx_len, uint8_t *rx_buff, int rx_len)
 
 	_ll_buffer[0] = 0;
 
+	uint64_t start = UsbStats::now();
 	int ret = hid_write(_dev, _ll_buffer, 65);
+	UsbStats::write(65, start);
 	if (ret == -1) {
 		printf("Error\n");
 		return ret;
 	}
 
+	start = UsbStats::now();
 	ret = hid_read_timeout(_dev, _ll_buffer, 65, 1000);
+	UsbStats::read((ret > 0) ? ret : 0, start);
 	if (ret <= 0) {
 		if (ret == 0)
 			printf("Error timeout\n");
@@ -63,6 +63,15 @@ class CmsisDAP: public JtagInterface {
 		 */
 		int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override;
 
+		/*!
+		 * \brief wait with DAP_Delay: delay is done by the probe
+		 * \param[in] min_us: minimal delay (us)
+		 * \param[in] min_clocks: minimal number of clock cycle
+		 * \param[in] tms: tms state
+		 * \return < 0 if something wrong
+		 */
+		int waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms) override;
+
 		/*!
 		 * \brief flush TMS buffer
 		 * \return <=0 if something fail, > 0 otherwise
@@ -95,6 +104,12 @@ class CmsisDAP: public JtagInterface {
 		void display_info(uint8_t info, uint8_t type);
 		int writeJtagSequence(uint8_t tms, uint8_t *tx, uint8_t *rx,
 				uint32_t len, bool end);
+		/*!
+		 * \brief pending TMS, clock cycles and delay in one
+		 *        DAP_ExecuteCommands packet
+		 * \return 1 if done, 0 if not supported, -1 on error
+		 */
+		int execWait(uint32_t min_us, uint32_t min_clocks, uint8_t tms);
 
 		uint8_t _verbose;                /**< display more message */
 		int16_t _device_idx;          /**< device index */
@@ -108,6 +123,7 @@ class CmsisDAP: public JtagInterface {
 		unsigned char *_buffer;    /**< subset of _ll_buffer */
 		int _num_tms;              /**< current tms length */
 		int _is_connect;           /**< device status ((dis)connected) */
+		bool _exec_cmds;           /**< DAP_ExecuteCommands supported */
 };
 
 #endif  // SRC_CMSISDAP_HPP_
@@ -6,6 +6,8 @@
 
 #include "colognechip.hpp"
 
+#include <vector>
+
 #define JTAG_CONFIGURE  0x06
 #define JTAG_SPI_BYPASS 0x05
 #define SLEEP_US 500
@@ -141,6 +143,7 @@ bool CologneChip::dumpFlash(uint32_t base_addr, uint32_t len)
 		} else {
 			flash = new SPIFlash(this, false, _verbose);
 		}
+		SPIFlashAddrGuard addr_guard(*flash);
 		flash->reset();
 		flash->power_up();
 		flash->dump(_filename, base_addr, len);
@@ -241,18 +244,22 @@ void CologneChip::programSPI_flash(unsigned int offset, uint8_t *data,
 	_spi->gpio_clear(_rstn_pin | _oen_pin);
 	usleep(SLEEP_US);
 
-	SPIFlash flash(reinterpret_cast<SPIInterface *>(_spi), unprotect_flash,
-			_verbose);
-	flash.reset();
-	flash.power_up();
-
-	printf("%02x\n", flash.read_status_reg());
-	flash.read_id();
-	flash.erase_and_prog(offset, data, length);
-
-	/* verify write if required */
-	if (_verify)
-		flash.verify(offset, data, length);
+	{
+		SPIFlash flash(reinterpret_cast<SPIInterface *>(_spi), unprotect_flash,
+				_verbose);
+		/* 3-byte addressing restored before reset release */
+		SPIFlashAddrGuard addr_guard(flash);
+		flash.reset();
+		flash.power_up();
+
+		printf("%02x\n", flash.read_status_reg());
+		flash.read_id();
+		flash.erase_and_prog(offset, data, length);
+
+		/* verify write if required */
+		if (_verify)
+			flash.verify(offset, data, length);
+	}
 
 	_spi->gpio_set(_rstn_pin);
 	usleep(SLEEP_US);
@@ -309,17 +316,21 @@ void CologneChip::programJTAG_flash(unsigned int offset, uint8_t *data,
 	/* hold device in reset for a moment */
 	reset();
 
-	SPIFlash flash(this, unprotect_flash, _verbose);
-	flash.reset();
-	flash.power_up();
+	{
+		SPIFlash flash(this, unprotect_flash, _verbose);
+		/* 3-byte addressing restored before output enable */
+		SPIFlashAddrGuard addr_guard(flash);
+		flash.reset();
+		flash.power_up();
 
-	printf("%02x\n", flash.read_status_reg());
-	flash.read_id();
-	flash.erase_and_prog(offset, data, length);
+		printf("%02x\n", flash.read_status_reg());
+		flash.read_id();
+		flash.erase_and_prog(offset, data, length);
 
-	/* verify write if required */
-	if (_verify)
-		flash.verify(offset, data, length);
+		/* verify write if required */
+		if (_verify)
+			flash.verify(offset, data, length);
+	}
 
 	_ftdi_jtag->gpio_set(_oen_pin);
 }
@@ -330,8 +341,8 @@ void CologneChip::programJTAG_flash(unsigned int offset, uint8_t *data,
 int CologneChip::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
 	int xfer_len = len + 1;
-	uint8_t jtx[xfer_len+2];
-	uint8_t jrx[xfer_len+2];
+	std::vector<uint8_t> jtx(xfer_len+2);
+	std::vector<uint8_t> jrx(xfer_len+2);
 
 	jtx[0] = ConfigBitstreamParser::reverseByte(cmd);
 
@@ -343,7 +354,7 @@ int CologneChip::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 	_jtag->shiftIR(JTAG_SPI_BYPASS, 6, Jtag::SELECT_DR_SCAN);
 
 	int test = (rx == NULL) ? 8*xfer_len+1 : 8*xfer_len+2;
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, test, Jtag::SELECT_DR_SCAN);
+	_jtag->shiftDR(jtx.data(), (rx == NULL)? NULL: jrx.data(), test, Jtag::SELECT_DR_SCAN);
 
 	if (rx != NULL) {
 		for (uint32_t i=0; i < len; i++) {
@@ -361,8 +372,8 @@ int CologneChip::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 int CologneChip::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 {
 	int xfer_len = len;
-	uint8_t jtx[xfer_len+2];
-	uint8_t jrx[xfer_len+2];
+	std::vector<uint8_t> jtx(xfer_len+2);
+	std::vector<uint8_t> jrx(xfer_len+2);
 
 	if (tx != NULL) {
 		for (uint32_t i=0; i < len; i++)
@@ -370,7 +381,7 @@ int CologneChip::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 	}
 
 	_jtag->shiftIR(JTAG_SPI_BYPASS, 6, Jtag::SELECT_DR_SCAN);
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len+1, Jtag::SELECT_DR_SCAN);
+	_jtag->shiftDR(jtx.data(), (rx == NULL)? NULL: jrx.data(), 8*xfer_len+1, Jtag::SELECT_DR_SCAN);
 
 	if (rx != NULL) {
 		for (uint32_t i=0; i < len; i++) {
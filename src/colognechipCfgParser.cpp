@@ -7,6 +7,7 @@
 #include <sstream>
 
 #include "colognechipCfgParser.hpp"
+#include "usbStats.hpp"
 
 CologneChipCfgParser::CologneChipCfgParser(const std::string &filename):
 		ConfigBitstreamParser(filename, ConfigBitstreamParser::ASCII_MODE,
@@ -15,6 +16,7 @@ CologneChipCfgParser::CologneChipCfgParser(const std::string &filename):
 
 int CologneChipCfgParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	std::string buffer;
 	std::istringstream lineStream(_raw_data);
 
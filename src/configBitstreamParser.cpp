@@ -25,6 +25,7 @@
 #include "display.hpp"
 
 #include "configBitstreamParser.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -34,6 +35,7 @@ ConfigBitstreamParser::ConfigBitstreamParser(const string &filename, int mode,
 			_bit_data(), _raw_data(), _hdr()
 {
 	(void) mode;
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	if (!filename.empty()) {
 		size_t offset =  filename.find_last_of(".");
 
@@ -21,6 +21,7 @@
 
 #include "display.hpp"
 #include "dfuFileParser.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -132,6 +133,7 @@ int DFUFileParser::parseHeader()
 
 int DFUFileParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	int ret = parseHeader();
 	if (ret < 0)
 		return EXIT_FAILURE;
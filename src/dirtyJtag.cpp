@@ -15,6 +15,7 @@
 
 #include "dirtyJtag.hpp"
 #include "display.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -51,6 +52,21 @@ struct version_specific
 static version_specific v_options[4] ={{0, 240}, {0, 240}, {NO_READ, 496},
 									{NO_READ, 4000}};
 
+/* libusb_bulk_transfer with transfer statistics */
+static int bulk_transfer(libusb_device_handle *dev_handle, unsigned char ep,
+		unsigned char *buf, int len, int *actual_length, unsigned int timeout)
+{
+	uint64_t start = UsbStats::now();
+	int ret = libusb_bulk_transfer(dev_handle, ep, buf, len, actual_length,
+			timeout);
+	int xfer_len = (ret < 0) ? 0 : *actual_length;
+	if (ep & LIBUSB_ENDPOINT_IN)
+		UsbStats::read(xfer_len, start);
+	else
+		UsbStats::write(xfer_len, start);
+	return ret;
+}
+
 
 enum dirtyJtagSig {
 	SIG_TCK =   (1 << 1),
@@ -110,14 +126,14 @@ void DirtyJtag::getVersion()
 	uint8_t buf[] = {CMD_INFO,
 					CMD_STOP};
 	uint8_t rx_buf[64];
-	ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
+	ret = bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
 			        buf, 2, &actual_length, 1000);
 	if (ret < 0) {
 		cerr << "getVersion: usb bulk write failed " << ret << endl;
 		return;
 	}
 	do {
-		ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_READ_EP,
+		ret = bulk_transfer(dev_handle, DIRTYJTAG_READ_EP,
 						rx_buf, 64, &actual_length, 1000);
 		if (ret < 0) {
 			cerr << "getVersion: read: usb bulk read failed " << ret << endl;
@@ -157,7 +173,7 @@ int DirtyJtag::setClkFreq(uint32_t clkHZ)
 					static_cast<uint8_t>(0xff & ((clkHZ / 1000) >> 8)),
 					static_cast<uint8_t>(0xff & ((clkHZ / 1000)     )),
 					CMD_STOP};
-	ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
+	ret = bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
 			        buf, 4, &actual_length, 1000);
 	if (ret < 0) {
 		cerr << "setClkFreq: usb bulk write failed " << ret << endl;
@@ -196,7 +212,7 @@ int DirtyJtag::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 				buf[buffer_idx++] = val;
 			}
 			buf[buffer_idx++] = CMD_STOP;
-			int ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
+			int ret = bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
 										   buf, buffer_idx, &actual_length, 1000);
 			if (ret < 0)
 			{
@@ -219,7 +235,7 @@ int DirtyJtag::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 	while (clk_len > 0) {
 		buf[2] = (clk_len > 64) ? 64 : (uint8_t)clk_len;
 
-		int ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
+		int ret = bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
 				buf, 4, &actual_length, 1000);
 		if (ret < 0) {
 			cerr << "toggleClk: usb bulk write failed " << ret << endl;
@@ -280,7 +296,7 @@ int DirtyJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 				tx_buf[header_offset + (i >> 3)] |= (0x80 >> (i & 0x07));
 
 		actual_length = 0;
-		int ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
+		int ret = bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
 		        (unsigned char *)tx_buf, (byte_to_send + header_offset),
 				&actual_length, 1000);
 		if ((ret < 0) || (actual_length != (int)(byte_to_send + header_offset))) {
@@ -293,7 +309,7 @@ int DirtyJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 		if (rx || (_version <= 1)) {
 			int transfer_length = (bit_to_send > 255) ? byte_to_send :32;
 			do {
-				ret = libusb_bulk_transfer(dev_handle, DIRTYJTAG_READ_EP,
+				ret = bulk_transfer(dev_handle, DIRTYJTAG_READ_EP,
 					rx_buf, transfer_length, &actual_length, 1000);
 				if (ret < 0) {
 					cerr << "writeTDI: read: usb bulk read failed " << ret << endl;
@@ -337,7 +353,7 @@ int DirtyJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 				CMD_GETSIG,  // <---Read instruction
 				CMD_STOP,
 			};
-			if (libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
+			if (bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
 									 buf, sizeof(buf), &actual_length, 1000) < 0)
 			{
 				cerr << "writeTDI: last bit error: usb bulk write failed 1" << endl;
@@ -345,7 +361,7 @@ int DirtyJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 			}
 			do
 			{
-				if (libusb_bulk_transfer(dev_handle, DIRTYJTAG_READ_EP,
+				if (bulk_transfer(dev_handle, DIRTYJTAG_READ_EP,
 											&sig, 1, &actual_length, 1000) < 0)
 				{
 					cerr << "writeTDI: last bit error: usb bulk read failed" << endl;
@@ -359,7 +375,7 @@ int DirtyJtag::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 			}
 			buf[2] &= ~SIG_TCK;
 			buf[3] = CMD_STOP;
-			if (libusb_bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
+			if (bulk_transfer(dev_handle, DIRTYJTAG_WRITE_EP,
 									 buf, 4, &actual_length, 1000) < 0)
 			{
 				cerr << "writeTDI: last bit error: usb bulk write failed 2" << endl;
@@ -21,6 +21,9 @@
 #include "rawParser.hpp"
 #include "spiFlash.hpp"
 
+/* CDONE rise after reset or configuration */
+#define CDONE_TIMEOUT_US 12000000
+
 Efinix::Efinix(FtdiSpi* spi, const std::string &filename,
 			const std::string &file_type,
 			uint16_t rst_pin, uint16_t done_pin,
@@ -86,16 +89,11 @@ void Efinix::reset()
 {
 	if (_ftdi_jtag)  // not supported
 		return;
-	uint32_t timeout = 1000;
 	_spi->gpio_clear(_rst_pin | _oe_pin);
 	usleep(1000);
 	_spi->gpio_set(_rst_pin | _oe_pin);
 	printInfo("Reset ", false);
-	do {
-		timeout--;
-		usleep(12000);
-	} while (((_spi->gpio_get(true) & _done_pin) == 0) || timeout > 0);
-	if (timeout == 0)
+	if (!_spi->gpio_wait(_done_pin, true, CDONE_TIMEOUT_US))
 		printError("FAIL");
 	else
 		printSuccess("DONE");
@@ -145,13 +143,13 @@ void Efinix::program(unsigned int offset, bool unprotect_flash)
 
 bool Efinix::dumpFlash(uint32_t base_addr, uint32_t len)
 {
-	uint32_t timeout = 1000;
 	_spi->gpio_clear(_rst_pin);
 
 	/* prepare SPI access */
 	printInfo("Read Flash ", false);
 	try {
 		SPIFlash flash(reinterpret_cast<SPIInterface *>(_spi), false, _verbose);
+		SPIFlashAddrGuard addr_guard(flash);
 		flash.reset();
 		flash.power_up();
 		flash.dump(_filename, base_addr, len);
@@ -163,14 +161,8 @@ bool Efinix::dumpFlash(uint32_t base_addr, uint32_t len)
 
 	/* release SPI access */
 	_spi->gpio_set(_rst_pin | _oe_pin);
-	usleep(12000);
-
 	printInfo("Wait for CDONE ", false);
-	do {
-		timeout--;
-		usleep(12000);
-	} while (((_spi->gpio_get(true) & _done_pin) == 0) && timeout > 0);
-	if (timeout == 0)
+	if (!_spi->gpio_wait(_done_pin, true, CDONE_TIMEOUT_US))
 		printError("FAIL");
 	else
 		printSuccess("DONE");
@@ -181,32 +173,29 @@ bool Efinix::dumpFlash(uint32_t base_addr, uint32_t len)
 void Efinix::programSPI(unsigned int offset, uint8_t *data, int length,
 		bool unprotect_flash)
 {
-	uint32_t timeout = 1000;
 
 	_spi->gpio_clear(_rst_pin | _oe_pin);
 
-	SPIFlash flash(reinterpret_cast<SPIInterface *>(_spi), unprotect_flash,
-			_verbose);
-	flash.reset();
-	flash.power_up();
+	{
+		SPIFlash flash(reinterpret_cast<SPIInterface *>(_spi), unprotect_flash,
+				_verbose);
+		/* 3-byte addressing restored before reset release */
+		SPIFlashAddrGuard addr_guard(flash);
+		flash.reset();
+		flash.power_up();
 
-	printf("%02x\n", flash.read_status_reg());
-	flash.read_id();
-	flash.erase_and_prog(offset, data, length);
+		printf("%02x\n", flash.read_status_reg());
+		flash.read_id();
+		flash.erase_and_prog(offset, data, length);
 
-	/* verify write if required */
-	if (_verify)
-		flash.verify(offset, data, length);
+		/* verify write if required */
+		if (_verify)
+			flash.verify(offset, data, length);
+	}
 
 	_spi->gpio_set(_rst_pin | _oe_pin);
-	usleep(12000);
-
 	printInfo("Wait for CDONE ", false);
-	do {
-		timeout--;
-		usleep(12000);
-	} while (((_spi->gpio_get(true) & _done_pin) == 0) && timeout > 0);
-	if (timeout == 0)
+	if (!_spi->gpio_wait(_done_pin, true, CDONE_TIMEOUT_US))
 		printError("FAIL");
 	else
 		printSuccess("DONE");
@@ -222,8 +211,7 @@ void Efinix::programSPI(unsigned int offset, uint8_t *data, int length,
 
 void Efinix::programJTAG(uint8_t *data, int length)
 {
-	int xfer_len = 512, tx_end;
-	uint8_t tx[512];
+	uint8_t tx[13];
 
 	/* trion has to be reseted with cs low */
 	_spi->gpio_clear(_oe_pin | _cs_pin | _rst_pin);
@@ -245,19 +233,8 @@ void Efinix::programJTAG(uint8_t *data, int length)
 
 	ProgressBar progress("Load SRAM", length, 50, _quiet);
 
-	for (int i = 0; i < length; i+=xfer_len) {
-		if (i + xfer_len > length) {  // last packet
-			xfer_len = (length - i);
-			tx_end = Jtag::EXIT1_DR;
-		} else {
-			tx_end = Jtag::SHIFT_DR;
-		}
-		for (int pos = 0; pos < xfer_len; pos++)
-			tx[pos] = EfinixHexParser::reverseByte(data[i+pos]);
-
-		_jtag->shiftDR(tx, NULL, xfer_len*8, tx_end);
-		progress.display(i);
-	}
+	_jtag->shiftDR_stream(data, length, Jtag::EXIT1_DR,
+		[&progress](uint32_t done) { progress.display(done); }, true);
 
 	progress.done();
 
@@ -265,7 +242,7 @@ void Efinix::programJTAG(uint8_t *data, int length)
 
 	_jtag->shiftIR(ENTERUSER, IRLENGTH, Jtag::EXIT1_IR);
 
-	memset(tx, 0, 512);
+	memset(tx, 0, sizeof(tx));
 	_jtag->shiftDR(tx, NULL, 100);
 	_jtag->shiftIR(IDCODE, IRLENGTH);
 }
@@ -9,6 +9,7 @@
 #include "configBitstreamParser.hpp"
 #include "display.hpp"
 #include "efinixHexParser.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -19,6 +20,7 @@ EfinixHexParser::EfinixHexParser(const string &filename):
 
 int EfinixHexParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	string buffer;
 	istringstream lineStream(_raw_data);
 
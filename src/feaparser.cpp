@@ -19,6 +19,7 @@
 
 #include "display.hpp"
 #include "feaparser.hpp"
+#include "usbStats.hpp"
 
 /* FEAbits element defines */
 #  define FEA_I2C_DG_FIL_EN			(1 << 0)	/* I2C deglitch filter enable for Primary I2C Port 0=Disabled (Default), 1=Enabled */
@@ -249,6 +250,7 @@ void FeaParser::parseFeatureRowAndFeabits(const vector<string> &content)
 
 int FeaParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	std::vector<string>lines;
 
 	_ss.str(_raw_data);
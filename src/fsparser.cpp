@@ -10,6 +10,7 @@
 
 #include "fsparser.hpp"
 #include "display.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -122,6 +123,7 @@ int FsParser::parseHeader()
 
 int FsParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	string tmp;
 	/* GW1N-6 and GW1N(R)-9 are address length not multiple of byte */
 	int padding = 0;
@@ -13,9 +13,11 @@
 #include <string>
 #include <stdexcept>
 
+#include "bitOps.hpp"
 #include "display.hpp"
 #include "ftdiJtagBitbang.hpp"
 #include "ftdipp_mpsse.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -42,6 +44,11 @@ FtdiJtagBitBang::FtdiJtagBitBang(const FTDIpp_MPSSE::mpsse_bit_config &cable,
 	_tms_pin = pin_conf->tms_pin;
 	_tdi_pin = pin_conf->tdi_pin;
 	_tdo_pin = pin_conf->tdo_pin;
+	for (_tdo_shift = 0; _tdo_shift < 7; _tdo_shift++) {
+		if (_tdo_pin & (1 << _tdo_shift))
+			break;
+	}
+	build_lut();
 
 	/* store FTDI TX Fifo size */
 	if (_pid == 0x6001)  // FT232R
@@ -96,15 +103,36 @@ int FtdiJtagBitBang::setBitmode(uint8_t mode)
 	_bitmode = mode;
 
 	int ret = ftdi_set_bitmode(_ftdi, _tck_pin | _tms_pin | _tdi_pin, _bitmode);
+	/* echoes are always fully read in SYNCBB mode: only stale
+	 * data received before must be dropped
+	 */
+	if (_bitmode == BITMODE_SYNCBB) {
 #if (FTDI_VERSION < 105)
-	ftdi_usb_purge_rx_buffer(_ftdi);
-	ftdi_usb_purge_tx_buffer(_ftdi);
+		ftdi_usb_purge_rx_buffer(_ftdi);
 #else
-	ftdi_tcioflush(_ftdi);
+		ftdi_tciflush(_ftdi);
 #endif
+	}
 	return ret;
 }
 
+void FtdiJtagBitBang::build_lut()
+{
+	for (int bits = 0; bits < 16; bits++) {
+		for (int i = 0; i < 4; i++) {
+			bool bit = (bits >> i) & 0x01;
+			for (int tms = 0; tms < 2; tms++) {
+				uint8_t val = ((tms) ? _tms_pin : 0) | ((bit) ? _tdi_pin : 0);
+				_tdi_lut[tms][bits][2 * i    ] = val;
+				_tdi_lut[tms][bits][2 * i + 1] = val | _tck_pin;
+			}
+			uint8_t val = _tdi_pin | ((bit) ? _tms_pin : 0);
+			_tms_lut[bits][2 * i    ] = val;
+			_tms_lut[bits][2 * i + 1] = val | _tck_pin;
+		}
+	}
+}
+
 int FtdiJtagBitBang::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 {
 	int ret;
@@ -120,21 +148,27 @@ int FtdiJtagBitBang::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 		return 0;
 	}
 
-	/* check for at least one bit space in buffer */
-	if (_num+2 > _buffer_size) {
+	/* check for at least four bits space in buffer */
+	if (_num + 8 > _buffer_size) {
 		ret = flush();
 		if (ret < 0)
 			return ret;
 	}
 
-	/* fill buffer to reduce USB transaction */
-	for (uint32_t i = 0; i < len; i++) {
-		_curr_tms = ((tms[i >> 3] & (1 << (i & 0x07)))? _tms_pin : 0);
-		uint8_t val = _tdi_pin | _curr_tms;
-		_buffer[_num++] = val;
-		_buffer[_num++] = val | _tck_pin;
-
-		if (_num + 2 > _buffer_size) {
+	/* fill buffer to reduce USB transaction: 4 bits per lookup,
+	 * the first two samples of an entry encode its bit 0
+	 */
+	for (uint32_t i = 0; i < len;) {
+		uint8_t bits = (tms[i >> 3] >> (i & 0x07)) & 0x0f;
+		int nb = (len - i >= 4) ? 4 : 1;
+		memcpy(_buffer + _num, _tms_lut[bits & ((nb == 4) ? 0x0f : 0x01)],
+			2 * nb);
+		_num += 2 * nb;
+		i += nb;
+		_curr_tms = ((tms[(i - 1) >> 3] >> ((i - 1) & 0x07)) & 0x01) ?
+			_tms_pin : 0;
+
+		if (_num + 8 > _buffer_size) {
 			ret = write(NULL, 0);
 			if (ret < 0)
 				return ret;
@@ -151,55 +185,65 @@ int FtdiJtagBitBang::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 	return len;
 }
 
-int FtdiJtagBitBang::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
+void FtdiJtagBitBang::encode_tdi(const uint8_t *tx, uint32_t len, bool end)
 {
-	uint32_t iter;
-	uint32_t xfer_size = (rx) ? _rx_size : _buffer_size;
-	if (len * 2 + 1 < xfer_size) {
-		iter = len;
-	} else {
-		iter = xfer_size >> 1;  // two tx / bit
-		iter = (iter / 8) * 8;
+	/* bits sent with current TMS */
+	uint32_t nb = (end) ? len - 1 : len;
+	int tms = (_curr_tms) ? 1 : 0;
+	uint32_t i = 0;
+
+	for (; i + 4 <= nb; i += 4) {
+		uint8_t bits = (tx) ? (tx[i >> 3] >> (i & 0x04)) & 0x0f : 0;
+		memcpy(_buffer + _num, _tdi_lut[tms][bits], 8);
+		_num += 8;
+	}
+	/* tail: the first two samples of an entry encode its bit 0 */
+	for (; i < len; i++) {
+		if (i == nb) {
+			_curr_tms = _tms_pin;
+			tms = 1;
+		}
+		uint8_t bit = (tx) ? (tx[i >> 3] >> (i & 0x07)) & 0x01 : 0;
+		memcpy(_buffer + _num, _tdi_lut[tms][bit], 2);
+		_num += 2;
 	}
+}
 
-	uint8_t *rx_ptr = rx;
+int FtdiJtagBitBang::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
+{
+	/* reads are limited by converter FIFO (one echo byte per sample) */
+	uint32_t rx_bits = (_rx_size / 2) & ~0x07;
 
 	if (len == 0)
 		return 0;
-	if (rx)
-		memset(rx, 0, len/8);
-
-	/* quick fix: use an empty buffer */
-	if (_num != 0)
-		flush();
-
-	for (uint32_t i = 0, pos = 0; i < len; i++) {
-		/* keep tms or
-		 * set tms high if it's last bit and end true */
-		if (end && (i == len -1))
-			_curr_tms = _tms_pin;
-		uint8_t val = _curr_tms;
 
-		if (tx)
-			val |= ((tx[i >> 3] & (1 << (i & 0x07)))? _tdi_pin : 0);
-		_buffer[_num    ] = val;
-		_buffer[_num + 1] = val | _tck_pin;
-
-		_num += 2;
-
-		pos++;
-		/* flush buffer */
-		if (pos == iter) {
-			pos = 0;
-			write((rx) ? rx_ptr : NULL, iter);
-			if (rx)
-				rx_ptr += (iter/8);
-		}
+	/* echoes are decoded from buffer start */
+	if (rx && _num != 0) {
+		if (flush() < 0)
+			return -1;
 	}
 
-	/* security check: try to flush buffer */
-	if (_num != 0) {
-		write((rx && _num > 1) ? rx_ptr : NULL, _num / 2);
+	for (uint32_t pos = 0; pos < len;) {
+		/* chunks start on a byte boundary */
+		uint32_t room = ((_buffer_size - _num) / 2) & ~0x07;
+		if (room == 0) {
+			if (write(NULL, 0) < 0)
+				return -1;
+			continue;
+		}
+		uint32_t xfer = len - pos;
+		if (xfer > room)
+			xfer = room;
+		if (rx && xfer > rx_bits)
+			xfer = rx_bits;
+
+		encode_tdi((tx) ? tx + (pos >> 3) : NULL, xfer,
+			end && (pos + xfer == len));
+
+		/* write only samples stay in buffer (async bitbang) */
+		if (rx && write(rx + (pos >> 3), xfer) < 0)
+			return -1;
+		pos += xfer;
 	}
 
 	return len;
@@ -239,28 +283,32 @@ int FtdiJtagBitBang::write(uint8_t *tdo, int nb_bit)
 
 	setBitmode((tdo) ? BITMODE_SYNCBB : BITMODE_BITBANG);
 
+	uint64_t start = UsbStats::now();
 	ret = ftdi_write_data(_ftdi, _buffer, _num);
+	UsbStats::write(_num, start);
 	if (ret != _num) {
 		printf("problem %d written\n", ret);
 		return ret;
 	}
 
 	if (tdo) {
+		start = UsbStats::now();
 		ret = ftdi_read_data(_ftdi, _buffer, _num);
+		UsbStats::read(_num, start);
 		if (ret != _num) {
 			printf("problem %d read\n", ret);
 			return ret;
 		}
-		/* need to reconstruct received word 
-		 * even bit are discarded since JTAG read in rising edge
-		 * since jtag is LSB first we need to shift right content by 1
-		 * and add 0x80 (1 << 7) or 0
-		 * the buffer may contains some tms bit, so start with i
-		 * equal to fill exactly nb_bit bits
-		 * */
-		for (int i = (_num-(nb_bit *2) + 1), offset=0; i < _num; i+=2, offset++) {
-			tdo[offset >> 3] = (((_buffer[i] & _tdo_pin) ? 0x80 : 0x00) |
-							(tdo[offset >> 3] >> 1));
+		/* TDO is sampled with TCK rising edge: echo of the second sample
+		 * of each bit. Bits are LSB first, starting at the byte boundary.
+		 */
+		const uint8_t *samples = _buffer + _num - (nb_bit * 2) + 1;
+		for (int i = 0; i < nb_bit; i += 8) {
+			int nb = (nb_bit - i > 8) ? 8 : nb_bit - i;
+			uint8_t val = 0;
+			for (int b = 0; b < nb; b++)
+				val |= ((samples[2 * (i + b)] >> _tdo_shift) & 0x01) << b;
+			tdo[i >> 3] = val;
 		}
 	}
 	_num = 0;
@@ -36,6 +36,10 @@ class FtdiJtagBitBang : public JtagInterface, private FTDIpp_MPSSE {
 	/* TDI */
 	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) override;
 	int toggleClk(uint8_t tms, uint8_t tdo, uint32_t clk_len) override;
+	/* delay: host sleep (each clock cycle costs 2 bytes) */
+	int waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms) override {
+		return sleepUs(min_us, min_clocks, tms);
+	}
 
 	/*!
 	 * \brief return internal buffer size (in byte).
@@ -51,6 +55,17 @@ class FtdiJtagBitBang : public JtagInterface, private FTDIpp_MPSSE {
  private:
 	int write(uint8_t *tdo, int nb_bit);
 	int setBitmode(uint8_t mode);
+	/*!
+	 * \brief fill sample lookup tables (pins are only known at runtime)
+	 */
+	void build_lut();
+	/*!
+	 * \brief store len TDI bits samples in _buffer
+	 * \param[in] tx: TDI bits (LSB first), NULL to send 0
+	 * \param[in] len: number of bits
+	 * \param[in] end: set TMS high with last bit
+	 */
+	void encode_tdi(const uint8_t *tx, uint32_t len, bool end);
 
 	uint8_t _bitmode;
 	uint8_t _tck_pin; /*!< tck pin: 1 << pin id */
@@ -59,5 +74,10 @@ class FtdiJtagBitBang : public JtagInterface, private FTDIpp_MPSSE {
 	uint8_t _tdi_pin; /*!< tdi pin: 1 << pin id */
 	uint8_t _curr_tms;
 	int _rx_size;
+	uint8_t _tdo_shift; /*!< tdo pin id */
+	/*!< (TCK low, TCK high) samples for 4 TDI bits [tms][bits] */
+	uint8_t _tdi_lut[2][16][8];
+	/*!< (TCK low, TCK high) samples for 4 TMS bits, TDI high [bits] */
+	uint8_t _tms_lut[16][8];
 };
 #endif
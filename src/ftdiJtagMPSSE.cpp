@@ -35,7 +35,9 @@ FtdiJtagMPSSE::FtdiJtagMPSSE(const FTDIpp_MPSSE::mpsse_bit_config &cable,
 			FTDIpp_MPSSE(cable, dev, serial, clkHZ, verbose), _ch552WA(false),
 			_write_mode(MPSSE_WRITE_NEG),  // always write on neg edge
 			_read_mode(0),
-			_invert_read_edge(invert_read_edge) // false: pos, true: neg
+			_invert_read_edge(invert_read_edge), // false: pos, true: neg
+			_deferred_read(false), _pending_len(0), _inflight_len(0),
+			_cmd_pos(-1), _cmd_end(0), _cmd_xfer(0)
 {
 	init_internal(cable);
 }
@@ -43,6 +45,8 @@ FtdiJtagMPSSE::FtdiJtagMPSSE(const FTDIpp_MPSSE::mpsse_bit_config &cable,
 FtdiJtagMPSSE::~FtdiJtagMPSSE()
 {
 	int read;
+	/* resolve reads still queued (if any) */
+	read_pending();
 	/* Before shutdown, we must wait until everything is shifted out
 	 * Do this by temporary enabling loopback mode, write something
 	 * and wait until we can read it back
@@ -76,6 +80,10 @@ void FtdiJtagMPSSE::init_internal(const FTDIpp_MPSSE::mpsse_bit_config &cable)
 	display("%x\n", cable.bit_high_val);
 	display("%x\n", cable.bit_high_dir);
 
+	/* ch552 firmware expects small transfers */
+	if (!_ch552WA)
+		mpsse_set_buffer_size(MPSSE_BUFFER_MAX);
+
 	if (init(5, 0xfb, BITMODE_MPSSE) != 0)
 		throw std::runtime_error("low level FTDI init failed");
 	config_edge();
@@ -102,9 +110,52 @@ void FtdiJtagMPSSE::config_edge()
 	}
 }
 
+uint8_t *FtdiJtagMPSSE::last_cmd(uint8_t opcode)
+{
+	if (_ch552WA || _cmd_pos < 0 || _cmd_xfer != _nb_xfer ||
+			_cmd_end != _num || _buffer[_cmd_pos] != opcode)
+		return NULL;
+	return _buffer + _cmd_pos;
+}
+
+void FtdiJtagMPSSE::store_cmd(uint8_t *cmd, int len, uint8_t *payload,
+		int payload_len)
+{
+	int total = len + ((payload) ? payload_len : 0);
+	/* keep command and payload in the same transfer when possible */
+	if (_num + total > _buffer_size)
+		mpsse_write();
+	mpsse_store(cmd, len);
+	if (payload)
+		mpsse_store(payload, payload_len);
+	/* negative when split across two transfers: can't be extended */
+	_cmd_pos = _num - total;
+	_cmd_end = _num;
+	_cmd_xfer = _nb_xfer;
+}
+
+bool FtdiJtagMPSSE::merge_bytes(uint8_t opcode, uint8_t *payload, int len)
+{
+	uint8_t *cmd = last_cmd(opcode);
+	if (!cmd)
+		return false;
+	/* length field: 16 bits, value is length - 1 */
+	int prev = (cmd[1] | (cmd[2] << 8)) + 1;
+	if (prev + len > 0x10000)
+		return false;
+	if (payload && _num + len > _buffer_size)
+		return false;
+
+	cmd[1] = ((prev + len - 1)     ) & 0xff;
+	cmd[2] = ((prev + len - 1) >> 8) & 0xff;
+	if (payload)
+		mpsse_store(payload, len);
+	_cmd_end = _num;
+	return true;
+}
+
 int FtdiJtagMPSSE::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 {
-	(void) flush_buffer;
 	display("%s %d %d\n", __func__, len, (len/8)+1);
 
 	if (len == 0)
@@ -117,6 +168,16 @@ int FtdiJtagMPSSE::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 	uint8_t buf[3]= {static_cast<unsigned char>(MPSSE_WRITE_TMS | MPSSE_LSB |
 						MPSSE_BITMODE | _write_mode),
 						0, 0};
+
+	/* complete previous TMS command (up to 6 bits, same TDI state) */
+	uint8_t *cmd = last_cmd(buf[0]);
+	if (cmd && (cmd[2] & 0x80)) {
+		for (; xfer > 0 && cmd[1] < 5; xfer--, offset++) {
+			cmd[1]++;
+			cmd[2] |= ((tms[offset >> 3] >> (offset & 0x07)) & 0x01) << cmd[1];
+		}
+	}
+
 	while (xfer > 0) {
 		int bit_to_send = (xfer > 6) ? 6 : xfer;
 		buf[1] = bit_to_send-1;
@@ -128,18 +189,17 @@ int FtdiJtagMPSSE::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
 		}
 		pos+=3;
 
-		mpsse_store(buf, 3);
-		if (pos == iter * 3) {
+		store_cmd(buf, 3, NULL, 0);
+		/* ch552 firmware requires a read after each write */
+		if (_ch552WA && pos == iter * 3) {
 			pos = 0;
 			if (mpsse_write() < 0)
 				printf("writeTMS: error\n");
 
-			if (_ch552WA) {
-				uint8_t c[len/8+1];
-				int ret = ftdi_read_data(_ftdi, c, len/8+1);
-				if (ret != 0) {
-					printf("ret : %d\n", ret);
-				}
+			uint8_t c[len/8+1];
+			int ret = ftdi_read_data(_ftdi, c, len/8+1);
+			if (ret != 0) {
+				printf("ret : %d\n", ret);
 			}
 		}
 		xfer -= bit_to_send;
@@ -175,10 +235,13 @@ int FtdiJtagMPSSE::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 			if (chunk  > 8) {
 				unsigned cycles8 = chunk / 8;
 				len -= cycles8 * 8;
-				cycles8 --;
-				buf[1] = ((cycles8)		) & 0xff;
-				buf[2] = ((cycles8) >> 8) & 0xff;
-				mpsse_store(buf, 3);
+				/* extend previous clock command when possible */
+				if (!merge_bytes(buf[0], NULL, cycles8)) {
+					cycles8 --;
+					buf[1] = ((cycles8)		) & 0xff;
+					buf[2] = ((cycles8) >> 8) & 0xff;
+					store_cmd(buf, 3, NULL, 0);
+				}
 			}
 			if (len && len < 9) {
 				buf[0] = 0x8E;
@@ -200,15 +263,151 @@ int FtdiJtagMPSSE::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 
 int FtdiJtagMPSSE::flush()
 {
-	return mpsse_write();
+	if (!_pending_reads.empty() || !_inflight_reads.empty())
+		return read_pending();
+	int ret = mpsse_write();
+	/* flush is a synchronisation point (sleep, GPIO access...) */
+	if (ret >= 0 && mpsse_sync() < 0)
+		return -1;
+	return ret;
+}
+
+bool FtdiJtagMPSSE::setDeferredRead(bool enable)
+{
+	/* ch552 firmware requires a read after each write */
+	if (_ch552WA)
+		return false;
+	if (!enable)
+		read_pending();
+	_deferred_read = enable;
+	return enable;
+}
+
+void FtdiJtagMPSSE::reserve_read(int xfer_len)
+{
+	/* converter output fifo is limited: never queue
+	 * more answers than it can hold
+	 */
+	if (_pending_len + xfer_len > mpsse_get_read_size()) {
+		if (_ch552WA)
+			read_pending();
+		else
+			submit_reads();
+	}
+}
+
+void FtdiJtagMPSSE::add_read(uint8_t *rx, uint16_t len, uint8_t kind)
+{
+	_pending_reads.push_back({rx, len, kind});
+	_pending_len += (kind == READ_BYTES) ? len : 1;
+}
+
+int FtdiJtagMPSSE::submit_reads()
+{
+	if (_pending_reads.empty())
+		return 0;
+
+	/* commands are sent before waiting for the previous batch */
+	int ret = mpsse_write();
+	if (ret < 0)
+		return ret;
+	if ((ret = wait_reads()) < 0)
+		return ret;
+
+	_inflight_reads.swap(_pending_reads);
+	_pending_reads.clear();
+	_inflight_len = _pending_len;
+	_pending_len = 0;
+	_inflight_rx.resize(_inflight_len);
+
+	ret = mpsse_read_submit(_inflight_rx.data(), _inflight_len);
+	if (ret < 0) {
+		printf("read_pending: error %d\n", ret);
+		_inflight_reads.clear();
+		_inflight_len = 0;
+	}
+	return ret;
+}
+
+int FtdiJtagMPSSE::wait_reads()
+{
+	if (_inflight_reads.empty())
+		return 0;
+
+	int ret = mpsse_read_wait();
+	if (ret != _inflight_len) {
+		printf("read_pending: error %d\n", ret);
+		_inflight_reads.clear();
+		_inflight_len = 0;
+		return (ret < 0) ? ret : -1;
+	}
+
+	uint8_t *ptr = _inflight_rx.data();
+	for (auto &p : _inflight_reads) {
+		switch (p.kind) {
+		case READ_BYTES:
+			memcpy(p.rx, ptr, p.len);
+			ptr += p.len;
+			break;
+		case READ_BITS:
+			/* realign we have read len bits
+			 * since LSB add bit by the left and shift
+			 * we need to complete shift
+			 */
+			*p.rx = *ptr++ >> (8 - p.len);
+			break;
+		case READ_BITS_MSB:
+			/* MSB first: bits are shifted to the left */
+			*p.rx = *ptr++ << (8 - p.len);
+			break;
+		case READ_LAST_MSB:
+			/* first bit of the byte is stored in bit 7 */
+			if (p.len == 7)
+				*p.rx = *ptr++ & 0x80;
+			else
+				*p.rx |= ((*ptr++ >> 7) & 0x01) << p.len;
+			break;
+		case READ_LAST:
+			/* with TMS command TDO is always in bit 7 */
+			if (p.len == 0)
+				*p.rx = (*ptr++ >> 7) & 0x01;
+			else
+				*p.rx |= ((*ptr++ >> 7) & 0x01) << p.len;
+			break;
+		}
+	}
+	_inflight_reads.clear();
+	_inflight_len = 0;
+
+	return ret;
+}
+
+int FtdiJtagMPSSE::read_pending()
+{
+	int ret = submit_reads();
+	if (ret < 0) {
+		_pending_reads.clear();
+		_pending_len = 0;
+		return ret;
+	}
+	return wait_reads();
 }
 
 int FtdiJtagMPSSE::writeTDI(uint8_t *tdi, uint8_t *tdo, uint32_t len, bool last)
+{
+	return writeTDI(tdi, tdo, len, last, false);
+}
+
+int FtdiJtagMPSSE::writeTDI(uint8_t *tdi, uint8_t *tdo, uint32_t len, bool last,
+		bool msb_first)
 {
 	/* 3 possible case :
 	 *  - n * 8bits to send -> use byte command
 	 *  - less than 8bits   -> use bit command
 	 *  - last bit to send  -> sent in conjunction with TMS
+	 * reads are queued and resolved in one transfer at the end
+	 * (or at flush time in deferred mode). Write only commands stay
+	 * in buffer (merged with next ones) up to a read or a flush
 	 */
 	int tx_buff_size = mpsse_get_buffer_size();
 	int real_len = (last) ? len - 1 : len;  // if its a buffer in a big send send len
@@ -216,10 +415,12 @@ int FtdiJtagMPSSE::writeTDI(uint8_t *tdi, uint8_t *tdo, uint32_t len, bool last)
 	int nb_byte = real_len >> 3;    // number of byte to send
 	int nb_bit = (real_len & 0x07); // residual bits
 	int xfer = tx_buff_size - 3;
+	if (tdo && xfer > mpsse_get_read_size())
+		xfer = mpsse_get_read_size();
 	unsigned char c[xfer];
 	unsigned char *rx_ptr = (unsigned char *)tdo;
 	unsigned char *tx_ptr = (unsigned char *)tdi;
-	unsigned char tx_buf[3] = {(unsigned char)(MPSSE_LSB |
+	unsigned char tx_buf[3] = {(unsigned char)(((msb_first) ? 0 : MPSSE_LSB) |
 						((tdi) ? (MPSSE_DO_WRITE | _write_mode) : 0) |
 						((tdo) ? (MPSSE_DO_READ | _read_mode) : 0)),
 						static_cast<unsigned char>((xfer - 1) & 0xff),       // low
@@ -228,9 +429,6 @@ int FtdiJtagMPSSE::writeTDI(uint8_t *tdi, uint8_t *tdo, uint32_t len, bool last)
 	display("%s len : %d %d %d %d\n", __func__, len, real_len, nb_byte,
 		nb_bit);
 
-	if ((nb_byte + _num + 3) > _buffer_size)
-		mpsse_write();
-
 	if ((nb_byte * 8) + nb_bit != real_len) {
 		printf("pas cool\n");
 		throw std::exception();
@@ -248,68 +446,51 @@ int FtdiJtagMPSSE::writeTDI(uint8_t *tdi, uint8_t *tdo, uint32_t len, bool last)
 		int xfer_len = (nb_byte > xfer) ? xfer : nb_byte;
 		tx_buf[1] = (((xfer_len - 1)     ) & 0xff);  // low
 		tx_buf[2] = (((xfer_len - 1) >> 8) & 0xff);  // high
-		mpsse_store(tx_buf, 3);
-		if (tdi) {
-			mpsse_store(tx_ptr, xfer_len);
+		if (tdo)
+			reserve_read(xfer_len);
+		/* consecutive scans are merged in one command */
+		if (!merge_bytes(tx_buf[0], tx_ptr, xfer_len))
+			store_cmd(tx_buf, 3, tx_ptr, xfer_len);
+		if (tdi)
 			tx_ptr += xfer_len;
-		}
 		if (tdo) {
-			mpsse_read(rx_ptr, xfer_len);
+			add_read(rx_ptr, xfer_len, READ_BYTES);
+			if (_ch552WA)
+				read_pending();
 			rx_ptr += xfer_len;
 		} else if (_ch552WA) {
 			mpsse_write();
 			ftdi_read_data(_ftdi, c, xfer_len);
-		} else if (!last) {
-			mpsse_write();
 		}
 		nb_byte -= xfer_len;
 	}
 
-	unsigned char last_bit = (tdi) ? *tx_ptr : 0;
-	bool double_write = true;
-
 	if (nb_bit != 0) {
 		display("%s read/write %d bit\n", __func__, nb_bit);
 		tx_buf[0] |= MPSSE_BITMODE;
 		tx_buf[1] = nb_bit - 1;
+		if (tdo)
+			reserve_read(1);
 		mpsse_store(tx_buf, 2);
 		if (tdi) {
-			display("%s last_bit %x size %d\n", __func__, last_bit, nb_bit-1);
-			mpsse_store(last_bit);
+			display("%s last_bit %x size %d\n", __func__, *tx_ptr, nb_bit-1);
+			mpsse_store(*tx_ptr);
 		}
-		if (tdo && !last) {
-			mpsse_read(rx_ptr, 1);
-			double_write = false;
-			/* realign we have read nb_bit
-			 * since LSB add bit by the left and shift
-			 * we need to complete shift
-			 */
-			*rx_ptr >>= (8 - nb_bit);
-			display("%s %x\n", __func__, *rx_ptr);
+		if (tdo) {
+			add_read(rx_ptr, nb_bit, (msb_first) ? READ_BITS_MSB : READ_BITS);
+			if (_ch552WA)
+				read_pending();
 		} else if (_ch552WA) {
-			if (tdo) {
-				mpsse_read(rx_ptr, 1);
-				double_write = false;
-				*rx_ptr >>= (8 - nb_bit);
-			} else {
-				mpsse_write();
-				ftdi_read_data(_ftdi, c, nb_bit);
-			}
-		} else if (!last) {
 			mpsse_write();
+			ftdi_read_data(_ftdi, c, nb_bit);
 		}
 	}
 
-	/* display : must be dropped */
-	if (_verbose && tdo) {
-		display("\n");
-		for (int i = (len / 8) - 1; i >= 0; i--)
-			display("%x ", (unsigned char)tdo[i]);
-		display("\n");
-	}
-
 	if (last == 1) {
-		last_bit = (tdi)? (*tx_ptr & (1 << nb_bit)) : 0;
+		/* last bit is real_len, nb_bit may be 8 (see above) */
+		int last_pos = (msb_first) ? 7 - (real_len & 0x07) : (real_len & 0x07);
+		unsigned char last_bit = (tdi) ?
+			(tdi[real_len >> 3] & (1 << last_pos)) : 0;
 
 		display("%s move to EXIT1_xx and send last bit %x\n", __func__, (last_bit?0x81:0x01));
 		/* write the last bit in conjunction with TMS */
@@ -318,24 +499,31 @@ int FtdiJtagMPSSE::writeTDI(uint8_t *tdi, uint8_t *tdo, uint32_t len, bool last)
 		tx_buf[1] = 0x0;  // send 1bit
 		tx_buf[2] = ((last_bit) ? 0x81 : 0x01);  // we know in TMS tdi is bit 7
 							// and to move to EXIT_XR TMS = 1
-		mpsse_store(tx_buf, 3);
 		if (tdo) {
-			unsigned char c[2];
-			int index = 0;
-			mpsse_read(c, 1 + ((double_write)?1:0));
-			if (double_write) {
-				*rx_ptr = c[index] >> (8-nb_bit);
-				index++;
-			}
-			/* in this case for 1 one it's always bit 7 */
-			*rx_ptr |= ((c[index] & 0x80) << (7 - nb_bit));
-		} else if (_ch552WA) {
-			mpsse_write();
-			ftdi_read_data(_ftdi, c, 1);
+			reserve_read(1);
+			mpsse_store(tx_buf, 3);
+			add_read(tdo + (real_len >> 3), last_pos,
+				(msb_first) ? READ_LAST_MSB : READ_LAST);
 		} else {
-			mpsse_write();
+			/* TMS bits of the next state move are appended */
+			store_cmd(tx_buf, 3, NULL, 0);
+			if (_ch552WA) {
+				mpsse_write();
+				ftdi_read_data(_ftdi, c, 1);
+			}
 		}
 	}
 
+	if (tdo && !_deferred_read)
+		read_pending();
+
+	/* display : must be dropped */
+	if (_verbose && tdo && !_deferred_read) {
+		display("\n");
+		for (int i = (len / 8) - 1; i >= 0; i--)
+			display("%x ", (unsigned char)tdo[i]);
+		display("\n");
+	}
+
 	return 0;
 }
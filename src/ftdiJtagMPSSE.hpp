@@ -37,6 +37,11 @@ class FtdiJtagMPSSE : public JtagInterface, public FTDIpp_MPSSE {
 	int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override;
 	/* TDI */
 	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) override;
+	/*!
+	 * \brief MSB first is natively supported by MPSSE: no bit reversal
+	 */
+	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end,
+		bool msb_first) override;
 
 	/*!
 	 * \brief return internal buffer size (in byte).
@@ -48,7 +53,79 @@ class FtdiJtagMPSSE : public JtagInterface, public FTDIpp_MPSSE {
 
 	int flush() override;
 
+	bool setDeferredRead(bool enable) override;
+
  private:
+	/* pending read kind */
+	enum {
+		READ_BYTES = 0,     /**< len bytes stored as is */
+		READ_BITS  = 1,     /**< one byte with len bits to realign */
+		READ_LAST  = 2,     /**< TDO in bit 7, stored at bit position len */
+		READ_BITS_MSB = 3,  /**< same as READ_BITS with MSB first */
+		READ_LAST_MSB = 4   /**< same as READ_LAST with MSB first */
+	};
+	typedef struct {
+		uint8_t *rx;  /**< destination buffer */
+		uint16_t len; /**< bytes, bits or bit position (see kind) */
+		uint8_t kind; /**< READ_xxx */
+	} pending_read_t;
+	/*!
+	 * \brief register a read command already (or about to be) stored in
+	 *        mpsse buffer. Pending reads are resolved before len bytes
+	 *        may exceed converter capacity
+	 * \param[in] rx: destination buffer
+	 * \param[in] len: see pending_read_t
+	 * \param[in] kind: READ_xxx
+	 */
+	void add_read(uint8_t *rx, uint16_t len, uint8_t kind);
+	/*!
+	 * \brief check space for xfer_len read bytes, submit pending
+	 *        reads when required
+	 */
+	void reserve_read(int xfer_len);
+	/*!
+	 * \brief send mpsse buffer and start reading all pending bytes in
+	 *        one background transfer. The batch already in flight
+	 *        is completed first: TDO of one batch is received while
+	 *        the commands of the next one are sent
+	 * \return < 0 on error
+	 */
+	int submit_reads();
+	/*!
+	 * \brief wait end of the batch in flight and dispatch bytes to their
+	 *        destination buffers
+	 * \return number of bytes read, < 0 on error
+	 */
+	int wait_reads();
+	/*!
+	 * \brief send mpsse buffer, read all pending bytes
+	 *        and dispatch them to their destination buffers
+	 * \return number of bytes read, < 0 on error
+	 */
+	int read_pending();
+
+	/*!
+	 * \brief last command stored when still at the end of mpsse buffer
+	 *        (not yet sent) and using opcode, to be extended in place
+	 * \param[in] opcode: expected MPSSE command
+	 * \return command pointer or NULL
+	 */
+	uint8_t *last_cmd(uint8_t opcode);
+	/*!
+	 * \brief store a command (and its payload) that may be extended by
+	 *        the next one (see last_cmd)
+	 */
+	void store_cmd(uint8_t *cmd, int len, uint8_t *payload, int payload_len);
+	/*!
+	 * \brief extend previous byte command (same opcode) with len bytes
+	 *        (or len * 8 clock cycles for clock only command)
+	 * \param[in] opcode: MPSSE command
+	 * \param[in] payload: bytes to append, may be NULL
+	 * \param[in] len: number of bytes (or 8 clock cycles)
+	 * \return false if a new command must be stored
+	 */
+	bool merge_bytes(uint8_t opcode, uint8_t *payload, int len);
+
 	void init_internal(const FTDIpp_MPSSE::mpsse_bit_config &cable);
 	/*!
 	 * \brief configure read and write edge (pos or neg), with freq < 15MHz
@@ -60,5 +137,14 @@ class FtdiJtagMPSSE : public JtagInterface, public FTDIpp_MPSSE {
 	uint8_t _write_mode; /**< write edge configuration */
 	uint8_t _read_mode; /**< read edge configuration */
 	bool _invert_read_edge; /**< read edge selection (false: pos, true: neg) */
+	bool _deferred_read; /**< pending reads resolved at flush only */
+	int _pending_len; /**< number of bytes expected by pending reads */
+	std::vector<pending_read_t> _pending_reads; /**< pending reads list */
+	int _inflight_len; /**< number of bytes expected by batch in flight */
+	std::vector<pending_read_t> _inflight_reads; /**< batch in flight */
+	std::vector<uint8_t> _inflight_rx; /**< receive buffer of the batch */
+	int _cmd_pos; /**< last_cmd offset in _buffer (-1: none) */
+	int _cmd_end; /**< _num after last_cmd and its payload */
+	uint32_t _cmd_xfer; /**< _nb_xfer when last_cmd was stored */
 };
 #endif
@@ -9,6 +9,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
 
@@ -19,6 +20,7 @@
 
 #include "display.hpp"
 #include "ftdipp_mpsse.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -30,8 +32,10 @@ FTDIpp_MPSSE::FTDIpp_MPSSE(const mpsse_bit_config &cable, const string &dev,
 				const std::string &serial, uint32_t clkHZ, int8_t verbose):
 				_verbose(verbose > 2), _cable(cable), _vid(0),
 				_pid(0), _bus(-1), _addr(-1),
-				_interface(cable.interface),
-				_clkHZ(clkHZ), _buffer_size(2*32768), _num(0)
+				_interface(cable.interface), _bitmask(0),
+				_xfer_buffer(NULL), _xfer_buffer_size(0), _read_size(0),
+				_wr_idx(0), _rd_tc(NULL), _rd_len(0),
+				_clkHZ(clkHZ), _buffer_size(2*32768), _num(0), _nb_xfer(0)
 {
 	libusb_error ret;
 	char err[256];
@@ -49,12 +53,17 @@ FTDIpp_MPSSE::FTDIpp_MPSSE(const mpsse_bit_config &cable, const string &dev,
 
 	open_device(serial, 115200);
 	_buffer_size = _ftdi->max_packet_size;
+	_xfer_buffer_size = _buffer_size;
+	_read_size = _buffer_size;
 
-	_buffer = (unsigned char *)malloc(sizeof(unsigned char) * _buffer_size);
-	if (!_buffer) {
+	_xfer_buffer = (unsigned char *)malloc(sizeof(unsigned char) *
+			_buffer_size * MPSSE_NB_XFER);
+	if (!_xfer_buffer) {
 		printError("_buffer malloc failed");
 		throw std::runtime_error("_buffer malloc failed");
 	}
+	_buffer = _xfer_buffer;
+	memset(_wr_tc, 0, sizeof(_wr_tc));
 
 	/* search for iProduct -> need to have
 	 * ftdi->usb_dev (libusb_device_handler) -> libusb_device ->
@@ -85,11 +94,16 @@ FTDIpp_MPSSE::~FTDIpp_MPSSE()
 {
 	char err[256];
 	int ret;
+
+	/* transfers still in flight use _xfer_buffer */
+	mpsse_read_wait();
+	mpsse_sync();
+
 	if ((ret = ftdi_set_bitmode(_ftdi, 0, BITMODE_RESET)) < 0) {
 		snprintf(err, sizeof(err), "unable to config pins : %d %s",
 			ret, ftdi_get_error_string(_ftdi));
 		printError(err);
-		free(_buffer);
+		free(_xfer_buffer);
 		return;
 	}
 
@@ -97,13 +111,13 @@ FTDIpp_MPSSE::~FTDIpp_MPSSE()
 		snprintf(err, sizeof(err), "unable to reset device : %d %s",
 			ret, ftdi_get_error_string(_ftdi));
 		printError(err);
-		free(_buffer);
+		free(_xfer_buffer);
 		return;
 	}
 
 	if (close_device() == EXIT_FAILURE)
 		printError("unable to close device");
-	free(_buffer);
+	free(_xfer_buffer);
 }
 
 void FTDIpp_MPSSE::open_device(const std::string &serial, unsigned int baudrate)
@@ -219,6 +233,8 @@ int FTDIpp_MPSSE::init(unsigned char latency, unsigned char bitmask_mode,
 		SET_BITS_HIGH, 0, 0
 	};
 
+	_bitmask = bitmask_mode;
+
 	if ((ret = ftdi_usb_reset(_ftdi)) < 0) {
 		printError("FTDI reset error with code " +
 				std::to_string(ret) + " (" +
@@ -289,12 +305,12 @@ int FTDIpp_MPSSE::init(unsigned char latency, unsigned char bitmask_mode,
 		}
 	}
 
-	if (ftdi_read_data_set_chunksize(_ftdi, _buffer_size) < 0) {
+	if (ftdi_read_data_set_chunksize(_ftdi, _read_size) < 0) {
 		printError("fail to set read chunk size: " +
 				string(ftdi_get_error_string(_ftdi)));
 		return -1;
 	}
-	if (ftdi_write_data_set_chunksize(_ftdi, _buffer_size) < 0) {
+	if (ftdi_write_data_set_chunksize(_ftdi, _xfer_buffer_size) < 0) {
 		printError("fail to set write chunk size: " +
 				string(ftdi_get_error_string(_ftdi)));
 		return -1;
@@ -391,6 +407,9 @@ int FTDIpp_MPSSE::setClkFreq(uint32_t clkHZ)
 		fprintf(stderr, "Error: write for frequency return %d\n", ret);
 		return ret;
 	}
+	/* buffers are purged below: nothing must be in flight */
+	if ((ret = mpsse_read_wait()) < 0 || (ret = mpsse_sync()) < 0)
+		return ret;
 	if ((ret = ftdi_read_data(_ftdi, buffer, 4)) < 0) {
 		printError("selfClkFreq: fail to read: " +
 				string(ftdi_get_error_string(_ftdi)));
@@ -409,18 +428,78 @@ int FTDIpp_MPSSE::setClkFreq(uint32_t clkHZ)
 #endif
 
 	_clkHZ = real_freq;
+	update_buffer_size();
 
 	return real_freq;
 }
 
+int FTDIpp_MPSSE::mpsse_set_buffer_size(int size)
+{
+	int read_size;
+
+	switch (_ftdi->type) {
+	case TYPE_2232H:
+		read_size = 4096;
+		break;
+	case TYPE_4232H:
+		read_size = 2048;
+		break;
+	case TYPE_232H:
+		read_size = 1024;
+		break;
+	default:  /* FIFO too small to benefit from large buffers */
+		return _buffer_size;
+	}
+
+	if (size > MPSSE_BUFFER_MAX)
+		size = MPSSE_BUFFER_MAX;
+	if (size <= _xfer_buffer_size)
+		return _buffer_size;
+
+	/* buffers are reallocated: nothing must be pending or in flight */
+	if (mpsse_write() < 0 || mpsse_read_wait() < 0 || mpsse_sync() < 0)
+		return _buffer_size;
+
+	unsigned char *buf = (unsigned char *)malloc(sizeof(unsigned char) *
+			size * MPSSE_NB_XFER);
+	if (!buf) {
+		printWarn("mpsse_set_buffer_size: malloc failed");
+		return _buffer_size;
+	}
+	free(_xfer_buffer);
+	_xfer_buffer = buf;
+	_xfer_buffer_size = size;
+	_read_size = read_size;
+	_wr_idx = 0;
+	_buffer = _xfer_buffer;
+	_nb_xfer++;
+	update_buffer_size();
+
+	return _buffer_size;
+}
+
+void FTDIpp_MPSSE::update_buffer_size()
+{
+	/* a transfer must be shifted out well before libusb timeout:
+	 * limit it to ~250ms of TCK at the current frequency
+	 */
+	int size = _clkHZ / 32;
+	if (size < static_cast<int>(_ftdi->max_packet_size))
+		size = _ftdi->max_packet_size;
+	if (size > _xfer_buffer_size)
+		size = _xfer_buffer_size;
+	/* setClkFreq and mpsse_set_buffer_size leave an empty buffer */
+	_buffer_size = size;
+}
+
 int FTDIpp_MPSSE::mpsse_store(unsigned char c)
 {
 	return mpsse_store(&c, 1);
 }
 
-int FTDIpp_MPSSE::mpsse_store(unsigned char *buff, int len)
+int FTDIpp_MPSSE::mpsse_store(const unsigned char *buff, int len)
 {
-	unsigned char *ptr = buff;
+	const unsigned char *ptr = buff;
 	int store_size, ret;
 	/* check if _buffer as space to store all */
 	if (_num + len > _buffer_size) {
@@ -461,6 +540,39 @@ int FTDIpp_MPSSE::mpsse_store(unsigned char *buff, int len)
 	return 0;
 }
 
+/* libftdi waits transfers with a zero timeout (busy loop):
+ * block in libusb event handling until completion first
+ */
+static int transfer_done(struct ftdi_transfer_control *tc)
+{
+	struct timeval tv = {1, 0};
+	while (!tc->completed) {
+		int ret = libusb_handle_events_timeout_completed(tc->ftdi->usb_ctx,
+				&tv, &tc->completed);
+		if (ret < 0 && ret != LIBUSB_ERROR_INTERRUPTED)
+			break;
+	}
+	return ftdi_transfer_data_done(tc);
+}
+
+int FTDIpp_MPSSE::wait_write(int idx)
+{
+	struct ftdi_transfer_control *tc = _wr_tc[idx];
+	if (!tc)
+		return 0;
+	_wr_tc[idx] = NULL;
+
+	int size = tc->size;
+	int ret = transfer_done(tc);
+	if (ret != size) {
+		printError("mpsse_write: fail to write with error " +
+				std::to_string(ret) + " (" +
+				string(ftdi_get_error_string(_ftdi)) + ")");
+		return (ret < 0) ? ret : -1;
+	}
+	return ret;
+}
+
 int FTDIpp_MPSSE::mpsse_write()
 {
 	int ret;
@@ -471,14 +583,37 @@ int FTDIpp_MPSSE::mpsse_write()
 	display("%s %d\n", __func__, _num);
 #endif
 
-	if ((ret = ftdi_write_data(_ftdi, _buffer, _num)) != _num) {
-		printError("mpsse_write: fail to write with error " +
-				std::to_string(ret) + " (" +
+	uint64_t start = UsbStats::now();
+	_wr_tc[_wr_idx] = ftdi_write_data_submit(_ftdi, _buffer, _num);
+	if (!_wr_tc[_wr_idx]) {
+		printError("mpsse_write: fail to submit transfer (" +
 				string(ftdi_get_error_string(_ftdi)) + ")");
-		return ret;
+		return -1;
 	}
+	int len = _num;
 
+	/* switch to next buffer: wait if its transfer is still in flight */
+	_wr_idx = (_wr_idx + 1) % MPSSE_NB_XFER;
+	_buffer = _xfer_buffer + _wr_idx * _xfer_buffer_size;
 	_num = 0;
+	_nb_xfer++;
+	ret = wait_write(_wr_idx);
+	UsbStats::write(len, start);
+
+	return (ret < 0) ? ret : len;
+}
+
+int FTDIpp_MPSSE::mpsse_sync()
+{
+	int ret = 0;
+	uint64_t start = UsbStats::now();
+	/* oldest transfer first */
+	for (int i = 1; i <= MPSSE_NB_XFER; i++) {
+		int r = wait_write((_wr_idx + i) % MPSSE_NB_XFER);
+		if (r < 0)
+			ret = r;
+	}
+	UsbStats::wait(start);
 	return ret;
 }
 
@@ -503,6 +638,11 @@ int FTDIpp_MPSSE::mpsse_read(unsigned char *rx_buff, int len)
 		return ret;
 	}
 
+	/* answers are received in order: complete background read first */
+	if ((ret = mpsse_read_wait()) < 0)
+		return ret;
+
+	uint64_t start = UsbStats::now();
 	do {
 		n = ftdi_read_data(_ftdi, p, len);
 		if (n < 0) {
@@ -521,9 +661,53 @@ int FTDIpp_MPSSE::mpsse_read(unsigned char *rx_buff, int len)
 		p += n;
 		num_read += n;
 	} while (len > 0);
+	UsbStats::read(num_read, start);
 	return num_read;
 }
 
+int FTDIpp_MPSSE::mpsse_read_submit(unsigned char *rx_buff, int len)
+{
+	int ret;
+
+	if ((ret = mpsse_store(SEND_IMMEDIATE)) < 0)
+		return ret;
+	if ((ret = mpsse_write()) < 0)
+		return ret;
+
+	/* libftdi uses a single receive buffer: one read at a time */
+	if ((ret = mpsse_read_wait()) < 0)
+		return ret;
+
+	_rd_tc = ftdi_read_data_submit(_ftdi, rx_buff, len);
+	if (!_rd_tc) {
+		printError("mpsse_read: fail to submit transfer (" +
+				string(ftdi_get_error_string(_ftdi)) + ")");
+		return -1;
+	}
+	_rd_len = len;
+	return 0;
+}
+
+int FTDIpp_MPSSE::mpsse_read_wait()
+{
+	if (!_rd_tc)
+		return 0;
+
+	struct ftdi_transfer_control *tc = _rd_tc;
+	_rd_tc = NULL;
+
+	uint64_t start = UsbStats::now();
+	int ret = transfer_done(tc);
+	UsbStats::read((ret > 0) ? ret : 0, start);
+	if (ret != _rd_len) {
+		printError("mpsse_read: fail to read with error " +
+				std::to_string(ret) + " (" +
+				string(ftdi_get_error_string(_ftdi)) + ")");
+		return (ret < 0) ? ret : -1;
+	}
+	return ret;
+}
+
 /**
  * Read GPIO (xCBUSy + xDBUSy) bank
  * @return pins state
@@ -564,17 +748,9 @@ uint8_t FTDIpp_MPSSE::gpio_get(bool low_pins)
  */
 bool FTDIpp_MPSSE::gpio_set(uint16_t gpios)
 {
-	if (gpios & 0x00ff) {
-		_cable.bit_low_val |= (0xff & gpios);
-		if (!__gpio_write(true))
-			return false;
-	}
-	if (gpios & 0xff00) {
-		_cable.bit_high_val |= (0xff & (gpios >> 8));
-		if (!__gpio_write(false))
-			return false;
-	}
-	return (mpsse_write() >= 0);
+	if (!gpio_store(gpios, true))
+		return false;
+	return (mpsse_write() >= 0 && mpsse_sync() >= 0);
 }
 
 /**
@@ -591,7 +767,7 @@ bool FTDIpp_MPSSE::gpio_set(uint8_t gpios, bool low_pins)
 		_cable.bit_high_val |= gpios;
 	if (!__gpio_write(low_pins))
 		return false;
-	return (mpsse_write() >= 0);
+	return (mpsse_write() >= 0 && mpsse_sync() >= 0);
 }
 
 /**
@@ -601,17 +777,9 @@ bool FTDIpp_MPSSE::gpio_set(uint8_t gpios, bool low_pins)
  */
 bool FTDIpp_MPSSE::gpio_clear(uint16_t gpios)
 {
-	if (gpios & 0x00ff) {
-		_cable.bit_low_val &= ~(0xff & gpios);
-		if (!__gpio_write(true))
-			return false;
-	}
-	if (gpios & 0xff00) {
-		_cable.bit_high_val &= ~(0xff & (gpios >> 8));
-		if (!__gpio_write(false))
-			return false;
-	}
-	return (mpsse_write() >= 0);
+	if (!gpio_store(gpios, false))
+		return false;
+	return (mpsse_write() >= 0 && mpsse_sync() >= 0);
 }
 
 /**
@@ -629,7 +797,7 @@ bool FTDIpp_MPSSE::gpio_clear(uint8_t gpios, bool low_pins)
 
 	if (!__gpio_write(low_pins))
 		return false;
-	return (mpsse_write() >= 0);
+	return (mpsse_write() >= 0 && mpsse_sync() >= 0);
 }
 
 /**
@@ -645,7 +813,7 @@ bool FTDIpp_MPSSE::gpio_write(uint16_t gpio)
 		return false;
 	if (!__gpio_write(false))
 		return false;
-	return (mpsse_write() >= 0);
+	return (mpsse_write() >= 0 && mpsse_sync() >= 0);
 }
 
 /**
@@ -663,7 +831,7 @@ bool FTDIpp_MPSSE::gpio_write(uint8_t gpio, bool low_pins)
 
 	if (__gpio_write(low_pins))
 		return false;
-	return (mpsse_write() >= 0);
+	return (mpsse_write() >= 0 && mpsse_sync() >= 0);
 }
 
 /**
@@ -743,6 +911,35 @@ void FTDIpp_MPSSE::gpio_set_output(uint16_t gpio)
  * private method to write ftdi half bank GPIOs (pins state are in _cable)
  * @param[in] low or high half bank
  */
+/**
+ * Set or clear one or more pins of the full bank (CBUS + DBUS) without
+ * sending: update is sent with next transfer, in order with others
+ * commands.
+ * @param[in] gpios: pins bitmask
+ * @param[in] state: true to set, false to clear
+ * @return false when error, true otherwise
+ */
+bool FTDIpp_MPSSE::gpio_store(uint16_t gpios, bool state)
+{
+	if (gpios & 0x00ff) {
+		if (state)
+			_cable.bit_low_val |= (0xff & gpios);
+		else
+			_cable.bit_low_val &= ~(0xff & gpios);
+		if (!__gpio_write(true))
+			return false;
+	}
+	if (gpios & 0xff00) {
+		if (state)
+			_cable.bit_high_val |= (0xff & (gpios >> 8));
+		else
+			_cable.bit_high_val &= ~(0xff & (gpios >> 8));
+		if (!__gpio_write(false))
+			return false;
+	}
+	return true;
+}
+
 bool FTDIpp_MPSSE::__gpio_write(bool low_pins)
 {
 	uint8_t tx[3];
@@ -752,6 +949,107 @@ bool FTDIpp_MPSSE::__gpio_write(bool low_pins)
 	return (mpsse_store(tx, 3) >= 0);
 }
 
+/* GPIOL1: only pin usable with WAIT_ON_HIGH/WAIT_ON_LOW */
+#define MPSSE_WAIT_PIN (1 << 5)
+/* polling period when the converter can't wait */
+#define GPIO_POLL_US 1000
+
+/**
+ * Wait until pins reach a state (CDONE, ...).
+ * @param[in] gpio: pins bitmask (CBUS + DBUS)
+ * @param[in] state: true to wait pins set, false for pins cleared
+ * @param[in] timeout_us: max delay (us)
+ * @return false when timeout or error, true otherwise
+ */
+bool FTDIpp_MPSSE::gpio_wait(uint16_t gpio, bool state, uint32_t timeout_us)
+{
+	uint16_t cond = (state) ? gpio : 0;
+	auto deadline = std::chrono::steady_clock::now() +
+		std::chrono::microseconds(timeout_us);
+
+	bool can_wait = (_ftdi->type == TYPE_2232H ||
+		_ftdi->type == TYPE_4232H || _ftdi->type == TYPE_232H);
+	if (!can_wait || gpio != MPSSE_WAIT_PIN) {
+		bool low_only = (gpio & 0xff00) == 0;
+		do {
+			uint16_t pins = (low_only) ? gpio_get(true) : gpio_get();
+			if ((pins & gpio) == cond)
+				return true;
+			usleep(GPIO_POLL_US);
+		} while (std::chrono::steady_clock::now() < deadline);
+		return false;
+	}
+
+	/* MPSSE engine waits the pin then answers with its state: one
+	 * read, completed by the answer or cancelled at deadline
+	 */
+	uint8_t tx[3] = {static_cast<uint8_t>((state) ? WAIT_ON_HIGH : WAIT_ON_LOW),
+		GET_BITS_LOW, SEND_IMMEDIATE};
+	uint8_t rx;
+	int ret = 0;
+	if (mpsse_store(tx, 3) < 0 || mpsse_write() < 0 ||
+			mpsse_read_wait() < 0 || mpsse_sync() < 0)
+		return false;
+
+	uint64_t start = UsbStats::now();
+	struct ftdi_transfer_control *tc = ftdi_read_data_submit(_ftdi, &rx, 1);
+	if (!tc) {
+		printError("gpio_wait: fail to submit transfer (" +
+				string(ftdi_get_error_string(_ftdi)) + ")");
+		mpsse_recover();
+		return false;
+	}
+	while (!tc->completed) {
+		auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+			deadline - std::chrono::steady_clock::now()).count();
+		if (left <= 0)
+			break;
+		struct timeval tv = {static_cast<time_t>(left / 1000000),
+			static_cast<suseconds_t>(left % 1000000)};
+		int r = libusb_handle_events_timeout_completed(_ftdi->usb_ctx,
+				&tv, &tc->completed);
+		if (r < 0 && r != LIBUSB_ERROR_INTERRUPTED)
+			break;
+	}
+	if (tc->completed) {
+		ret = ftdi_transfer_data_done(tc);
+		if (ret != 1)
+			printError("gpio_wait: fail to read: " +
+					string(ftdi_get_error_string(_ftdi)));
+	} else {
+		struct timeval tv = {1, 0};
+		ftdi_transfer_data_cancel(tc, &tv);
+	}
+	UsbStats::read((ret > 0) ? ret : 0, start);
+
+	if (ret == 1)
+		return (rx & gpio) == cond;
+	/* engine still waits the pin */
+	mpsse_recover();
+	return false;
+}
+
+void FTDIpp_MPSSE::mpsse_recover()
+{
+	if (ftdi_set_bitmode(_ftdi, 0, BITMODE_RESET) < 0 ||
+			ftdi_set_bitmode(_ftdi, _bitmask, BITMODE_MPSSE) < 0) {
+		printError("mpsse_recover: fail to reset MPSSE engine: " +
+				string(ftdi_get_error_string(_ftdi)));
+		return;
+	}
+#if (FTDI_VERSION < 105)
+	ftdi_usb_purge_buffers(_ftdi);
+#else
+	ftdi_tcioflush(_ftdi);
+#endif
+	FTDIpp_MPSSE::setClkFreq(_clkHZ);
+	__gpio_write(true);
+	if (_ftdi->type != TYPE_4232H)
+		__gpio_write(false);
+	if (mpsse_write() < 0 || mpsse_sync() < 0)
+		printError("mpsse_recover: fail to restore pins");
+}
+
 #ifdef USE_UDEV
 unsigned int FTDIpp_MPSSE::udevstufftoint(const char *udevstring, int base)
 {
@@ -8,6 +8,11 @@
 #include <ftdi.h>
 #include <string>
 
+/* number of buffers: bulk-OUT transfers in flight */
+#define MPSSE_NB_XFER 4
+/* largest buffer: MPSSE commands length field is 16 bits */
+#define MPSSE_BUFFER_MAX 65536
+
 class FTDIpp_MPSSE {
 	public:
 		typedef struct {
@@ -36,7 +41,7 @@ class FTDIpp_MPSSE {
 		/* read gpio */
 		uint16_t gpio_get();
 		uint8_t gpio_get(bool low_pins);
-		/* update selected gpio */
+		/* update selected gpio (returns once sent to the converter) */
 		bool gpio_set(uint16_t gpio);
 		bool gpio_set(uint8_t gpio, bool low_pins);
 		bool gpio_clear(uint16_t gpio);
@@ -44,6 +49,10 @@ class FTDIpp_MPSSE {
 		/* full access */
 		bool gpio_write(uint16_t gpio);
 		bool gpio_write(uint8_t gpio, bool low_pins);
+		/* wait until gpio are all set (state true) or all cleared,
+		 * timeout in us. GPIOL1 (ADBUS5) is waited by the MPSSE
+		 * engine itself, others are polled. Return false on timeout */
+		bool gpio_wait(uint16_t gpio, bool state, uint32_t timeout_us);
 		/* gpio direction */
 		void gpio_set_dir(uint8_t dir, bool low_pins);
 		void gpio_set_dir(uint16_t dir);
@@ -60,11 +69,28 @@ class FTDIpp_MPSSE {
 		void open_device(const std::string &serial, unsigned int baudrate);
 		void ftdi_usb_close_internal();
 		int close_device();
+		/* submit buffer content (asynchronous), wait only when all
+		 * buffers are in flight. Return bytes submitted */
 		int mpsse_write();
+		/* wait until all submitted buffers are sent */
+		int mpsse_sync();
 		int mpsse_read(unsigned char *rx_buff, int len);
+		/* send buffer with SEND_IMMEDIATE and start reading len bytes in
+		 * background (only one read in flight: a previous one is
+		 * completed first). mpsse_read_wait returns bytes read */
+		int mpsse_read_submit(unsigned char *rx_buff, int len);
+		int mpsse_read_wait();
 		int mpsse_store(unsigned char c);
-		int mpsse_store(unsigned char *c, int len);
+		int mpsse_store(const unsigned char *c, int len);
+		/* update pins state in buffer only (sent with next transfer) */
+		bool gpio_store(uint16_t gpio, bool state);
 		int mpsse_get_buffer_size() {return _buffer_size;}
+		/* use buffers up to size bytes (FT2232H, FT4232H and FT232H only,
+		 * others keep USB packet size). Return buffer size in use */
+		int mpsse_set_buffer_size(int size);
+		/* max answers bytes not yet requested by a read: converter
+		 * stops when its output FIFO is full */
+		int mpsse_get_read_size() {return _read_size;}
 		unsigned int udevstufftoint(const char *udevstring, int base);
 		bool search_with_dev(const std::string &device);
 		int8_t _verbose;
@@ -78,12 +104,26 @@ class FTDIpp_MPSSE {
 		unsigned char _interface;
 		/* gpio */
 		bool __gpio_write(bool low_pins);
+		/* leave a wait on I/O: reset MPSSE engine, restore clock and pins */
+		void mpsse_recover();
+		unsigned char _bitmask;  /* init() bitmask, used to restore MPSSE mode */
+		/* asynchronous transfers */
+		int wait_write(int idx);
+		void update_buffer_size();
+		unsigned char *_xfer_buffer; /* MPSSE_NB_XFER * _xfer_buffer_size */
+		int _xfer_buffer_size;
+		int _read_size;
+		struct ftdi_transfer_control *_wr_tc[MPSSE_NB_XFER];
+		int _wr_idx;  /* buffer used by mpsse_store */
+		struct ftdi_transfer_control *_rd_tc;
+		int _rd_len;
 	protected:
 		uint32_t _clkHZ;
 		struct ftdi_context *_ftdi;
-		int _buffer_size;
+		int _buffer_size;  /* bytes sent per transfer (<= _xfer_buffer_size) */
 		int _num;
 		unsigned char *_buffer;
+		uint32_t _nb_xfer;  /* buffers submitted: incremented when _buffer changes */
 		uint8_t _iproduct[200];
 };
 
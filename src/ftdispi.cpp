@@ -8,6 +8,10 @@
 #include <ftdi.h>
 #include <unistd.h>
 #include <string.h>
+
+#include <chrono>
+#include <vector>
+
 #include "board.hpp"
 #include "ftdipp_mpsse.hpp"
 #include "ftdispi.hpp"
@@ -77,6 +81,7 @@ FtdiSpi::FtdiSpi(int vid, int pid, unsigned char interface, uint32_t clkHZ,
 	setCSmode(SPI_CS_AUTO);
 	setEndianness(SPI_MSB_FIRST);
 
+	mpsse_set_buffer_size(MPSSE_BUFFER_MAX);
 	init(1, 0x00, BITMODE_MPSSE);
 }
 
@@ -105,6 +110,7 @@ FtdiSpi::FtdiSpi(const FTDIpp_MPSSE::mpsse_bit_config &conf,
 	setCSmode(SPI_CS_AUTO);
 	setEndianness(SPI_MSB_FIRST);
 
+	mpsse_set_buffer_size(MPSSE_BUFFER_MAX);
 	init(1, 0x00, BITMODE_MPSSE);
 }
 
@@ -140,114 +146,129 @@ bool FtdiSpi::clearCs()
 	return confCs(_cs);
 }
 
+/* store two consecutive cs configuration (sent with transfer) */
+bool FtdiSpi::storeCs(bool level)
+{
+	_cs = (level) ? _cs_bits : 0x00;
+	return gpio_store(_cs_bits, level) && gpio_store(_cs_bits, level);
+}
+
 int FtdiSpi::ft2232_spi_wr_then_rd(
 						const uint8_t *tx_data, uint32_t tx_len,
 						uint8_t *rx_data, uint32_t rx_len)
 {
-	setCSmode(SPI_CS_MANUAL);
-	clearCs();
-	uint32_t ret = ft2232_spi_wr_and_rd(tx_len, tx_data, NULL);
-	if (ret != 0) {
-		printf("%s : write error %d %d\n", __func__, ret, tx_len);
-	} else {
-		ret = ft2232_spi_wr_and_rd(rx_len, NULL, rx_data);
-		if (ret != 0) {
-			printf("%s : read error\n", __func__);
-		}
-	}
-	setCs();
-	setCSmode(SPI_CS_AUTO);
+	const spi_seg_t seg[2] = {
+		{tx_data, NULL, tx_len},
+		{NULL, rx_data, rx_len}};
+
+	storeCs(false);
+	int ret = xfer(seg, 2);
+	if (ret != 0)
+		printf("%s : transfer error %d\n", __func__, ret);
+	storeCs(true);
+	if (mpsse_write() < 0)
+		ret = -1;
 	return ret;
 }
 
 /* Returns 0 upon success, a negative number upon errors. */
-int FtdiSpi::ft2232_spi_wr_and_rd(//struct ftdi_spi *spi,
-			    uint32_t writecnt,
-			    const uint8_t * writearr, uint8_t * readarr)
+int FtdiSpi::ft2232_spi_wr_and_rd(uint32_t writecnt,
+			    const uint8_t *writearr, uint8_t *readarr)
 {
-	uint32_t max_xfer = (readarr) ? _buffer_size : 4096;
-	uint8_t buf[max_xfer];
-	int i = 0;
-	int ret = 0;
-
-	uint8_t *rx_ptr = readarr;
-	uint8_t *tx_ptr = (uint8_t *)writearr;
-	uint32_t len = writecnt;
-	uint32_t xfer;
+	const spi_seg_t seg = {writearr, readarr, writecnt};
+
+	if (_cs_mode == SPI_CS_AUTO)
+		storeCs(false);
+	int ret = xfer(&seg, 1);
+	if (_cs_mode == SPI_CS_AUTO)
+		storeCs(true);
+	/* write only transfers are not waited */
+	if (mpsse_write() < 0)
+		ret = -1;
+	return ret;
+}
 
-	if (_cs_mode == SPI_CS_AUTO) {
-		clearCs();
-	}
-	mpsse_write();
+/* max bytes per MPSSE shift command (16 bits length) */
+#define MPSSE_SHIFT_MAX 65536
 
-	/*
-	 * Minimize USB transfers by packing as many commands as possible
-	 * together. If we're not expecting to read, we can assert CS#, write,
-	 * and deassert CS# all in one shot. If reading, we do three separate
-	 * operations.
-	 */
-	while (len > 0) {
-		xfer = (len > max_xfer) ? max_xfer : len;
-
-		buf[i++] = ((readarr) ? (MPSSE_DO_READ | _rd_mode) : 0) |
-					((writearr) ? (MPSSE_DO_WRITE | _wr_mode) : 0);
-		buf[i++] = (xfer - 1) & 0xff;
-		buf[i++] = ((xfer - 1) >> 8) & 0xff;
-		if (writearr) {
-			memcpy(buf + i, tx_ptr, xfer);
-			tx_ptr += xfer;
-			i += xfer;
-		}
+/*
+ * Segments are encoded straight into MPSSE command buffer (payload is
+ * copied only once, from caller buffer) and received bytes are read into
+ * caller buffers. Each read command is limited to converter FIFO size, the
+ * next one being clocked while the previous one is received. CS is not
+ * handled.
+ */
+int FtdiSpi::xfer(const spi_seg_t *seg, int nb_seg)
+{
+	const uint32_t rd_max = mpsse_get_read_size();
+	uint32_t rx_pending = 0;  // bytes expected by the read in flight
+	int ret = 0;
 
-		ret = mpsse_store(buf, i);
-		if (ret)
-			printf("send_buf failed before read: %i %s\n", ret, ftdi_get_error_string(_ftdi));
-		i = 0;
-		if (readarr) {
-			//if (ret == 0) {
-			ret = mpsse_read(rx_ptr, xfer);
-			if ((uint32_t)ret != xfer)
-				printf("get_buf failed: %i\n", ret);
-			//}
-			rx_ptr += xfer;
-		} else {
-			ret = mpsse_write();
-			if ((uint32_t)ret != xfer+3)
-				printf("error %d %d\n", ret, i);
+	for (int s = 0; s < nb_seg && ret >= 0; s++) {
+		const uint8_t *tx_ptr = seg[s].tx;
+		uint8_t *rx_ptr = seg[s].rx;
+		uint32_t len = seg[s].len;
+		uint32_t max_xfer = (rx_ptr) ? rd_max : MPSSE_SHIFT_MAX;
+		/* without data to send nor to receive: clock 0x00 bytes */
+		uint8_t cmd = ((rx_ptr) ? (MPSSE_DO_READ | _rd_mode) : 0) |
+			((tx_ptr || !rx_ptr) ? (MPSSE_DO_WRITE | _wr_mode) : 0);
+
+		while (len > 0 && ret >= 0) {
+			uint32_t chunk = (len > max_xfer) ? max_xfer : len;
+			uint8_t hdr[3] = {cmd, static_cast<uint8_t>((chunk - 1) & 0xff),
+				static_cast<uint8_t>(((chunk - 1) >> 8) & 0xff)};
+
+			ret = mpsse_store(hdr, 3);
+			if (ret >= 0 && tx_ptr) {
+				ret = mpsse_store(tx_ptr, chunk);
+				tx_ptr += chunk;
+			} else if (ret >= 0 && !rx_ptr) {
+				for (uint32_t i = 0; i < chunk && ret >= 0; i++)
+					ret = mpsse_store(0x00);
+			}
+			if (ret < 0) {
+				printf("send_buf failed: %i %s\n", ret,
+					ftdi_get_error_string(_ftdi));
+				break;
+			}
+
+			if (rx_ptr) {
+				/* this chunk is clocked while the previous one is received */
+				mpsse_write();
+				if (rx_pending) {
+					ret = mpsse_read_wait();
+					if ((uint32_t)ret != rx_pending) {
+						printf("get_buf failed: %i\n", ret);
+						ret = -1;
+					}
+				}
+				rx_pending = 0;
+				if (ret >= 0 && (ret = mpsse_read_submit(rx_ptr, chunk)) < 0)
+					printf("get_buf failed: %i\n", ret);
+				else
+					rx_pending = chunk;
+				rx_ptr += chunk;
+			}
+			len -= chunk;
 		}
-		len -= xfer;
-
 	}
 
-	if (_cs_mode == SPI_CS_AUTO) {
-		if (!setCs())
-			printf("send_buf failed at write %d\n", ret);
+	if (rx_pending) {
+		int rd = mpsse_read_wait();
+		if ((uint32_t)rd != rx_pending) {
+			printf("get_buf failed: %i\n", rd);
+			ret = -1;
+		}
 	}
 
-	return 0;
+	return (ret < 0) ? ret : 0;
 }
 
 /* method spiInterface::spi_put */
 int FtdiSpi::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
-	uint32_t xfer_len = len + 1;
-	uint8_t jtx[xfer_len];
-	uint8_t jrx[xfer_len];
-
-	jtx[0] = cmd;
-	if (tx != NULL)
-		memcpy(jtx+1, tx, len);
-
-	/* send first alreay stored cmd,
-	 * in the same time store each byte
-	 * to next
-	 */
-	ft2232_spi_wr_and_rd(xfer_len, jtx, (rx != NULL)?jrx:NULL);
-
-	if (rx != NULL)
-		memcpy(rx, jrx+1, len);
-
-	return 0;
+	const spi_seg_t seg = {tx, rx, len};
+	return spi_xfer(cmd, &seg, (len > 0) ? 1 : 0);
 }
 
 /* method spiInterface::spi_put */
@@ -256,34 +277,91 @@ int FtdiSpi::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 	return ft2232_spi_wr_and_rd(len, tx, rx);
 }
 
+/* method spiInterface::spi_xfer */
+int FtdiSpi::spi_xfer(uint8_t cmd, const spi_seg_t *seg, int nb_seg)
+{
+	const spi_seg_t cmd_seg = {&cmd, NULL, 1};
+
+	if (_cs_mode == SPI_CS_AUTO)
+		storeCs(false);
+	int ret = xfer(&cmd_seg, 1);
+	if (ret == 0)
+		ret = xfer(seg, nb_seg);
+	if (_cs_mode == SPI_CS_AUTO)
+		storeCs(true);
+	if (mpsse_write() < 0)
+		ret = -1;
+	return ret;
+}
+
 /* method spiInterface::spi_wait
+ * status register is read continuously (CS kept low): bytes are requested
+ * by batches growing up to converter FIFO size, next batch is clocked
+ * while previous one is received
  */
 int FtdiSpi::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 			uint32_t timeout, bool verbose)
 {
-	uint8_t rx;
+	uint32_t max_batch = mpsse_get_read_size();
+	std::vector<uint8_t> rx[2] = {std::vector<uint8_t>(max_batch),
+		std::vector<uint8_t>(max_batch)};
+	uint8_t rd_cmd[3] = {static_cast<uint8_t>(MPSSE_DO_READ | _rd_mode), 0, 0};
+	uint32_t batch = 1, next;
 	uint32_t count = 0;
+	uint8_t status = 0;
+	int cur = 0;
+	bool match = false, fail = false;
+	auto deadline = std::chrono::steady_clock::now() +
+		std::chrono::microseconds(static_cast<uint64_t>(timeout) *
+		SPI_WAIT_TRY_US);
 
 	setCSmode(SPI_CS_MANUAL);
 	clearCs();
 	ft2232_spi_wr_and_rd(1, &cmd, NULL);
-	do {
-		ft2232_spi_wr_and_rd(1, NULL, &rx);
-		count ++;
-		if (count == timeout) {
-			printf("timeout: %2x %d\n", rx, count);
-			break;
+
+	/* rd_cmd[1:2] is length - 1: first batch is one byte */
+	mpsse_store(rd_cmd, 3);
+	if (mpsse_read_submit(rx[cur].data(), batch) < 0)
+		fail = true;
+
+	while (!fail) {
+		next = (batch * 2 > max_batch) ? max_batch : batch * 2;
+		rd_cmd[1] = (next - 1) & 0xff;
+		rd_cmd[2] = ((next - 1) >> 8) & 0xff;
+		mpsse_store(rd_cmd, 3);
+		mpsse_write();
+
+		if (mpsse_read_wait() != static_cast<int>(batch)) {
+			fail = true;
+		} else {
+			for (uint32_t i = 0; i < batch && !match; i++, count++) {
+				status = rx[cur][i];
+				match = (status & mask) == cond;
+			}
+			if (verbose)
+				printf("%02x %02x %02x %02x\n", status, mask, cond, count);
+			if (!match && count >= timeout &&
+					std::chrono::steady_clock::now() >= deadline) {
+				printf("timeout: %2x %d\n", status, count);
+				fail = true;
+			}
 		}
 
-		if (verbose) {
-			printf("%02x %02x %02x %02x\n", rx, mask, cond, count);
+		cur ^= 1;
+		if (match || fail) {
+			/* next batch is already queued: drain its answer */
+			mpsse_read(rx[cur].data(), next);
+			break;
 		}
-	} while((rx & mask) != cond);
+		if (mpsse_read_submit(rx[cur].data(), next) < 0)
+			fail = true;
+		batch = next;
+	}
 	setCs();
 	setCSmode(SPI_CS_AUTO);
 
-	if (count == timeout) {
-		printf("%x\n", rx);
+	if (!match) {
+		printf("%x\n", status);
 		std::cout << "wait: Error" << std::endl;
 		return -ETIME;
 	} else
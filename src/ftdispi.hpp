@@ -53,6 +53,7 @@ class FtdiSpi : public FTDIpp_MPSSE, SPIInterface {
 	int spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx,
 			uint32_t len) override;
 	int spi_put(uint8_t *tx, uint8_t *rx, uint32_t len) override;
+	int spi_xfer(uint8_t cmd, const spi_seg_t *seg, int nb_seg) override;
 	int spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 			uint32_t timeout, bool verbose=false) override;
 
@@ -67,6 +68,11 @@ class FtdiSpi : public FTDIpp_MPSSE, SPIInterface {
 	virtual bool post_flash_access() override {return true;}
 
  private:
+	/* store CS state in buffer, sent with next transfer */
+	bool storeCs(bool level);
+	/* encode segments in MPSSE buffer, read rx segments */
+	int xfer(const spi_seg_t *seg, int nb_seg);
+
 	uint8_t _cs;
 	uint16_t _cs_bits;
 	uint8_t _clk;
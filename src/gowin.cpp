@@ -12,6 +12,7 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #include "jtag.hpp"
 #include "gowin.hpp"
@@ -190,6 +191,7 @@ void Gowin::programFlash()
 	wr_rd(NOOP, NULL, 0, NULL, 0);
 
 	/* wait for reload */
+	_jtag->flush();
 	usleep(2*150*1000);
 
 	/* check if file checksum == checksum in FPGA */
@@ -235,16 +237,20 @@ void Gowin::program(unsigned int offset, bool unprotect_flash)
 
 			wr_rd(0x3D, NULL, 0, NULL, 0);
 
-			SPIFlash spiFlash(this, unprotect_flash,
-					(_verbose ? 1 : (_quiet ? -1 : 0)));
-			spiFlash.reset();
-			spiFlash.read_id();
-			spiFlash.display_status_reg(spiFlash.read_status_reg());
-			if (spiFlash.erase_and_prog(offset, data, length / 8) != 0)
-				throw std::runtime_error("Error: write to flash failed");
-			if (_verify)
-				if (!spiFlash.verify(offset, data, length / 8, 256))
-					throw std::runtime_error("Error: flash vefication failed");
+			{
+				SPIFlash spiFlash(this, unprotect_flash,
+						(_verbose ? 1 : (_quiet ? -1 : 0)));
+				/* 3-byte addressing restored before reconfiguration */
+				SPIFlashAddrGuard addr_guard(spiFlash);
+				spiFlash.reset();
+				spiFlash.read_id();
+				spiFlash.display_status_reg(spiFlash.read_status_reg());
+				if (spiFlash.erase_and_prog(offset, data, length / 8) != 0)
+					throw std::runtime_error("Error: write to flash failed");
+				if (_verify)
+					if (!spiFlash.verify(offset, data, length / 8, 256))
+						throw std::runtime_error("Error: flash vefication failed");
+			}
 			if (!DisableCfg())
 				throw std::runtime_error("Error: fail to disable configuration");
 
@@ -508,7 +514,6 @@ bool Gowin::flashFLASH(uint8_t *data, int length)
 /* TN653 p. 9 */
 bool Gowin::flashSRAM(uint8_t *data, int length)
 {
-	int tx_len, tx_end;
 	int byte_length = length / 8;
 
 	ProgressBar progress("Flash SRAM", byte_length, 50, _quiet);
@@ -516,21 +521,9 @@ bool Gowin::flashSRAM(uint8_t *data, int length)
 	/* 2.2.6.4 */
 	wr_rd(XFER_WRITE, NULL, 0, NULL, 0);
 
-	int xfer_len = 256;
-
-	for (int i=0; i < byte_length; i+=xfer_len) {
-		if (i + xfer_len > byte_length) {  // last packet with some size
-			tx_len = (byte_length - i) * 8;
-			tx_end = Jtag::EXIT1_DR;  // to move in EXIT1_DR
-		} else {
-			tx_len = xfer_len * 8;
-			/* 2.2.6.5 */
-			tx_end = Jtag::SHIFT_DR;
-		}
-		_jtag->shiftDR(data+i, NULL, tx_len, tx_end);
-		//_jtag->flush();
-		progress.display(i);
-	}
+	/* 2.2.6.5: stay in SHIFT_DR until the last bit, then EXIT1_DR */
+	_jtag->shiftDR_stream(data, byte_length, Jtag::EXIT1_DR,
+		[&progress](uint32_t done) { progress.display(done); });
 	/* 2.2.6.6 */
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
 
@@ -621,15 +614,15 @@ bool Gowin::eraseSRAM()
 
 int Gowin::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
-	uint8_t jrx[len+1], jtx[len+1];
+	std::vector<uint8_t> jrx(len + 1), jtx(len + 1);
 	jtx[0] = cmd;
 	if (tx)
-		memcpy(jtx+1, tx, len);
+		memcpy(jtx.data()+1, tx, len);
 	else
-		memset(jtx+1, 0, len);
-	int ret = spi_put(jtx, (rx)? jrx : NULL, len+1);
+		memset(jtx.data()+1, 0, len);
+	int ret = spi_put(jtx.data(), (rx)? jrx.data() : NULL, len+1);
 	if (rx)
-		memcpy(rx, jrx+1, len);
+		memcpy(rx, jrx.data()+1, len);
 	return ret;
 }
 
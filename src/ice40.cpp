@@ -18,6 +18,9 @@
 #include "rawParser.hpp"
 #include "spiFlash.hpp"
 
+/* CDONE rise after reset or configuration */
+#define CDONE_TIMEOUT_US 12000000
+
 Ice40::Ice40(FtdiSpi* spi, const std::string &filename,
 			const std::string &file_type,
 			Device::prog_type_t prg_type,
@@ -41,17 +44,11 @@ Ice40::~Ice40()
 
 void Ice40::reset()
 {
-	uint32_t timeout = 1000;
 	_spi->gpio_clear(_rst_pin);
 	usleep(1000);
 	_spi->gpio_set(_rst_pin);
 	printInfo("Reset ", false);
-	usleep(12000);
-	do {
-		timeout--;
-		usleep(12000);
-	} while (((_spi->gpio_get(true) & _done_pin) == 0) && timeout > 0);
-	if (timeout == 0)
+	if (!_spi->gpio_wait(_done_pin, true, CDONE_TIMEOUT_US))
 		printError("FAIL");
 	else
 		printSuccess("DONE");
@@ -62,7 +59,6 @@ void Ice40::reset()
  */
 bool Ice40::program_cram(uint8_t *data, uint32_t length)
 {
-	uint32_t timeout = 1000;
 
 	/* configure SPI */
 	_spi->setMode(3); // IDLE high, write on falling
@@ -93,14 +89,8 @@ bool Ice40::program_cram(uint8_t *data, uint32_t length)
 	_spi->spi_put(dummy, NULL, 12);
 
 	/* wait CDONE */
-	usleep(12000);
-
 	printInfo("Wait for CDONE ", false);
-	do {
-		timeout--;
-		usleep(12000);
-	} while (((_spi->gpio_get(true) & _done_pin) == 0) && timeout > 0);
-	if (timeout == 0)
+	if (!_spi->gpio_wait(_done_pin, true, CDONE_TIMEOUT_US))
 		printError("FAIL");
 	else
 		printSuccess("DONE");
@@ -112,7 +102,6 @@ bool Ice40::program_cram(uint8_t *data, uint32_t length)
 
 void Ice40::program(unsigned int offset, bool unprotect_flash)
 {
-	uint32_t timeout = 1000;
 
 	if (_file_extension.empty())
 		return;
@@ -137,25 +126,23 @@ void Ice40::program(unsigned int offset, bool unprotect_flash)
 
 	_spi->gpio_clear(_rst_pin);
 
-	SPIFlash flash(reinterpret_cast<SPIInterface *>(_spi), unprotect_flash,
-			_quiet);
+	{
+		SPIFlash flash(reinterpret_cast<SPIInterface *>(_spi), unprotect_flash,
+				_quiet);
+		/* 3-byte addressing restored before reset release */
+		SPIFlashAddrGuard addr_guard(flash);
 
-	printf("%02x\n", flash.read_status_reg());
-	flash.read_id();
-	flash.erase_and_prog(offset, data, length);
+		printf("%02x\n", flash.read_status_reg());
+		flash.read_id();
+		flash.erase_and_prog(offset, data, length);
 
-	if (_verify)
-		flash.verify(offset, data, length);
+		if (_verify)
+			flash.verify(offset, data, length);
+	}
 
 	_spi->gpio_set(_rst_pin);
-	usleep(12000);
-
 	printInfo("Wait for CDONE ", false);
-	do {
-		timeout--;
-		usleep(12000);
-	} while (((_spi->gpio_get(true) & _done_pin) == 0) && timeout > 0);
-	if (timeout == 0)
+	if (!_spi->gpio_wait(_done_pin, true, CDONE_TIMEOUT_US))
 		printError("FAIL");
 	else
 		printSuccess("DONE");
@@ -163,13 +150,13 @@ void Ice40::program(unsigned int offset, bool unprotect_flash)
 
 bool Ice40::dumpFlash(uint32_t base_addr, uint32_t len)
 {
-	uint32_t timeout = 1000;
 	_spi->gpio_clear(_rst_pin);
 
 	/* prepare SPI access */
 	printInfo("Read Flash ", false);
 	try {
 		SPIFlash flash(reinterpret_cast<SPIInterface *>(_spi), false, _verbose);
+		SPIFlashAddrGuard addr_guard(flash);
 		flash.reset();
 		flash.power_up();
 		flash.dump(_filename, base_addr, len);
@@ -182,14 +169,8 @@ bool Ice40::dumpFlash(uint32_t base_addr, uint32_t len)
 	/* release SPI access */
 
 	_spi->gpio_set(_rst_pin);
-	usleep(12000);
-
 	printInfo("Wait for CDONE ", false);
-	do {
-		timeout--;
-		usleep(12000);
-	} while (((_spi->gpio_get(true) & _done_pin) == 0) && timeout > 0);
-	if (timeout == 0)
+	if (!_spi->gpio_wait(_done_pin, true, CDONE_TIMEOUT_US))
 		printError("FAIL");
 	else
 		printSuccess("DONE");
@@ -10,6 +10,7 @@
 #include "configBitstreamParser.hpp"
 #include "display.hpp"
 #include "ihexParser.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -42,6 +43,7 @@ IhexParser::IhexParser(const string &filename, bool reverseOrder, bool verbose):
 
 int IhexParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	string str;
 	istringstream lineStream(_raw_data);
 
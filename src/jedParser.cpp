@@ -23,6 +23,7 @@
 
 #include "display.hpp"
 #include "jedParser.hpp"
+#include "usbStats.hpp"
 
 /* GGM: TODO
  * - use NOTE for Lxxx
@@ -228,6 +229,7 @@ void JedParser::parseLField(const vector<string> &content)
 
 int JedParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	string previousNote;
 
 	_ss.str(_raw_data);
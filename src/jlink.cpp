@@ -18,6 +18,7 @@
 #include <vector>
 
 #include "display.hpp"
+#include "usbStats.hpp"
 
 #define VID 0x1366
 #define PID 0x0105
@@ -42,7 +43,7 @@ using namespace std;
 Jlink::Jlink(uint32_t clkHz, int8_t verbose):_base_freq(0), _min_div(0),
 	jlink_write_ep(-1), jlink_read_ep(-1), jlink_interface(-1),
 	_verbose(verbose > 0), _debug(verbose > 1), _quiet(verbose < 0),
-	_num_bits(0), _last_tms(0), _last_tdi(0),
+	_num_bits(0), _last_tms(0), _last_tdi(0), _deferred_read(false),
 	_hw_type(0), _major(0), _minor(0), _revision(0)
 {
 	// init libusb context
@@ -124,6 +125,37 @@ int Jlink::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 {
 	if (len == 0)  // nothing to do
 		return 0;
+
+	if (_deferred_read) {
+		/* append to current buffer: tdo is extracted
+		 * by ll_write
+		 */
+		for (uint32_t pos = 0; pos < len;) {
+			if (_num_bits == BUF_SIZE * 8)
+				ll_write(NULL);
+			uint32_t xfer_len = BUF_SIZE * 8 - _num_bits;
+			if (xfer_len > len - pos)
+				xfer_len = len - pos;
+			if (rx)
+				_pending_reads.push_back({rx, pos, _num_bits, xfer_len});
+			for (uint32_t i = 0; i < xfer_len; i++, pos++, _num_bits++) {
+				uint8_t mask = 1 << (_num_bits & 0x07);
+				uint32_t idx = _num_bits >> 3;
+				if (_last_tms || (end && pos == len - 1))
+					_tms[idx] |= mask;
+				else
+					_tms[idx] &= ~mask;
+				if (tx && (tx[pos >> 3] & (1 << (pos & 0x07))))
+					_tdi[idx] |= mask;
+				else
+					_tdi[idx] &= ~mask;
+			}
+		}
+		if (end)
+			_last_tms = 1;
+		return len;
+	}
+
 	if (_num_bits != 0)  // flush buffer to simplify next step
 		flush();
 
@@ -137,7 +169,10 @@ int Jlink::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 			xfer_len = len - rest;  // reduce xfer len
 		uint16_t tt = (xfer_len + 7) >> 3;  // convert to Byte
 		memset(_tms, tms, tt);  // fill tms buffer
-		memcpy(_tdi, tx_ptr, tt);  // fill tdi buffer
+		if (tx)
+			memcpy(_tdi, tx_ptr, tt);  // fill tdi buffer
+		else
+			memset(_tdi, 0, tt);
 		_num_bits = xfer_len;  // set buffer size in bit
 		if (end && xfer_len + rest == len) {  // last sequence: set tms 1
 			_last_tms = 1;
@@ -146,7 +181,8 @@ int Jlink::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 		}
 		ll_write((rx) ? rx_ptr : NULL);  // write
 
-		tx_ptr += tt;
+		if (tx)
+			tx_ptr += tt;
 		if (rx)
 			rx_ptr += tt;
 	}
@@ -160,11 +196,17 @@ int Jlink::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
 	// nothing to do
 	if (clk_len == 0)
 		return 0;
-	if (_num_bits != 0)
-		flush();
 
 	_last_tms = tms;
 	_last_tdi = tdi;
+
+	/* short sequence: append to current buffer */
+	if (_num_bits != 0 && clk_len <= BUF_SIZE * 8 - _num_bits) {
+		uint8_t tms_buf = (tms) ? 0xff : 0x00;
+		for (uint32_t i = 0; i < clk_len; i++)
+			writeTMS(&tms_buf, 1, false);
+		return clk_len;
+	}
 	uint8_t curr_tms = (tms) ? 0xff: 0x00;
 	uint8_t curr_tdi = (tdi) ? 0xff: 0x00;
 
@@ -192,6 +234,14 @@ int Jlink::flush()
 	return ll_write(NULL);
 }
 
+bool Jlink::setDeferredRead(bool enable)
+{
+	if (!enable && _num_bits != 0)
+		flush();
+	_deferred_read = enable;
+	return true;
+}
+
 bool Jlink::ll_write(uint8_t *tdo)
 {
 	if (_num_bits == 0)
@@ -243,6 +293,7 @@ bool Jlink::ll_write(uint8_t *tdo)
 	int ret = read_device(rx_buf, numbytes+1);
 	if (ret < 0) {
 		printError("fails to read tdo");
+		_pending_reads.clear();
 		return false;
 	}
 
@@ -251,12 +302,26 @@ bool Jlink::ll_write(uint8_t *tdo)
 		printError("read status");
 		if (!read_device(&status, 1)) {
 			printError("fails to read status\n");
+			_pending_reads.clear();
 			return false;
 		}
 	} else {
 		status = rx_buf[numbytes];
 	}
 
+	/* extract tdo bits queued by writeTDI in deferred mode */
+	for (auto &p : _pending_reads) {
+		for (uint32_t i = 0; i < p.len; i++) {
+			uint32_t src = p.buf_pos + i, dst = p.rx_pos + i;
+			uint8_t mask = 1 << (dst & 0x07);
+			if (rx_buf[src >> 3] & (1 << (src & 0x07)))
+				p.rx[dst >> 3] |= mask;
+			else
+				p.rx[dst >> 3] &= ~mask;
+		}
+	}
+	_pending_reads.clear();
+
 	if (tdo) {
 		memcpy(tdo, rx_buf, numbytes);
 
@@ -353,6 +418,7 @@ int Jlink::read_device(uint8_t *buf, uint32_t size)
 	int actual_length, tries = 3;
 	uint32_t recv = 0, rest = size;
 	uint8_t *rx_ptr = buf;
+	uint64_t start = UsbStats::now();
 
 	do {
 		int ret = libusb_bulk_transfer(jlink_handle, jlink_read_ep,
@@ -375,6 +441,7 @@ int Jlink::read_device(uint8_t *buf, uint32_t size)
 	if (tries == 0)
 		printError("fail");
 
+	UsbStats::read(recv, start);
 	return recv;
 }
 
@@ -383,6 +450,7 @@ bool Jlink::write_device(const uint8_t *buf, uint32_t size)
 	int actual_length, tries = 4;
 	int rest_size = size, recv = 0;
 	uint8_t *buf_ptr = (uint8_t*)buf;
+	uint64_t start = UsbStats::now();
 
 	do {
 		int ret = libusb_bulk_transfer(jlink_handle, jlink_write_ep,
@@ -407,6 +475,7 @@ bool Jlink::write_device(const uint8_t *buf, uint32_t size)
 		return false;
 	}
 
+	UsbStats::write(recv, start);
 	return ((uint32_t)recv == size);
 }
 
@@ -71,6 +71,14 @@ class Jlink: public JtagInterface {
 		 */
 		int flush() override;
 
+		/*!
+		 * \brief enable/disable deferred read: when enabled writeTDI
+		 *        append bits to the buffer, rx is filled at flush time
+		 * \param[in] enable: deferred read state
+		 * \return true
+		 */
+		bool setDeferredRead(bool enable) override;
+
 		/*
 		 * unused
 		 */
@@ -302,6 +310,16 @@ class Jlink: public JtagInterface {
 		uint32_t _last_tms; /*!< last known TMS state */
 		uint32_t _last_tdi; /*!< last known TDI state */
 
+		/* tdo bits to extract from the next ll_write answer */
+		typedef struct {
+			uint8_t *rx;      /*!< destination buffer */
+			uint32_t rx_pos;  /*!< first bit position in rx */
+			uint32_t buf_pos; /*!< first bit position in _tdi */
+			uint32_t len;     /*!< number of bits */
+		} pending_read_t;
+		bool _deferred_read; /*!< writeTDI reads resolved at flush time */
+		std::vector<pending_read_t> _pending_reads; /*!< pending reads */
+
 		uint32_t _caps; /*!< current probe capacity */
 		uint8_t _hw_type;
 		uint8_t _major; /*!< major Jlink probe release number */
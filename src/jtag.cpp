@@ -5,16 +5,20 @@
 
 #include <libusb.h>
 
+#include <algorithm>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <vector>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <string>
 
 #include "anlogicCable.hpp"
+#include "cacheDir.hpp"
 #include "ch552_jtag.hpp"
 #include "display.hpp"
 #include "jtag.hpp"
@@ -22,6 +26,9 @@
 #include "ftdiJtagBitbang.hpp"
 #include "ftdiJtagMPSSE.hpp"
 #include "jlink.hpp"
+#include "jtagSim.hpp"
+#include "jtagTrace.hpp"
+#include "usbStats.hpp"
 #ifdef ENABLE_CMSISDAP
 #include "cmsisDAP.hpp"
 #endif
@@ -62,17 +69,145 @@ using namespace std;
  *           - envoyer le dernier avec 0x4B ou 0x6B
  */
 
+/* shortest TMS sequence to move from one TAP state to another:
+ * tms_path[from][to] -> TMS bits (sent LSB first) and number of bits
+ */
+typedef struct {
+	uint8_t tms;
+	uint8_t len;
+} tms_path_t;
+
+static constexpr tms_path_t tms_path[16][16] = {
+	/* from TEST_LOGIC_RESET */
+	{{0x00, 0}, {0x00, 1}, {0x02, 2}, {0x02, 3}, {0x02, 4}, {0x0a, 4}, {0x0a, 5}, {0x2a, 6},
+	 {0x1a, 5}, {0x06, 3}, {0x06, 4}, {0x06, 5}, {0x16, 5}, {0x16, 6}, {0x56, 7}, {0x36, 6}},
+	/* from RUN_TEST_IDLE */
+	{{0x07, 3}, {0x00, 0}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3}, {0x05, 4}, {0x15, 5},
+	 {0x0d, 4}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6}, {0x1b, 5}},
+	/* from SELECT_DR_SCAN */
+	{{0x03, 2}, {0x03, 3}, {0x00, 0}, {0x00, 1}, {0x00, 2}, {0x02, 2}, {0x02, 3}, {0x0a, 4},
+	 {0x06, 3}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3}, {0x05, 4}, {0x15, 5}, {0x0d, 4}},
+	/* from CAPTURE_DR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x00, 0}, {0x00, 1}, {0x01, 1}, {0x01, 2}, {0x05, 3},
+	 {0x03, 2}, {0x0f, 4}, {0x0f, 5}, {0x0f, 6}, {0x2f, 6}, {0x2f, 7}, {0xaf, 8}, {0x6f, 7}},
+	/* from SHIFT_DR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x00, 0}, {0x01, 1}, {0x01, 2}, {0x05, 3},
+	 {0x03, 2}, {0x0f, 4}, {0x0f, 5}, {0x0f, 6}, {0x2f, 6}, {0x2f, 7}, {0xaf, 8}, {0x6f, 7}},
+	/* from EXIT1_DR */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x02, 3}, {0x00, 0}, {0x00, 1}, {0x02, 2},
+	 {0x01, 1}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7}, {0x37, 6}},
+	/* from PAUSE_DR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x01, 2}, {0x05, 3}, {0x00, 0}, {0x01, 1},
+	 {0x03, 2}, {0x0f, 4}, {0x0f, 5}, {0x0f, 6}, {0x2f, 6}, {0x2f, 7}, {0xaf, 8}, {0x6f, 7}},
+	/* from EXIT2_DR */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x00, 1}, {0x02, 2}, {0x02, 3}, {0x00, 0},
+	 {0x01, 1}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7}, {0x37, 6}},
+	/* from UPDATE_DR */
+	{{0x07, 3}, {0x00, 1}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3}, {0x05, 4}, {0x15, 5},
+	 {0x00, 0}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6}, {0x1b, 5}},
+	/* from SELECT_IR_SCAN */
+	{{0x01, 1}, {0x01, 2}, {0x05, 3}, {0x05, 4}, {0x05, 5}, {0x15, 5}, {0x15, 6}, {0x55, 7},
+	 {0x35, 6}, {0x00, 0}, {0x00, 1}, {0x00, 2}, {0x02, 2}, {0x02, 3}, {0x0a, 4}, {0x06, 3}},
+	/* from CAPTURE_IR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7},
+	 {0x37, 6}, {0x0f, 4}, {0x00, 0}, {0x00, 1}, {0x01, 1}, {0x01, 2}, {0x05, 3}, {0x03, 2}},
+	/* from SHIFT_IR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7},
+	 {0x37, 6}, {0x0f, 4}, {0x0f, 5}, {0x00, 0}, {0x01, 1}, {0x01, 2}, {0x05, 3}, {0x03, 2}},
+	/* from EXIT1_IR */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6},
+	 {0x1b, 5}, {0x07, 3}, {0x07, 4}, {0x02, 3}, {0x00, 0}, {0x00, 1}, {0x02, 2}, {0x01, 1}},
+	/* from PAUSE_IR */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7},
+	 {0x37, 6}, {0x0f, 4}, {0x0f, 5}, {0x01, 2}, {0x05, 3}, {0x00, 0}, {0x01, 1}, {0x03, 2}},
+	/* from EXIT2_IR */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6},
+	 {0x1b, 5}, {0x07, 3}, {0x07, 4}, {0x00, 1}, {0x02, 2}, {0x02, 3}, {0x00, 0}, {0x01, 1}},
+	/* from UPDATE_IR */
+	{{0x07, 3}, {0x00, 1}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3}, {0x05, 4}, {0x15, 5},
+	 {0x0d, 4}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6}, {0x00, 0}},
+};
+
+/* chain detection: maximum number of devices and length (in bits)
+ * used to flush IR and DR chains
+ */
+#define DETECT_MAX_DEV  16
+#define DETECT_MAX_BITS 1024
+
+/* cache file: one file by cable (vid, pid and serial) */
+static string chain_cache_path(const cable_t &cable, const string &serial)
+{
+	string dir = cache_dir();
+	if (dir.empty())
+		return "";
+
+	char key[16];
+	snprintf(key, sizeof(key), "%04x_%04x", cable.config.vid & 0xffff,
+		cable.config.pid & 0xffff);
+	string name = "chain_" + string(key);
+	if (!serial.empty()) {
+		name += "_";
+		for (char c : serial)
+			name += (isalnum(c) || c == '-') ? c : '_';
+	}
+
+	return dir + "/" + name + ".txt";
+}
+
+static inline bool bit_at(const uint8_t *buf, int pos)
+{
+	return (buf[pos >> 3] >> (pos & 0x07)) & 0x01;
+}
+
+/* return position of the first bit set in buf between start and end,
+ * -1 if not found
+ */
+static int first_bit_set(const uint8_t *buf, int start, int end)
+{
+	for (int i = start; i < end; i++) {
+		if (bit_at(buf, i))
+			return i;
+	}
+	return -1;
+}
+
 Jtag::Jtag(cable_t &cable, const jtag_pins_conf_t *pin_conf, string dev,
 			const string &serial, uint32_t clkHZ, int8_t verbose,
-			const bool invert_read_edge, const string &firmware_path):
+			const bool invert_read_edge, const string &firmware_path,
+			const int detect_mode, const string &trace_file,
+			const string &sim_chain):
 			_verbose(verbose > 1),
 			_state(RUN_TEST_IDLE),
 			_tms_buffer_size(128), _num_tms(0),
-			_board_name("nope"), device_index(0)
+			_board_name("nope"), device_index(0),
+			_dr_bits_before(0), _dr_bits_after(0),
+			_ir_bits_before(0), _ir_bits_after(0),
+			_deferred_read(false)
 {
-	init_internal(cable, dev, serial, pin_conf, clkHZ, firmware_path,
-			invert_read_edge);
-	detectChain(5);
+	{
+		UsbStatsPhase phase(UsbStats::PHASE_OPEN);
+		init_internal(cable, dev, serial, pin_conf, clkHZ, firmware_path,
+				invert_read_edge, trace_file, sim_chain);
+	}
+
+	if (detect_mode != DETECT_FULL)
+		_cache_file = chain_cache_path(cable, serial);
+
+	UsbStatsPhase phase(UsbStats::PHASE_DETECT);
+	switch (detect_mode) {
+	case DETECT_NONE:
+		if (!load_chain_cache())
+			throw std::runtime_error("no cached JTAG chain topology for this cable");
+		break;
+	case DETECT_CACHE:
+		if (load_chain_cache() && validate_chain())
+			break;
+		detectChain(DETECT_MAX_DEV);
+		save_chain_cache();
+		break;
+	default:
+		detectChain(DETECT_MAX_DEV);
+	}
 }
 
 Jtag::~Jtag()
@@ -83,7 +218,8 @@ Jtag::~Jtag()
 
 void Jtag::init_internal(cable_t &cable, const string &dev, const string &serial,
 	const jtag_pins_conf_t *pin_conf, uint32_t clkHZ, const string &firmware_path,
-	const bool invert_read_edge)
+	const bool invert_read_edge, const string &trace_file,
+	const string &sim_chain)
 {
 	switch (cable.type) {
 	case MODE_ANLOGICCABLE:
@@ -116,11 +252,21 @@ void Jtag::init_internal(cable_t &cable, const string &dev, const string &serial
 		_jtag = new CmsisDAP(cable.config.vid, cable.config.pid, _verbose);
 		break;
 #endif
+	case MODE_REPLAY:
+		_jtag = new JtagReplay(trace_file, _verbose);
+		break;
+	case MODE_SIM:
+		_jtag = new JtagSim(sim_chain, _verbose);
+		break;
 	default:
 		std::cerr << "Jtag: unknown cable type" << std::endl;
 		throw std::exception();
 	}
 
+	/* record all accesses to the converter */
+	if (!trace_file.empty() && cable.type != MODE_REPLAY)
+		_jtag = new JtagRecorder(_jtag, trace_file);
+
 	_tms_buffer = (unsigned char *)malloc(sizeof(unsigned char) * _tms_buffer_size);
 	memset(_tms_buffer, 0, _tms_buffer_size);
 }
@@ -128,26 +274,69 @@ void Jtag::init_internal(cable_t &cable, const string &dev, const string &serial
 int Jtag::detectChain(int max_dev)
 {
 	char message[256];
-	unsigned char rx_buff[4];
+	const int n = DETECT_MAX_BITS;
 	/* WA for CH552/tangNano: write is always mandatory */
-	unsigned char tx_buff[4] = {0xff, 0xff, 0xff, 0xff};
-	unsigned int tmp;
+	std::vector<uint8_t> tx(2 * n / 8), rx(2 * n / 8);
+	memset(tx.data(), 0x00, n / 8);
+	memset(tx.data() + n / 8, 0xff, n / 8);
 
 	/* cleanup */
 	_devices_list.clear();
 	_irlength_list.clear();
 
+	go_test_logic_reset();
+
+	/* IR: flush with 0 then with 1: first bits are captured values,
+	 * first 1 after the flush gives total IR length.
+	 * All devices are in BYPASS after this scan
+	 */
+	set_state(SHIFT_IR);
+	read_write(tx.data(), rx.data(), 2 * n, 1);
+	set_state(RUN_TEST_IDLE);
+	int ir_total = first_bit_set(rx.data(), n, 2 * n) - n;
+	std::vector<uint8_t> ir_capture(rx.begin(), rx.begin() + n / 8);
+
+	/* DR: same principle with BYPASS register (1 bit per device) */
+	set_state(SHIFT_DR);
+	read_write(tx.data(), rx.data(), 2 * n, 1);
+	set_state(RUN_TEST_IDLE);
+	int nb_dev = first_bit_set(rx.data(), n, 2 * n) - n;
+
+	if (nb_dev <= 0 || ir_total < 2 * nb_dev) {
+		go_test_logic_reset();
+		flushTMS(true);
+		update_padding();
+		return 0;
+	}
+	if (nb_dev > max_dev)
+		throw std::runtime_error("too many devices in JTAG chain (" +
+			std::to_string(nb_dev) + ")");
+
+	/* IDCODE (or BYPASS: one bit to 0) loaded after reset */
 	go_test_logic_reset();
 	set_state(SHIFT_DR);
+	memset(tx.data(), 0xff, 32 * nb_dev / 8);
+	read_write(tx.data(), rx.data(), 32 * nb_dev, 1);
+	go_test_logic_reset();
+	flushTMS(true);
 
 	if (_verbose)
 		printInfo("Raw IDCODE:");
 
-	for (int i = 0; i < max_dev; i++) {
-		read_write(tx_buff, rx_buff, 32, (i == max_dev-1)?1:0);
-		tmp = 0;
-		for (int ii=0; ii < 4; ii++)
-			tmp |= (rx_buff[ii] << (8*ii));
+	/* devices are read from TDO to TDI */
+	std::vector<uint32_t> idcodes;
+	std::vector<int16_t> irlengths;
+	int pos = 0;
+	for (int i = 0; i < nb_dev; i++) {
+		uint32_t tmp = 0;
+		if (bit_at(rx.data(), pos)) {
+			for (int ii = 0; ii < 32; ii++, pos++) {
+				if (bit_at(rx.data(), pos))
+					tmp |= (1u << ii);
+			}
+		} else {
+			pos++;  // no IDCODE
+		}
 
 		if (_verbose) {
 			snprintf(message, sizeof(message), "- %d -> 0x%08x", i, tmp);
@@ -159,57 +348,186 @@ int Jtag::detectChain(int max_dev)
 		 * we start to search sub IDCODE
 		 * if IDCODE has no match: try the same with version unmasked
 		 */
-		if (tmp != 0 && tmp != 0xffffffff) {
-			bool found = false;
+		int16_t irlength = -1;
+		bool found = false;
+		if (tmp != 0) {
 			/* ckeck highest nibble to prevent confusion between Cologne Chip
 			 * GateMate and Efinix Trion T4/T8 devices
 			 */
 			if (tmp != 0x20000001)
-				found = search_and_insert_device_with_idcode(tmp & 0x0fffffff);
-			if (!found) /* if masked not found -> search for full */
-				found = search_and_insert_device_with_idcode(tmp);
-
-			if (!found) {
-				uint16_t mfg = IDCODE2MANUFACTURERID(tmp);
-				uint8_t part = IDCODE2PART(tmp);
-				uint8_t vers = IDCODE2VERS(tmp);
-
-				char error[1024];
-				snprintf(error, sizeof(error),
-						"Unknown device with IDCODE: 0x%08x"
-						" (manufacturer: 0x%03x (%s),"
-						" part: 0x%02x vers: 0x%x", tmp,
-						mfg, list_manufacturer[mfg].c_str(), part, vers);
-				throw std::runtime_error(error);
+				found = search_idcode(tmp & 0x0fffffff, &irlength);
+			if (found)
+				tmp &= 0x0fffffff;
+			else /* if masked not found -> search for full */
+				found = search_idcode(tmp, &irlength);
+		}
+
+		if (!found) {
+			uint16_t mfg = IDCODE2MANUFACTURERID(tmp);
+			uint8_t part = IDCODE2PART(tmp);
+			uint8_t vers = IDCODE2VERS(tmp);
+
+			snprintf(message, sizeof(message),
+					"Unknown device with IDCODE: 0x%08x"
+					" (manufacturer: 0x%03x (%s),"
+					" part: 0x%02x vers: 0x%x", tmp,
+					mfg, list_manufacturer[mfg].c_str(), part, vers);
+			printWarn(message);
+		}
+		idcodes.push_back(tmp);
+		irlengths.push_back(irlength);
+	}
+
+	/* unknown irlength: each device captures xx..01 in IR. Use this
+	 * pattern to find next device, last unknown takes remaining bits
+	 */
+	int known = 0, nb_unknown = 0;
+	for (auto len : irlengths) {
+		if (len == -1)
+			nb_unknown++;
+		else
+			known += len;
+	}
+	pos = 0;
+	for (int i = 0; i < nb_dev; i++) {
+		if (irlengths[i] == -1) {
+			int len;
+			if (--nb_unknown == 0) {
+				len = ir_total - known;
+			} else {
+				len = 2;
+				while (pos + len + 1 < ir_total &&
+						!(bit_at(ir_capture.data(), pos + len) &&
+						!bit_at(ir_capture.data(), pos + len + 1)))
+					len++;
 			}
+			if (len < 2)
+				throw std::runtime_error("can't determine irlength for device " +
+					std::to_string(nb_dev - 1 - i));
+			irlengths[i] = len;
+			known += len;
 		}
+		pos += irlengths[i];
 	}
-	go_test_logic_reset();
-	flushTMS(true);
+	if (pos != ir_total)
+		throw std::runtime_error("IR chain length mismatch: " +
+			std::to_string(pos) + " instead of " + std::to_string(ir_total));
+
+	for (int i = 0; i < nb_dev; i++)
+		insert_first(idcodes[i], irlengths[i]);
+
 	return _devices_list.size();
 }
 
-bool Jtag::search_and_insert_device_with_idcode(uint32_t idcode)
+bool Jtag::search_idcode(uint32_t idcode, int16_t *irlength)
 {
-	int irlength = -1;
 	auto dev = fpga_list.find(idcode);
-	if (dev != fpga_list.end())
-		irlength = dev->second.irlength;
-	if (irlength == -1) {
-		auto misc = misc_dev_list.find(idcode);
-		if (misc != misc_dev_list.end())
-			irlength = misc->second.irlength;
+	if (dev != fpga_list.end()) {
+		*irlength = dev->second.irlength;
+		return true;
+	}
+	auto misc = misc_dev_list.find(idcode);
+	if (misc != misc_dev_list.end()) {
+		*irlength = misc->second.irlength;
+		return true;
 	}
-	if (irlength == -1)
+	return false;
+}
+
+bool Jtag::load_chain_cache()
+{
+	if (_cache_file.empty())
+		return false;
+	std::ifstream fd(_cache_file);
+	if (!fd.is_open())
 		return false;
 
-	return insert_first(idcode, irlength);
+	_devices_list.clear();
+	_irlength_list.clear();
+	std::string line;
+	while (std::getline(fd, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+		uint32_t idcode;
+		int irlength;
+		if (sscanf(line.c_str(), "%x %d", &idcode, &irlength) != 2 ||
+				irlength < 2) {
+			_devices_list.clear();
+			_irlength_list.clear();
+			return false;
+		}
+		_devices_list.push_back(idcode);
+		_irlength_list.push_back(irlength);
+	}
+	update_padding();
+
+	return !_devices_list.empty();
+}
+
+void Jtag::save_chain_cache()
+{
+	if (_cache_file.empty() || _devices_list.empty())
+		return;
+	std::ofstream fd(_cache_file);
+	if (!fd.is_open())
+		return;
+	fd << "# openFPGALoader JTAG chain: idcode irlength (index order)\n";
+	for (size_t i = 0; i < _devices_list.size(); i++) {
+		char line[32];
+		snprintf(line, sizeof(line), "%08x %d\n",
+			static_cast<uint32_t>(_devices_list[i]), _irlength_list[i]);
+		fd << line;
+	}
+}
+
+bool Jtag::validate_chain()
+{
+	/* IDCODE (32 bits) or BYPASS (1 bit) for each device, 32 bits more
+	 * to check end of chain (tdi bits must come back)
+	 */
+	int nb_bits = 32;
+	for (auto id : _devices_list)
+		nb_bits += (id != 0) ? 32 : 1;
+	std::vector<uint8_t> tx((nb_bits + 7) / 8, 0xff), rx((nb_bits + 7) / 8, 0);
+
+	go_test_logic_reset();
+	set_state(SHIFT_DR);
+	read_write(tx.data(), rx.data(), nb_bits, 1);
+	go_test_logic_reset();
+	flushTMS(true);
+
+	int pos = 0;
+	bool valid = true;
+	for (int i = _devices_list.size() - 1; i >= 0 && valid; i--) {
+		uint32_t cached = _devices_list[i];
+		uint32_t tmp = 0;
+		int len = (cached != 0) ? 32 : 1;
+		for (int ii = 0; ii < len; ii++, pos++) {
+			if (bit_at(rx.data(), pos))
+				tmp |= (1u << ii);
+		}
+		/* stored IDCODE may have version masked */
+		valid = (tmp == cached) || ((tmp & 0x0fffffff) == cached);
+	}
+	for (; pos < nb_bits && valid; pos++)
+		valid = bit_at(rx.data(), pos);
+
+	if (valid) {
+		update_padding();
+	} else {
+		printInfo("JTAG chain changed: full detection");
+		_devices_list.clear();
+		_irlength_list.clear();
+	}
+	return valid;
 }
 
 bool Jtag::insert_first(uint32_t device_id, uint16_t irlength)
 {
 	_devices_list.insert(_devices_list.begin(), device_id);
 	_irlength_list.insert(_irlength_list.begin(), irlength);
+	/* chain changed: update padding */
+	update_padding();
 
 	return true;
 }
@@ -219,17 +537,48 @@ uint16_t Jtag::device_select(uint16_t index)
 	if (index > (uint16_t) _devices_list.size())
 		return -1;
 	device_index = index;
+	update_padding();
+
 	return device_index;
 }
 
+void Jtag::update_padding()
+{
+	/* devices are ordered from TDI (index 0) to TDO: in DR
+	 * each device in bypass adds one bit, in IR the BYPASS
+	 * instruction (all 1) must be shifted for each one
+	 */
+	int nb_dev = _devices_list.size();
+	_dr_bits_before = (device_index < nb_dev) ? nb_dev - device_index - 1 : 0;
+	_dr_bits_after = device_index;
+	_ir_bits_before = 0;
+	for (int i = device_index + 1; i < nb_dev; i++)
+		_ir_bits_before += _irlength_list[i];
+	_ir_bits_after = 0;
+	for (int i = 0; i < device_index && i < nb_dev; i++)
+		_ir_bits_after += _irlength_list[i];
+
+	int max_pad = std::max(std::max(_dr_bits_before, _dr_bits_after),
+		std::max(_ir_bits_before, _ir_bits_after));
+	_pad_ones.assign((max_pad + 7) / 8, 0xff);
+}
+
 void Jtag::setTMS(unsigned char tms)
 {
-	display("%s %x %d %d\n", __func__, tms, _num_tms, (_num_tms >> 3));
-	if (_num_tms+1 == _tms_buffer_size * 8)
+	appendTMS((tms != 0) ? 1 : 0, 1);
+}
+
+void Jtag::appendTMS(uint8_t tms, uint8_t len)
+{
+	display("%s %x %d %d\n", __func__, tms, len, _num_tms);
+	if (_num_tms + len > _tms_buffer_size * 8)
 		flushTMS(false);
-	if (tms != 0)
-		_tms_buffer[_num_tms>>3] |= (0x1) << (_num_tms & 0x7);
-	_num_tms++;
+	/* a sequence is at most 8 bits long: it spans two bytes at most */
+	uint16_t word = static_cast<uint16_t>(tms) << (_num_tms & 0x07);
+	_tms_buffer[_num_tms >> 3] |= word & 0xff;
+	if (word >> 8)
+		_tms_buffer[(_num_tms >> 3) + 1] |= word >> 8;
+	_num_tms += len;
 }
 
 /* reconstruct byte sent to TMS pins
@@ -248,8 +597,8 @@ int Jtag::flushTMS(bool flush_buffer)
 
 		ret = _jtag->writeTMS(_tms_buffer, _num_tms, flush_buffer);
 
-		/* reset buffer and number of bits */
-		memset(_tms_buffer, 0, _tms_buffer_size);
+		/* reset used part of the buffer and number of bits */
+		memset(_tms_buffer, 0, (_num_tms + 7) >> 3);
 		_num_tms = 0;
 	} else if (flush_buffer) {
 		_jtag->flush();
@@ -260,16 +609,19 @@ int Jtag::flushTMS(bool flush_buffer)
 void Jtag::go_test_logic_reset()
 {
 	/* idenpendly to current state 5 clk with TMS high is enough */
-	for (int i = 0; i < 6; i++)
-		setTMS(0x01);
+	appendTMS(0x3f, 6);
 	flushTMS(false);
 	_state = TEST_LOGIC_RESET;
 }
 
-int Jtag::read_write(unsigned char *tdi, unsigned char *tdo, int len, char last)
+int Jtag::read_write(unsigned char *tdi, unsigned char *tdo, int len, char last,
+		bool msb_first)
 {
 	flushTMS(false);
-	_jtag->writeTDI(tdi, tdo, len, last);
+	if (msb_first)
+		_jtag->writeTDI(tdi, tdo, len, last, true);
+	else
+		_jtag->writeTDI(tdi, tdo, len, last);
 	if (last == 1)
 		_state = (_state == SHIFT_DR) ? EXIT1_DR : EXIT1_IR;
 	return 0;
@@ -285,56 +637,164 @@ void Jtag::toggleClk(int nb)
 	return;
 }
 
-int Jtag::shiftDR(unsigned char *tdi, unsigned char *tdo, int drlen, int end_state)
+void Jtag::waitUs(uint32_t min_us, uint32_t min_clocks)
 {
-	/* get number of devices in the JTAG chain
-	 * after the selected one
-	 */
-	int bits_after = device_index;
+	unsigned char c = (TEST_LOGIC_RESET == _state) ? 1 : 0;
+	flushTMS(false);
+	if (_jtag->waitUs(min_us, min_clocks, c) >= 0)
+		return;
+	throw std::exception();
+}
 
-	/* if current state not shift DR
-	 * move to this state
-	 */
-	if (_state != SHIFT_DR) {
-		set_state(SHIFT_DR);
-		flushTMS(false);  // force transmit tms state
+void Jtag::shift_padded(unsigned char *tdi, unsigned char *tdo, int len,
+		int before, int after, bool last, bool msb_first)
+{
+	if (before == 0 && after == 0) {
+		read_write(tdi, tdo, len, last, msb_first);
+		return;
+	}
 
-		/* get number of devices, in the JTAG chain,
-		 * before the selected one
-		 */
-		int bits_before = _devices_list.size() - device_index - 1;
+	/* deferred tdo can't be realigned before the queue is flushed
+	 * and MSB first payload can't be merged with padding:
+	 * padding is sent with dedicated (buffered) scans
+	 */
+	if ((tdo && _deferred_read) || msb_first) {
+		if (before > 0)
+			read_write(_pad_ones.data(), NULL, before, 0);
+		read_write(tdi, tdo, len, last && after == 0, msb_first);
+		if (after > 0)
+			read_write(_pad_ones.data(), NULL, after, last);
+		return;
+	}
 
-		/* if not 0 send enough bits
-		 */
-		if (bits_before > 0) {
-			int n = (bits_before + 7) / 8;
-			uint8_t tx[n];
-			memset(tx, 0xff, n);
-			read_write(tx, NULL, bits_before, 0);
+	int total = before + len + after;
+	int nb_byte = (total + 7) >> 3;
+	/* one extra byte: payload copy may overflow by one byte */
+	_pad_tx.assign(nb_byte + 1, 0);
+
+	/* padding before */
+	for (int i = 0; i < before; i++)
+		_pad_tx[i >> 3] |= 1 << (i & 0x07);
+	/* payload */
+	if (tdi) {
+		int shift = before & 0x07;
+		uint8_t *dst = _pad_tx.data() + (before >> 3);
+		int len_byte = (len + 7) >> 3;
+		if (shift == 0) {
+			memcpy(dst, tdi, len_byte);
+		} else {
+			for (int i = 0; i < len_byte; i++) {
+				dst[i] |= tdi[i] << shift;
+				dst[i + 1] |= tdi[i] >> (8 - shift);
+			}
 		}
 	}
+	/* padding after (also override extra payload bits) */
+	for (int i = before + len; i < nb_byte * 8; i++)
+		_pad_tx[i >> 3] |= 1 << (i & 0x07);
 
-	/* write tdi (and read tdo) to the selected device
-	 * end (ie TMS high) is used only when current device
-	 * is the last of the chain and a state change must
-	 * be done
+	if (!tdo) {
+		read_write(_pad_tx.data(), NULL, total, last);
+		return;
+	}
+
+	_pad_rx.assign(nb_byte + 1, 0);
+	read_write(_pad_tx.data(), _pad_rx.data(), total, last);
+
+	/* realign payload */
+	int shift = before & 0x07;
+	const uint8_t *src = _pad_rx.data() + (before >> 3);
+	int len_byte = (len + 7) >> 3;
+	if (shift == 0) {
+		memcpy(tdo, src, len_byte);
+	} else {
+		for (int i = 0; i < len_byte; i++)
+			tdo[i] = (src[i] >> shift) | (src[i + 1] << (8 - shift));
+	}
+	if (len & 0x07)
+		tdo[len_byte - 1] &= (1 << (len & 0x07)) - 1;
+}
+
+int Jtag::shiftDR(unsigned char *tdi, unsigned char *tdo, int drlen, int end_state,
+		bool msb_first)
+{
+	/* devices before the selected one must be filled when entering
+	 * SHIFT DR, devices after when leaving: padding is sent with
+	 * the payload
 	 */
-	read_write(tdi, tdo, drlen, bits_after == 0 && end_state != SHIFT_DR);
+	int bits_before = (_state != SHIFT_DR) ? _dr_bits_before : 0;
+	int bits_after = (end_state != SHIFT_DR) ? _dr_bits_after : 0;
 
-	/* if it's asked to move in FSM */
-	if (end_state != SHIFT_DR) {
-		/* if current device is not the last */
-		if (bits_after > 0) {
-			int n = (bits_after + 7) / 8;
-			uint8_t tx[n];
-			memset(tx, 0xff, n);
-			read_write(tx, NULL, bits_after, 1);  // its the last force
-			                                      // tms high with last bit
-		}
+	/* if current state not shift DR move to this state:
+	 * TMS sequence is sent with the first TDI bits
+	 */
+	moveToState(SHIFT_DR);
+
+	/* end (ie TMS high) is used with the last bit when a state
+	 * change must be done
+	 */
+	shift_padded(tdi, tdo, drlen, bits_before, bits_after,
+		end_state != SHIFT_DR, msb_first);
 
-		/* move to end_state */
+	/* if it's asked to move in FSM */
+	if (end_state != SHIFT_DR)
 		set_state(end_state);
+	return 0;
+}
+
+/* lower bound for a stream chunk: small interface buffers are
+ * grouped to limit per call overhead
+ */
+#define STREAM_CHUNK_MIN 4096
+
+uint32_t Jtag::stream_chunk_size()
+{
+	int buf_size = _jtag->get_buffer_size();
+	if (buf_size <= 0)
+		return STREAM_CHUNK_MIN;
+	uint32_t chunk = buf_size;
+	if (chunk < STREAM_CHUNK_MIN)
+		chunk *= (STREAM_CHUNK_MIN + chunk - 1) / chunk;
+	return chunk;
+}
+
+int Jtag::shiftDR_stream(unsigned char *tdi, uint32_t len, int end_state,
+		progress_cb_t progress, bool msb_first)
+{
+	uint32_t chunk = stream_chunk_size();
+
+	for (uint32_t pos = 0; pos < len; pos += chunk) {
+		uint32_t xfer_len = (len - pos > chunk) ? chunk : len - pos;
+		bool last = (pos + xfer_len == len);
+		int ret = shiftDR(tdi + pos, NULL, 8 * xfer_len,
+			(last) ? end_state : SHIFT_DR, msb_first);
+		if (ret < 0)
+			return ret;
+		if (progress)
+			progress(pos + xfer_len);
+	}
+	flush();
+	return 0;
+}
+
+int Jtag::shiftDR_stream(producer_cb_t producer, uint32_t len, int end_state,
+		progress_cb_t progress)
+{
+	uint32_t chunk = stream_chunk_size();
+	std::vector<uint8_t> buf(chunk);
+
+	for (uint32_t pos = 0; pos < len; pos += chunk) {
+		uint32_t xfer_len = (len - pos > chunk) ? chunk : len - pos;
+		bool last = (pos + xfer_len == len);
+		producer(buf.data(), pos, xfer_len);
+		int ret = shiftDR(buf.data(), NULL, 8 * xfer_len,
+			(last) ? end_state : SHIFT_DR);
+		if (ret < 0)
+			return ret;
+		if (progress)
+			progress(pos + xfer_len);
 	}
+	flush();
 	return 0;
 }
 
@@ -350,255 +810,68 @@ int Jtag::shiftIR(unsigned char tdi, int irlen, int end_state)
 int Jtag::shiftIR(unsigned char *tdi, unsigned char *tdo, int irlen, int end_state)
 {
 	display("%s: avant shiftIR\n", __func__);
-	int bypass_after = 0;
-	if (end_state != SHIFT_IR) {
-		/* when the device is not alone and not
-		 * the first a serie of bypass must be
-		 * send to complete send ir sequence
-		 */
-		for (int i = 0; i < device_index; i++)
-			bypass_after += _irlength_list[i];
-	}
-
-	/* if not in SHIFT IR move to this state */
-	if (_state != SHIFT_IR) {
-		set_state(SHIFT_IR);
-		/* force flush */
-		flushTMS(false);
+	/* when the device is not alone a serie of bypass instructions
+	 * must be sent for devices before (when entering SHIFT IR)
+	 * and after (when leaving it) the selected one
+	 */
+	int bypass_before = (_state != SHIFT_IR) ? _ir_bits_before : 0;
+	int bypass_after = (end_state != SHIFT_IR) ? _ir_bits_after : 0;
 
-		/* send serie of bypass instructions
-		 * final size depends on number of device
-		 * before targeted and irlength of each one
-		 */
-		int bypass_before = 0;
-		for (unsigned int i = device_index + 1; i < _devices_list.size(); i++)
-			bypass_before += _irlength_list[i];
-
-		/* if > 0 send bits */
-		if (bypass_before > 0) {
-			int n = (bypass_before + 7) / 8;
-			uint8_t tx[n];
-			memset(tx, 0xff, n);
-			read_write(tx, NULL, bypass_before, 0);
-		}
-	}
+	/* if not in SHIFT IR move to this state:
+	 * TMS sequence is sent with the first TDI bits
+	 */
+	moveToState(SHIFT_IR);
 
 	display("%s: envoi ircode\n", __func__);
 
-	/* write tdi (and read tdo) to the selected device
-	 * end (ie TMS high) is used only when current device
-	 * is the last of the chain and a state change must
-	 * be done
+	/* end (ie TMS high) is used with the last bit when a state
+	 * change must be done
 	 */
-	read_write(tdi, tdo, irlen, bypass_after == 0 && end_state != SHIFT_IR);
+	shift_padded(tdi, tdo, irlen, bypass_before, bypass_after,
+		end_state != SHIFT_IR);
 
 	/* it's asked to move out of SHIFT IR state */
-	if (end_state != SHIFT_IR) {
-		/* again if devices after fill '1' */
-		if (bypass_after > 0) {
-			int n = (bypass_after + 7) / 8;
-			uint8_t tx[n];
-			memset(tx, 0xff, n);
-			read_write(tx, NULL, bypass_after, 1);
-		}
-		/* move to the requested state */
+	if (end_state != SHIFT_IR)
 		set_state(end_state);
-	}
 
 	return 0;
 }
 
 void Jtag::set_state(int newState)
 {
-	unsigned char tms;
-	while (newState != _state) {
-		display("_state : %16s(%02d) -> %s(%02d) ",
-			getStateName((tapState_t)_state),
-			_state,
-			getStateName((tapState_t)newState), newState);
-		switch (_state) {
-		case TEST_LOGIC_RESET:
-			if (newState == TEST_LOGIC_RESET) {
-				tms = 1;
-			} else {
-				tms = 0;
-				_state = RUN_TEST_IDLE;
-			}
-			break;
-		case RUN_TEST_IDLE:
-			if (newState == RUN_TEST_IDLE) {
-				tms = 0;
-			} else {
-				tms = 1;
-				_state = SELECT_DR_SCAN;
-			}
-			break;
-		case SELECT_DR_SCAN:
-			switch (newState) {
-			case CAPTURE_DR:
-			case SHIFT_DR:
-			case EXIT1_DR:
-			case PAUSE_DR:
-			case EXIT2_DR:
-			case UPDATE_DR:
-				tms = 0;
-				_state = CAPTURE_DR;
-				break;
-			default:
-				tms = 1;
-				_state = SELECT_IR_SCAN;
-			}
-			break;
-		case SELECT_IR_SCAN:
-			switch (newState) {
-			case CAPTURE_IR:
-			case SHIFT_IR:
-			case EXIT1_IR:
-			case PAUSE_IR:
-			case EXIT2_IR:
-			case UPDATE_IR:
-				tms = 0;
-				_state = CAPTURE_IR;
-				break;
-			default:
-				tms = 1;
-				_state = TEST_LOGIC_RESET;
-			}
-			break;
-			/* DR column */
-		case CAPTURE_DR:
-			if (newState == SHIFT_DR) {
-				tms = 0;
-				_state = SHIFT_DR;
-			} else {
-				tms = 1;
-				_state = EXIT1_DR;
-			}
-			break;
-		case SHIFT_DR:
-			if (newState == SHIFT_DR) {
-				tms = 0;
-			} else {
-				tms = 1;
-				_state = EXIT1_DR;
-			}
-			break;
-		case EXIT1_DR:
-			switch (newState) {
-			case PAUSE_DR:
-			case EXIT2_DR:
-			case SHIFT_DR:
-			case EXIT1_DR:
-				tms = 0;
-				_state = PAUSE_DR;
-				break;
-			default:
-				tms = 1;
-				_state = UPDATE_DR;
-			}
-			break;
-		case PAUSE_DR:
-			if (newState == PAUSE_DR) {
-				tms = 0;
-			} else {
-				tms = 1;
-				_state = EXIT2_DR;
-			}
-			break;
-		case EXIT2_DR:
-			switch (newState) {
-			case SHIFT_DR:
-			case EXIT1_DR:
-			case PAUSE_DR:
-				tms = 0;
-				_state = SHIFT_DR;
-				break;
-			default:
-				tms = 1;
-				_state = UPDATE_DR;
-			}
-			break;
-		case UPDATE_DR:
-			if (newState == RUN_TEST_IDLE) {
-				tms = 0;
-				_state = RUN_TEST_IDLE;
-			} else {
-				tms = 1;
-				_state = SELECT_DR_SCAN;
-			}
-			break;
-			/* IR column */
-		case CAPTURE_IR:
-			if (newState == SHIFT_IR) {
-				tms = 0;
-				_state = SHIFT_IR;
-			} else {
-				tms = 1;
-				_state = EXIT1_IR;
-			}
-			break;
-		case SHIFT_IR:
-			if (newState == SHIFT_IR) {
-				tms = 0;
-			} else {
-				tms = 1;
-				_state = EXIT1_IR;
-			}
-			break;
-		case EXIT1_IR:
-			switch (newState) {
-			case PAUSE_IR:
-			case EXIT2_IR:
-			case SHIFT_IR:
-			case EXIT1_IR:
-				tms = 0;
-				_state = PAUSE_IR;
-				break;
-			default:
-				tms = 1;
-				_state = UPDATE_IR;
-			}
-			break;
-		case PAUSE_IR:
-			if (newState == PAUSE_IR) {
-				tms = 0;
-			} else {
-				tms = 1;
-				_state = EXIT2_IR;
-			}
-			break;
-		case EXIT2_IR:
-			switch (newState) {
-			case SHIFT_IR:
-			case EXIT1_IR:
-			case PAUSE_IR:
-				tms = 0;
-				_state = SHIFT_IR;
-				break;
-			default:
-				tms = 1;
-				_state = UPDATE_IR;
-			}
-			break;
-		case UPDATE_IR:
-			if (newState == RUN_TEST_IDLE) {
-				tms = 0;
-				_state = RUN_TEST_IDLE;
-			} else {
-				tms = 1;
-				_state = SELECT_DR_SCAN;
-			}
-			break;
-		}
-
-		setTMS(tms);
-		display("%d %d %d %x\n", tms, _num_tms-1, _state,
-			_tms_buffer[(_num_tms-1) / 8]);
-	}
+	moveToState(newState);
 	/* force write buffer */
 	flushTMS(false);
 }
 
+void Jtag::moveToState(int newState)
+{
+	if (newState == _state)
+		return;
+
+	/* state not tracked (UNKNOWN or out of table): known path
+	 * from TEST_LOGIC_RESET after 5 clk with TMS high
+	 */
+	if (_state < TEST_LOGIC_RESET || _state > UPDATE_IR) {
+		appendTMS(0x1f, 5);
+		_state = TEST_LOGIC_RESET;
+		if (newState == _state)
+			return;
+	}
+	if (newState < TEST_LOGIC_RESET || newState > UPDATE_IR) {
+		printError("Jtag: unknown TAP state " + std::to_string(newState));
+		return;
+	}
+
+	const tms_path_t &path = tms_path[_state][newState];
+	display("_state : %16s(%02d) -> %s(%02d) tms: %02x (%d)\n",
+		getStateName((tapState_t)_state), _state,
+		getStateName((tapState_t)newState), newState,
+		path.tms, path.len);
+	appendTMS(path.tms, path.len);
+	_state = newState;
+}
+
 const char *Jtag::getStateName(tapState_t s)
 {
 	switch (s) {
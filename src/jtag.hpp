@@ -6,6 +6,7 @@
 #ifndef JTAG_H
 #define JTAG_H
 #include <ftdi.h>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -20,21 +21,40 @@ class Jtag {
 	Jtag(cable_t &cable, const jtag_pins_conf_t *pin_conf, std::string dev,
 		const std::string &serial, uint32_t clkHZ, int8_t verbose = 0,
 		const bool invert_read_edge = false,
-		const std::string &firmware_path = "");
+		const std::string &firmware_path = "",
+		const int detect_mode = DETECT_FULL,
+		const std::string &trace_file = "",
+		const std::string &sim_chain = "");
 	~Jtag();
 
+	/* chain detection at startup */
+	enum detect_mode_t {
+		DETECT_FULL = 0,  /*!< full detection, cache not used */
+		DETECT_CACHE = 1, /*!< cached topology validated by an IDCODE scan */
+		DETECT_NONE = 2   /*!< cached topology used without any scan */
+	};
+
 	/* maybe to update */
 	int setClkFreq(uint32_t clkHZ) { return _jtag->setClkFreq(clkHZ);}
 	uint32_t getClkFreq() { return _jtag->getClkFreq();}
 
 	/*!
-	 * \brief scan JTAG chain to obtain IDCODE. Fill
-	 *        a vector with all idcode and another
-	 *        vector with irlength
+	 * \brief scan JTAG chain to obtain IDCODE. Number of devices and
+	 *        total IR length are measured by flushing chain, so
+	 *        devices without IDCODE or not in database are supported
+	 *        (irlength is deduced from captured IR). Fill a vector
+	 *        with all idcode and another vector with irlength
+	 * \param[in] max_dev: maximum number of devices in the chain
 	 * \return number of devices found
 	 */
 	int detectChain(int max_dev);
 
+	/*!
+	 * \brief return list of devices irlength
+	 * \return list of irlength (same order as devices list)
+	 */
+	std::vector<int16_t> get_irlength_list() {return _irlength_list;}
+
 	/*!
 	 * \brief return list of devices in the chain
 	 * \return list of devices
@@ -48,7 +68,8 @@ class Jtag {
 	uint32_t get_target_device_id() {return _devices_list[device_index];}
 
 	/*!
-	 * \brief set index for targeted FPGA
+	 * \brief set index for targeted FPGA and compute bypass padding
+	 *        required, by IR and DR scans, for others devices
 	 * \param[in] index: index in the chain
 	 * \return -1 if index is out of bound, index otherwise
 	 */
@@ -65,15 +86,96 @@ class Jtag {
 		int end_state = RUN_TEST_IDLE);
 	int shiftIR(unsigned char tdi, int irlen,
 		int end_state = RUN_TEST_IDLE);
+	/*!
+	 * \brief shift drlen bits in DR of the selected device
+	 * \param[in] tdi: data to send (may be NULL)
+	 * \param[out] tdo: data read back (may be NULL)
+	 * \param[in] drlen: number of bits
+	 * \param[in] end_state: state after the last bit
+	 * \param[in] msb_first: bytes are shifted starting with bit 7
+	 *            (avoid a reversed copy of MSB first data)
+	 * \return < 0 if something wrong, 0 otherwise
+	 */
 	int shiftDR(unsigned char *tdi, unsigned char *tdo, int drlen,
-		int end_state = RUN_TEST_IDLE);
-	int read_write(unsigned char *tdi, unsigned char *tdo, int len, char last);
+		int end_state = RUN_TEST_IDLE, bool msb_first = false);
+	/*!
+	 * \brief progress callback: number of bytes already sent
+	 */
+	typedef std::function<void(uint32_t done)> progress_cb_t;
+	/*!
+	 * \brief producer callback: fill buf with len bytes starting at
+	 *        offset in the stream
+	 */
+	typedef std::function<void(uint8_t *buf, uint32_t offset,
+		uint32_t len)> producer_cb_t;
+	/*!
+	 * \brief shift a large buffer in DR. Data is sent by chunks sized
+	 *        for the interface, independently of progress reporting
+	 * \param[in] tdi: data to send
+	 * \param[in] len: number of bytes
+	 * \param[in] end_state: state after the last bit
+	 * \param[in] progress: called after each chunk (may be empty)
+	 * \param[in] msb_first: bytes are shifted starting with bit 7
+	 * \return < 0 if something wrong, 0 otherwise
+	 */
+	int shiftDR_stream(unsigned char *tdi, uint32_t len,
+		int end_state = RUN_TEST_IDLE, progress_cb_t progress = nullptr,
+		bool msb_first = false);
+	/*!
+	 * \brief same as above but data are provided, chunk by chunk,
+	 *        by a producer (for example to reverse bits on the fly)
+	 * \param[in] producer: chunk content provider
+	 * \param[in] len: number of bytes
+	 * \param[in] end_state: state after the last bit
+	 * \param[in] progress: called after each chunk (may be empty)
+	 * \return < 0 if something wrong, 0 otherwise
+	 */
+	int shiftDR_stream(producer_cb_t producer, uint32_t len,
+		int end_state = RUN_TEST_IDLE, progress_cb_t progress = nullptr);
+	int read_write(unsigned char *tdi, unsigned char *tdo, int len, char last,
+		bool msb_first = false);
 
 	void toggleClk(int nb);
+	/*!
+	 * \brief stay in current state at least min_us and min_clocks
+	 *        clock cycles (RUNTEST). Converter selects the cheapest
+	 *        way (clock cycles, probe or host delay)
+	 * \param[in] min_us: minimal delay (us)
+	 * \param[in] min_clocks: minimal number of clock cycles
+	 */
+	void waitUs(uint32_t min_us, uint32_t min_clocks = 0);
 	void go_test_logic_reset();
+	/*!
+	 * \brief move TAP state machine to newState using the shortest
+	 *        TMS sequence and transmit it to the interface
+	 * \param[in] newState: targeted TAP state
+	 */
 	void set_state(int newState);
 	int flushTMS(bool flush_buffer = false);
 	void flush() {flushTMS(); _jtag->flush();}
+
+	/*!
+	 * \brief start a scan queue: tdo buffers given to shiftIR/shiftDR
+	 *        are only valid after queue_flush() when the interface
+	 *        supports deferred read (immediately valid otherwise)
+	 * \return true if reads are deferred, false otherwise
+	 */
+	bool queue_begin() {
+		_deferred_read = _jtag->setDeferredRead(true);
+		return _deferred_read;
+	}
+	/*!
+	 * \brief send queued scans and fill all pending tdo buffers
+	 */
+	void queue_flush() { flush(); }
+	/*!
+	 * \brief flush queued scans and go back to immediate read mode
+	 */
+	void queue_end() {
+		flush();
+		_jtag->setDeferredRead(false);
+		_deferred_read = false;
+	}
 	void setTMS(unsigned char tms);
 
 	enum tapState_t {
@@ -107,24 +209,84 @@ class Jtag {
 		const std::string &serial,
 		const jtag_pins_conf_t *pin_conf, uint32_t clkHZ,
 		const std::string &firmware_path,
-		const bool invert_read_edge);
+		const bool invert_read_edge, const std::string &trace_file,
+		const std::string &sim_chain);
 	/*!
 	 * \brief search in fpga_list and misc_dev_list for a device with idcode
-	 *        if found insert idcode and irlength in _devices_list and
-	 *        _irlength_list
 	 * \param[in] idcode: device idcode
+	 * \param[out] irlength: device irlength
 	 * \return false if not found, true otherwise
 	 */
-	bool search_and_insert_device_with_idcode(uint32_t idcode);
+	bool search_idcode(uint32_t idcode, int16_t *irlength);
+	/*!
+	 * \brief load chain topology from cache file
+	 * \return false if no cache available
+	 */
+	bool load_chain_cache();
+	/*!
+	 * \brief write current chain topology to cache file
+	 */
+	void save_chain_cache();
+	/*!
+	 * \brief check current chain topology with only one IDCODE scan
+	 * \return true if all IDCODE match and no other device is present
+	 */
+	bool validate_chain();
+	/*!
+	 * \brief append TMS sequence required to reach newState into
+	 *        TMS buffer, without flushing it
+	 * \param[in] newState: targeted TAP state
+	 */
+	void moveToState(int newState);
+	/*!
+	 * \brief append up to 8 TMS bits (LSB first) into TMS buffer
+	 * \param[in] tms: TMS bits
+	 * \param[in] len: number of bits
+	 */
+	void appendTMS(uint8_t tms, uint8_t len);
+	/*!
+	 * \brief return chunk size (in byte) used by shiftDR_stream: a
+	 *        multiple of interface buffer size
+	 */
+	uint32_t stream_chunk_size();
+	/*!
+	 * \brief shift len bits surrounded by bypass padding (bits set to 1)
+	 *        in one transfer. tdo is realigned to the payload
+	 * \param[in] tdi: payload to send (may be NULL)
+	 * \param[out] tdo: payload read back (may be NULL)
+	 * \param[in] len: payload length (bits)
+	 * \param[in] before: padding bits sent before payload
+	 * \param[in] after: padding bits sent after payload
+	 * \param[in] last: set TMS high with the last bit
+	 * \param[in] msb_first: payload bit order (padding is then sent
+	 *            with dedicated scans)
+	 */
+	void shift_padded(unsigned char *tdi, unsigned char *tdo, int len,
+		int before, int after, bool last, bool msb_first = false);
+	/*!
+	 * \brief compute bypass padding for current selection
+	 */
+	void update_padding();
 	int8_t _verbose;
 	int _state;
 	int _tms_buffer_size;
 	int _num_tms;
 	unsigned char *_tms_buffer;
 	std::string _board_name;
+	std::string _cache_file; /*!< topology cache file for this cable */
 
 	int device_index; /*!< index for targeted FPGA */
 	std::vector<int32_t> _devices_list; /*!< ordered list of devices idcode */
 	std::vector<int16_t> _irlength_list; /*!< ordered list of irlength */
+
+	/* bypass padding for the selected device (see device_select) */
+	int _dr_bits_before; /*!< devices before the selected one in DR */
+	int _dr_bits_after; /*!< devices after the selected one in DR */
+	int _ir_bits_before; /*!< irlength sum of devices before in IR */
+	int _ir_bits_after; /*!< irlength sum of devices after in IR */
+	std::vector<uint8_t> _pad_ones; /*!< padding bits used when not fused */
+	std::vector<uint8_t> _pad_tx; /*!< fused padding + payload buffer */
+	std::vector<uint8_t> _pad_rx; /*!< fused padding + payload read back */
+	bool _deferred_read; /*!< scan queue with deferred tdo is active */
 };
 #endif
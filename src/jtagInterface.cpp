@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include "bitOps.hpp"
+#include "jtagInterface.hpp"
+#include "usbStats.hpp"
+
+/* bounce buffer size (in byte) for bit order conversion */
+#define MSB_BOUNCE_SIZE 1024
+
+int JtagInterface::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end,
+		bool msb_first)
+{
+	if (!msb_first)
+		return writeTDI(tx, rx, len, end);
+
+	uint8_t tx_buf[MSB_BOUNCE_SIZE];
+	uint32_t pos = 0;
+
+	while (pos < len) {
+		uint32_t xfer_len = len - pos;
+		if (xfer_len > 8 * MSB_BOUNCE_SIZE)
+			xfer_len = 8 * MSB_BOUNCE_SIZE;
+		uint32_t nb_byte = (xfer_len + 7) >> 3;
+		bool last = (pos + xfer_len == len);
+		uint8_t *rx_ptr = (rx) ? rx + (pos >> 3) : NULL;
+
+		if (tx)
+			reverseBytes(tx_buf, tx + (pos >> 3), nb_byte);
+		int ret = writeTDI((tx) ? tx_buf : NULL, rx_ptr, xfer_len,
+			end && last);
+		if (ret < 0)
+			return ret;
+
+		if (rx_ptr) {
+			/* deferred read: rx is only filled at flush time */
+			flush();
+			reverseBytes(rx_ptr, rx_ptr, nb_byte);
+		}
+		pos += xfer_len;
+	}
+
+	return len;
+}
+
+int JtagInterface::waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms)
+{
+	uint64_t clocks = (static_cast<uint64_t>(min_us) * getClkFreq()) / 1000000;
+	if (clocks < min_clocks)
+		clocks = min_clocks;
+	if (clocks == 0)
+		return 0;
+	return toggleClk(tms, 0, clocks);
+}
+
+int JtagInterface::sleepUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms)
+{
+	if (min_clocks > 0) {
+		int ret = toggleClk(tms, 0, min_clocks);
+		if (ret < 0)
+			return ret;
+	}
+	if (min_us > 0) {
+		if (flush() < 0)
+			return -1;
+		usleep(min_us);
+		UsbStats::sleep(min_us);
+	}
+	return 0;
+}
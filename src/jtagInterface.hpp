@@ -42,6 +42,22 @@ class JtagInterface {
 	 */
 	virtual int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) = 0;
 
+	/*!
+	 * \brief same as above with a bit order selection: when msb_first
+	 *        is set, each byte is sent (and received) starting with
+	 *        bit 7. A trailing partial byte uses its most significant
+	 *        bits. Default implementation reverses bits in a bounce
+	 *        buffer, converters with native support override it
+	 * \param tdi: array of TDI values (used to write)
+	 * \param tdo: array of TDO values (used when read)
+	 * \param len: number of bit to send/receive
+	 * \param end: see above
+	 * \param msb_first: bit order in each byte
+	 * \return number of bit written and/or read
+	 */
+	virtual int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end,
+		bool msb_first);
+
 	/*!
 	 * \brief toggle clk without touch of TDI/TMS
 	 * \param tms: state of tms signal
@@ -51,6 +67,19 @@ class JtagInterface {
 	 */
 	virtual int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) = 0;
 
+	/*!
+	 * \brief stay in current state (mainly RUN_TEST_IDLE) at least
+	 *        min_us microseconds and min_clocks clock cycles. Default
+	 *        implementation converts delay to clock cycles (kept in
+	 *        buffer with other commands), converters where clock cycles
+	 *        are costly may use a host or converter side delay
+	 * \param min_us: minimal delay (us)
+	 * \param min_clocks: minimal number of clock cycles
+	 * \param tms: state of tms signal
+	 * \return < 0 on error
+	 */
+	virtual int waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms);
+
 	/*!
 	 * \brief return internal buffer size (in byte)
 	 * \return internal buffer size
@@ -64,11 +93,28 @@ class JtagInterface {
 	virtual bool isFull() = 0;
 
 	/*!
-	 * \brief force internal flush buffer
+	 * \brief force internal flush buffer. Write only commands may be
+	 *        kept in buffer up to this call (or a read): required before
+	 *        a host side delay
 	 * \return 1 if success, 0 if nothing to write, -1 is something wrong
 	 */
 	virtual int flush() = 0;
+
+	/*!
+	 * \brief enable/disable deferred TDO read. When enabled, rx buffers
+	 *        given to writeTDI may only be filled by the next flush(), so
+	 *        many scans share one USB round trip
+	 * \param[in] enable: deferred read state
+	 * \return true if the converter defers reads, false otherwise
+	 */
+	virtual bool setDeferredRead(bool enable) { (void)enable; return false; }
  protected:
+	/*!
+	 * \brief waitUs implementation for converters with costly clock
+	 *        cycles: min_clocks cycles are sent, buffer is flushed then
+	 *        host sleeps min_us
+	 */
+	int sleepUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms);
 	uint32_t _clkHZ; /*!< current clk frequency */
 };
 #endif  // _JTAGINTERFACE_H_
@@ -0,0 +1,308 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "display.hpp"
+#include "jtagSim.hpp"
+#include "simDevices.hpp"
+
+/* ----------- */
+/* SimShiftReg */
+/* ----------- */
+
+void SimShiftReg::load(const uint8_t *data, uint32_t len)
+{
+	_len = len;
+	_head = 0;
+	_bits.assign((len + 7) / 8, 0);
+	if (data)
+		memcpy(_bits.data(), data, _bits.size());
+}
+
+void SimShiftReg::load_value(uint64_t val, uint32_t len)
+{
+	_len = len;
+	_head = 0;
+	_bits.assign((len + 7) / 8, 0);
+	for (size_t i = 0; i < _bits.size() && i < 8; i++)
+		_bits[i] = (val >> (8 * i)) & 0xff;
+}
+
+void SimShiftReg::get(uint8_t *data) const
+{
+	memset(data, 0, (_len + 7) / 8);
+	for (uint32_t i = 0; i < _len; i++) {
+		uint32_t pos = (_head + i) % _len;
+		if ((_bits[pos >> 3] >> (pos & 0x07)) & 0x01)
+			data[i >> 3] |= (1 << (i & 0x07));
+	}
+}
+
+uint64_t SimShiftReg::value() const
+{
+	uint64_t val = 0;
+	for (uint32_t i = 0; i < _len && i < 64; i++) {
+		uint32_t pos = (_head + i) % _len;
+		if ((_bits[pos >> 3] >> (pos & 0x07)) & 0x01)
+			val |= (1ULL << i);
+	}
+	return val;
+}
+
+/* --------- */
+/* SimDevice */
+/* --------- */
+
+SimDevice::SimDevice(uint32_t idcode, int irlen, int64_t idcode_instr):
+	_idcode(idcode), _irlen(irlen), _idcode_instr(idcode_instr),
+	_ir(0), _ir_sr(0), _idcode_sel(true)
+{
+	reset();
+}
+
+void SimDevice::reset()
+{
+	_ir = (_idcode_instr >= 0) ? static_cast<uint32_t>(_idcode_instr) :
+		static_cast<uint32_t>((1ULL << _irlen) - 1);
+	_idcode_sel = true;
+}
+
+void SimDevice::update_ir(uint32_t ir)
+{
+	_idcode_sel = (_idcode_instr >= 0 && ir == _idcode_instr);
+}
+
+void SimDevice::capture_dr()
+{
+	if (_idcode_sel)
+		_dr.load_value(_idcode, 32);
+	else
+		_dr.load_value(0, 1);  // BYPASS
+}
+
+/* ------- */
+/* JtagSim */
+/* ------- */
+
+/* next state: [state][tms] */
+static const uint8_t sim_next_state[16][2] = {
+	/* TEST_LOGIC_RESET */ { 1,  0},
+	/* RUN_TEST_IDLE    */ { 1,  2},
+	/* SELECT_DR_SCAN   */ { 3,  9},
+	/* CAPTURE_DR       */ { 4,  5},
+	/* SHIFT_DR         */ { 4,  5},
+	/* EXIT1_DR         */ { 6,  8},
+	/* PAUSE_DR         */ { 6,  7},
+	/* EXIT2_DR         */ { 4,  8},
+	/* UPDATE_DR        */ { 1,  2},
+	/* SELECT_IR_SCAN   */ {10,  0},
+	/* CAPTURE_IR       */ {11, 12},
+	/* SHIFT_IR         */ {11, 12},
+	/* EXIT1_IR         */ {13, 15},
+	/* PAUSE_IR         */ {13, 14},
+	/* EXIT2_IR         */ {11, 15},
+	/* UPDATE_IR        */ { 1,  2},
+};
+
+/* default idcodes for models */
+#define SIM_ARTIX7_IDCODE    0x0362D093  // XC7A35T
+#define SIM_ECP5_IDCODE      0x41111043  // LFE5U-25
+#define SIM_MACHXO2_IDCODE   0x012bd043  // LCMXO2-7000HC
+#define SIM_GW1N_IDCODE      0x0100481b  // GW1N(R)-9
+#define SIM_CYCLONE10_IDCODE 0x020f30dd  // 10CL025
+
+JtagSim::JtagSim(const std::string &chain, int8_t verbose):
+	_state(TEST_LOGIC_RESET), _nb_clk(0), _nb_flush(0), _verbose(verbose)
+{
+	_clkHZ = 6000000;
+
+	std::string desc;
+	std::istringstream ss(chain.empty() ? "artix7" : chain);
+	try {
+		while (std::getline(ss, desc, ','))
+			_devices.push_back(create_device(desc));
+	} catch (std::exception &e) {
+		for (SimDevice *dev : _devices)
+			delete dev;
+		throw;
+	}
+
+	if (_verbose > 0) {
+		for (size_t i = 0; i < _devices.size(); i++) {
+			char mess[128];
+			snprintf(mess, 128, "sim: device %zu %s idcode 0x%08x irlength %d",
+				i, _devices[i]->name().c_str(), _devices[i]->idcode(),
+				_devices[i]->irlength());
+			printInfo(mess);
+		}
+	}
+}
+
+JtagSim::~JtagSim()
+{
+	if (_verbose > 0) {
+		char mess[128];
+		snprintf(mess, 128, "sim: %llu TCK cycles, %u flush",
+			static_cast<unsigned long long>(_nb_clk), _nb_flush);
+		printInfo(mess);
+	}
+	for (SimDevice *dev : _devices)
+		delete dev;
+}
+
+SimDevice *JtagSim::create_device(const std::string &desc)
+{
+	std::string model = desc;
+	std::string arg;
+	size_t pos = desc.find(':');
+	if (pos != std::string::npos) {
+		model = desc.substr(0, pos);
+		arg = desc.substr(pos + 1);
+	}
+
+	try {
+		/* generic device: idcode:irlength */
+		if (model.compare(0, 2, "0x") == 0) {
+			uint32_t idcode = std::stoul(model, nullptr, 16);
+			int irlen = (arg.empty()) ? 0 : std::stoi(arg, nullptr, 0);
+			if (irlen >= 2 && irlen <= 32)
+				return new SimDevice(idcode, irlen);
+		} else {
+			uint32_t idcode = 0;
+			if (!arg.empty())
+				idcode = std::stoul(arg, nullptr, 0);
+			if (model == "artix7")
+				return new SimXilinx((idcode) ? idcode : SIM_ARTIX7_IDCODE);
+			if (model == "ecp5")
+				return new SimLattice((idcode) ? idcode : SIM_ECP5_IDCODE, true);
+			if (model == "machxo2")
+				return new SimLattice((idcode) ? idcode : SIM_MACHXO2_IDCODE,
+					false);
+			if (model == "gw1n")
+				return new SimGowin((idcode) ? idcode : SIM_GW1N_IDCODE);
+			if (model == "cyclone10")
+				return new SimAltera((idcode) ? idcode : SIM_CYCLONE10_IDCODE);
+		}
+	} catch (std::logic_error &e) {
+		/* stoul / stoi failure: reported below */
+	}
+
+	throw std::runtime_error("sim: invalid chain entry '" + desc +
+		"' (artix7, ecp5, machxo2, gw1n, cyclone10 [:idcode] or "
+		"0xidcode:irlength)");
+}
+
+int JtagSim::setClkFreq(uint32_t clkHZ)
+{
+	_clkHZ = clkHZ;
+	return clkHZ;
+}
+
+bool JtagSim::clock(bool tms, bool tdi)
+{
+	bool tdo = true;
+	size_t nb = _devices.size();
+
+	switch (_state) {
+	case SHIFT_DR:
+		tdo = tdi;
+		for (size_t i = 0; i < nb; i++)
+			tdo = _devices[i]->shift_dr(tdo);
+		break;
+	case SHIFT_IR:
+		tdo = tdi;
+		for (size_t i = 0; i < nb; i++)
+			tdo = _devices[i]->ir_shift(tdo);
+		break;
+	case RUN_TEST_IDLE:
+		if (!tms) {
+			for (size_t i = 0; i < nb; i++)
+				_devices[i]->idle(1);
+		}
+		break;
+	default:
+		break;
+	}
+
+	_nb_clk++;
+	sim_state_t next = static_cast<sim_state_t>(sim_next_state[_state][tms]);
+	if (next == _state)
+		return tdo;
+
+	if (_state == SHIFT_DR && next == EXIT1_DR) {
+		for (size_t i = 0; i < nb; i++)
+			_devices[i]->exit_shift_dr();
+	}
+
+	_state = next;
+	for (size_t i = 0; i < nb; i++) {
+		SimDevice *dev = _devices[i];
+		switch (next) {
+		case TEST_LOGIC_RESET: dev->reset(); break;
+		case CAPTURE_DR:       dev->capture_dr(); break;
+		case UPDATE_DR:        dev->update_dr(); break;
+		case CAPTURE_IR:       dev->ir_capture(); break;
+		case UPDATE_IR:        dev->ir_update(); break;
+		default: break;
+		}
+	}
+	return tdo;
+}
+
+int JtagSim::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
+{
+	(void)flush_buffer;
+	for (uint32_t i = 0; i < len; i++)
+		clock((tms[i >> 3] >> (i & 0x07)) & 0x01, false);
+	return len;
+}
+
+int JtagSim::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
+{
+	return writeTDI(tx, rx, len, end, false);
+}
+
+int JtagSim::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end,
+		bool msb_first)
+{
+	for (uint32_t i = 0; i < len; i++) {
+		uint8_t mask = (msb_first) ? (0x80 >> (i & 0x07)) : (1 << (i & 0x07));
+		bool tdi = (tx) ? (tx[i >> 3] & mask) != 0 : false;
+		bool tdo = clock(end && (i == len - 1), tdi);
+		if (rx) {
+			if (tdo)
+				rx[i >> 3] |= mask;
+			else
+				rx[i >> 3] &= ~mask;
+		}
+	}
+	return len;
+}
+
+int JtagSim::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
+{
+	uint8_t next = sim_next_state[_state][tms ? 1 : 0];
+	/* stable state with no shift: only idle time matters */
+	if (next == _state && _state != SHIFT_DR && _state != SHIFT_IR) {
+		if (_state == RUN_TEST_IDLE) {
+			for (SimDevice *dev : _devices)
+				dev->idle(clk_len);
+		}
+		_nb_clk += clk_len;
+		return clk_len;
+	}
+
+	for (uint32_t i = 0; i < clk_len; i++)
+		clock(tms != 0, tdi != 0);
+	return clk_len;
+}
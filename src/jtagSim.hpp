@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#ifndef SRC_JTAGSIM_HPP_
+#define SRC_JTAGSIM_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "jtagInterface.hpp"
+
+/*!
+ * \file jtagSim.hpp
+ * \class SimShiftReg
+ * \brief fixed length data register: bits are shifted in at the MSB
+ *        side and out at the LSB side (as seen from TDI/TDO)
+ */
+class SimShiftReg {
+ public:
+	SimShiftReg(): _len(0), _head(0) {}
+
+	/*!
+	 * \brief resize and load register content
+	 * \param[in] data: content (LSB first), may be NULL (all 0)
+	 * \param[in] len: register length (bits)
+	 */
+	void load(const uint8_t *data, uint32_t len);
+	/*!
+	 * \brief load a register up to 64 bits
+	 */
+	void load_value(uint64_t val, uint32_t len);
+	/*!
+	 * \brief shift one bit
+	 * \param[in] tdi: bit shifted in
+	 * \return bit shifted out
+	 */
+	bool shift(bool tdi)
+	{
+		if (_len == 0)
+			return tdi;
+		uint32_t pos = _head;
+		bool out = (_bits[pos >> 3] >> (pos & 0x07)) & 0x01;
+		if (tdi)
+			_bits[pos >> 3] |= (1 << (pos & 0x07));
+		else
+			_bits[pos >> 3] &= ~(1 << (pos & 0x07));
+		_head = (pos + 1 == _len) ? 0 : pos + 1;
+		return out;
+	}
+	/*!
+	 * \brief copy register content (LSB first)
+	 * \param[out] data: (len + 7) / 8 bytes
+	 */
+	void get(uint8_t *data) const;
+	/*!
+	 * \brief register content, limited to 64 bits
+	 */
+	uint64_t value() const;
+	uint32_t length() const { return _len; }
+
+ private:
+	std::vector<uint8_t> _bits; /*!< content */
+	uint32_t _len;              /*!< length (bits) */
+	uint32_t _head;             /*!< position of register LSB */
+};
+
+/*!
+ * \class SimDevice
+ * \brief a TAP in the simulated chain. Default behaviour is a device
+ *        with IDCODE and BYPASS registers only, vendor models override
+ *        the TAP hooks
+ */
+class SimDevice {
+ public:
+	/*!
+	 * \param[in] idcode: device IDCODE
+	 * \param[in] irlen: instruction register length (max 32)
+	 * \param[in] idcode_instr: IDCODE instruction, -1 when only
+	 *            selected by TEST_LOGIC_RESET
+	 */
+	SimDevice(uint32_t idcode, int irlen, int64_t idcode_instr = -1);
+	virtual ~SimDevice() {}
+
+	uint32_t idcode() const { return _idcode; }
+	int irlength() const { return _irlen; }
+	virtual std::string name() const { return "generic"; }
+
+	/* TAP hooks */
+	/*!
+	 * \brief TEST_LOGIC_RESET reached: IDCODE (or BYPASS) selected
+	 */
+	virtual void reset();
+	/*!
+	 * \brief value loaded in IR at CAPTURE_IR (bit 0 must be 1 and bit 1
+	 *        0 for chain detection)
+	 */
+	virtual uint32_t capture_ir() { return 0x01; }
+	/*!
+	 * \brief UPDATE_IR: new instruction
+	 */
+	virtual void update_ir(uint32_t ir);
+	/*!
+	 * \brief CAPTURE_DR: load data register selected by instruction
+	 */
+	virtual void capture_dr();
+	/*!
+	 * \brief one clock in SHIFT_DR
+	 * \return TDO (value before clock edge)
+	 */
+	virtual bool shift_dr(bool tdi) { return _dr.shift(tdi); }
+	/*!
+	 * \brief SHIFT_DR left (bridges release chip select)
+	 */
+	virtual void exit_shift_dr() {}
+	/*!
+	 * \brief UPDATE_DR: data register content is applied
+	 */
+	virtual void update_dr() {}
+	/*!
+	 * \brief clock cycles spent in RUN_TEST_IDLE
+	 */
+	virtual void idle(uint64_t nb_clk) { (void)nb_clk; }
+
+	/* IR shift register, handled for all models */
+	void ir_capture() { _ir_sr = capture_ir(); }
+	bool ir_shift(bool tdi)
+	{
+		bool out = _ir_sr & 0x01;
+		_ir_sr = (_ir_sr >> 1) | (static_cast<uint32_t>(tdi) << (_irlen - 1));
+		return out;
+	}
+	void ir_update() { _ir = _ir_sr; update_ir(_ir); }
+
+ protected:
+	uint32_t _idcode;      /*!< device IDCODE */
+	int _irlen;            /*!< instruction register length */
+	int64_t _idcode_instr; /*!< IDCODE instruction */
+	uint32_t _ir;          /*!< current instruction */
+	uint32_t _ir_sr;       /*!< IR shift register */
+	bool _idcode_sel;      /*!< IDCODE register selected */
+	SimShiftReg _dr;       /*!< current data register */
+};
+
+/*!
+ * \class JtagSim
+ * \brief software converter: an IEEE 1149.1 TAP state machine driving
+ *        a chain of simulated devices. Used to measure host side
+ *        overhead and to test drivers without hardware
+ */
+class JtagSim : public JtagInterface {
+ public:
+	/*!
+	 * \brief build simulated chain
+	 * \param[in] chain: comma separated list of devices, index 0 is
+	 *            the device nearest TDI. Each entry is a model name
+	 *            (optionally followed by :idcode) or idcode:irlength
+	 *            for a generic device. Empty: one artix7
+	 * \param[in] verbose: verbose level
+	 */
+	JtagSim(const std::string &chain, int8_t verbose);
+	~JtagSim();
+
+	int setClkFreq(uint32_t clkHZ) override;
+
+	int writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer) override;
+	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) override;
+	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end,
+		bool msb_first) override;
+	int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override;
+
+	int get_buffer_size() override { return 4096; }
+	bool isFull() override { return false; }
+	int flush() override { _nb_flush++; return 0; }
+	/* TDO is always available at once: deferred read is free */
+	bool setDeferredRead(bool enable) override { return enable; }
+
+ private:
+	enum sim_state_t {
+		TEST_LOGIC_RESET = 0, RUN_TEST_IDLE, SELECT_DR_SCAN,
+		CAPTURE_DR, SHIFT_DR, EXIT1_DR, PAUSE_DR, EXIT2_DR,
+		UPDATE_DR, SELECT_IR_SCAN, CAPTURE_IR, SHIFT_IR,
+		EXIT1_IR, PAUSE_IR, EXIT2_IR, UPDATE_IR
+	};
+	/*!
+	 * \brief one TCK cycle
+	 * \return TDO sampled on rising edge
+	 */
+	bool clock(bool tms, bool tdi);
+	SimDevice *create_device(const std::string &desc);
+
+	std::vector<SimDevice *> _devices; /*!< chain, index 0 near TDI */
+	sim_state_t _state;  /*!< TAP state (all devices) */
+	uint64_t _nb_clk;    /*!< TCK cycles */
+	uint32_t _nb_flush;  /*!< flush requests */
+	int8_t _verbose;
+};
+
+#endif  // SRC_JTAGSIM_HPP_
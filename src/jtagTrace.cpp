@@ -0,0 +1,453 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "display.hpp"
+#include "jtagTrace.hpp"
+
+/* record header: op, flags, len, timestamp, ret */
+#define TRACE_RECORD_HDR_SIZE (1 + 1 + 4 + 4 + 4)
+/* file header: magic, version, clock, buffer size */
+#define TRACE_FILE_HDR_SIZE (8 + 2 + 4 + 4)
+
+static void put_u16(std::vector<uint8_t> &buf, uint16_t val)
+{
+	buf.push_back(val & 0xff);
+	buf.push_back((val >> 8) & 0xff);
+}
+
+static void put_u32(std::vector<uint8_t> &buf, uint32_t val)
+{
+	for (int i = 0; i < 4; i++)
+		buf.push_back((val >> (8 * i)) & 0xff);
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) |
+		(static_cast<uint32_t>(buf[3]) << 24);
+}
+
+/* payload following a record header */
+static size_t payload_size(uint8_t op, uint8_t flags, uint32_t len)
+{
+	uint32_t nb_byte = (len + 7) / 8;
+	switch (op) {
+	case TRACE_TMS:
+		return nb_byte;
+	case TRACE_TDI:
+		return ((flags & TRACE_FLAG_TX) ? nb_byte : 0) +
+			((flags & TRACE_FLAG_RX) ? nb_byte : 0);
+	case TRACE_WAIT:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static const char *op_name(uint8_t op)
+{
+	switch (op) {
+	case TRACE_SETCLK: return "setClkFreq";
+	case TRACE_TMS:    return "writeTMS";
+	case TRACE_TDI:    return "writeTDI";
+	case TRACE_CLK:    return "toggleClk";
+	case TRACE_WAIT:   return "waitUs";
+	case TRACE_FLUSH:  return "flush";
+	case TRACE_DEFER:  return "setDeferredRead";
+	default:           return "unknown";
+	}
+}
+
+/* ------------ */
+/* JtagRecorder */
+/* ------------ */
+
+JtagRecorder::JtagRecorder(JtagInterface *jtag, const std::string &filename):
+	_jtag(jtag), _deferred_read(false),
+	_start(std::chrono::steady_clock::now())
+{
+	_fd = fopen(filename.c_str(), "wb");
+	if (!_fd)
+		throw std::runtime_error("fail to open trace file " + filename);
+
+	_clkHZ = _jtag->getClkFreq();
+
+	std::vector<uint8_t> hdr(TRACE_MAGIC, TRACE_MAGIC + 8);
+	put_u16(hdr, TRACE_VERSION);
+	put_u32(hdr, _clkHZ);
+	put_u32(hdr, static_cast<uint32_t>(_jtag->get_buffer_size()));
+	fwrite(hdr.data(), 1, hdr.size(), _fd);
+}
+
+JtagRecorder::~JtagRecorder()
+{
+	/* tdo still in converter: force read */
+	if (!_pending.empty())
+		_jtag->flush();
+	commit();
+	fclose(_fd);
+	delete _jtag;
+}
+
+size_t JtagRecorder::add_record(uint8_t op, uint8_t flags, uint32_t len,
+		int32_t ret, const uint8_t *payload, uint32_t payload_len)
+{
+	uint32_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - _start).count();
+
+	_staged.push_back(op);
+	_staged.push_back(flags);
+	put_u32(_staged, len);
+	put_u32(_staged, timestamp);
+	put_u32(_staged, static_cast<uint32_t>(ret));
+	size_t offset = _staged.size();
+	if (payload)
+		_staged.insert(_staged.end(), payload, payload + payload_len);
+	return offset;
+}
+
+void JtagRecorder::commit()
+{
+	for (auto &p : _pending)
+		memcpy(&_staged[p.offset], p.rx, p.len);
+	_pending.clear();
+	if (!_staged.empty())
+		fwrite(_staged.data(), 1, _staged.size(), _fd);
+	_staged.clear();
+}
+
+int JtagRecorder::setClkFreq(uint32_t clkHZ)
+{
+	int ret = _jtag->setClkFreq(clkHZ);
+	_clkHZ = _jtag->getClkFreq();
+	add_record(TRACE_SETCLK, 0, clkHZ, ret, NULL, 0);
+	if (_pending.empty())
+		commit();
+	return ret;
+}
+
+int JtagRecorder::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
+{
+	int ret = _jtag->writeTMS(tms, len, flush_buffer);
+	add_record(TRACE_TMS, (flush_buffer) ? TRACE_FLAG_END : 0, len, ret,
+		tms, (len + 7) / 8);
+	if (_pending.empty())
+		commit();
+	return ret;
+}
+
+int JtagRecorder::record_tdi(uint8_t *tx, uint8_t *rx, uint32_t len,
+		bool end, bool msb_first, int ret)
+{
+	uint32_t nb_byte = (len + 7) / 8;
+	uint8_t flags = ((end) ? TRACE_FLAG_END : 0) |
+		((tx) ? TRACE_FLAG_TX : 0) | ((rx) ? TRACE_FLAG_RX : 0) |
+		((msb_first) ? TRACE_FLAG_MSB : 0);
+
+	add_record(TRACE_TDI, flags, len, ret, tx, (tx) ? nb_byte : 0);
+	if (rx) {
+		size_t offset = _staged.size();
+		_staged.insert(_staged.end(), nb_byte, 0);
+		/* deferred: tdo is only valid after next flush */
+		if (_deferred_read)
+			_pending.push_back({offset, rx, nb_byte});
+		else
+			memcpy(&_staged[offset], rx, nb_byte);
+	}
+	if (_pending.empty())
+		commit();
+	return ret;
+}
+
+int JtagRecorder::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
+{
+	int ret = _jtag->writeTDI(tx, rx, len, end);
+	return record_tdi(tx, rx, len, end, false, ret);
+}
+
+int JtagRecorder::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end,
+		bool msb_first)
+{
+	int ret = _jtag->writeTDI(tx, rx, len, end, msb_first);
+	return record_tdi(tx, rx, len, end, msb_first, ret);
+}
+
+int JtagRecorder::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
+{
+	int ret = _jtag->toggleClk(tms, tdi, clk_len);
+	uint8_t flags = ((tms) ? TRACE_FLAG_TMS : 0) | ((tdi) ? TRACE_FLAG_TDI : 0);
+	add_record(TRACE_CLK, flags, clk_len, ret, NULL, 0);
+	if (_pending.empty())
+		commit();
+	return ret;
+}
+
+int JtagRecorder::waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms)
+{
+	int ret = _jtag->waitUs(min_us, min_clocks, tms);
+	std::vector<uint8_t> delay;
+	put_u32(delay, min_us);
+	add_record(TRACE_WAIT, (tms) ? TRACE_FLAG_TMS : 0, min_clocks, ret,
+		delay.data(), delay.size());
+	if (_pending.empty())
+		commit();
+	return ret;
+}
+
+int JtagRecorder::flush()
+{
+	int ret = _jtag->flush();
+	add_record(TRACE_FLUSH, 0, 0, ret, NULL, 0);
+	commit();
+	return ret;
+}
+
+bool JtagRecorder::setDeferredRead(bool enable)
+{
+	bool ret = _jtag->setDeferredRead(enable);
+	add_record(TRACE_DEFER, (enable) ? TRACE_FLAG_END : 0, 0, ret, NULL, 0);
+	/* disable: pending reads are resolved by the converter */
+	if (!ret || _pending.empty())
+		commit();
+	_deferred_read = ret;
+	return ret;
+}
+
+/* ---------- */
+/* JtagReplay */
+/* ---------- */
+
+JtagReplay::JtagReplay(const std::string &filename, int8_t verbose):
+	_pos(TRACE_FILE_HDR_SIZE), _nb_records(0), _nb_flush(0),
+	_nb_mismatch(0), _last_timestamp(0), _verbose(verbose)
+{
+	std::ifstream fd(filename, std::ios::binary);
+	if (!fd.is_open())
+		throw std::runtime_error("fail to open trace file " + filename);
+	_trace.assign(std::istreambuf_iterator<char>(fd),
+		std::istreambuf_iterator<char>());
+
+	if (_trace.size() < TRACE_FILE_HDR_SIZE ||
+			memcmp(_trace.data(), TRACE_MAGIC, 8) != 0)
+		throw std::runtime_error(filename + " is not a trace file");
+	uint16_t version = _trace[8] | (_trace[9] << 8);
+	if (version != TRACE_VERSION)
+		throw std::runtime_error("unsupported trace version " +
+			std::to_string(version));
+	_clkHZ = get_u32(&_trace[10]);
+	_buffer_size = static_cast<int>(get_u32(&_trace[14]));
+}
+
+JtagReplay::~JtagReplay()
+{
+	char mess[256];
+	snprintf(mess, sizeof(mess),
+		"replay: %u records (%u flush), %u mismatch, recorded duration %u us",
+		_nb_records, _nb_flush, _nb_mismatch, _last_timestamp);
+	printInfo(mess);
+	if (_pos != _trace.size())
+		printWarn("replay: trace not fully consumed");
+}
+
+JtagReplay::record_t JtagReplay::next(uint8_t op, uint32_t len)
+{
+	if (_pos + TRACE_RECORD_HDR_SIZE > _trace.size())
+		throw std::runtime_error(std::string("replay: end of trace reached on ") +
+			op_name(op));
+
+	const uint8_t *ptr = &_trace[_pos];
+	record_t rec;
+	rec.op = ptr[0];
+	rec.flags = ptr[1];
+	rec.len = get_u32(ptr + 2);
+	rec.timestamp = get_u32(ptr + 6);
+	rec.ret = static_cast<int32_t>(get_u32(ptr + 10));
+	rec.payload = ptr + TRACE_RECORD_HDR_SIZE;
+
+	size_t payload_len = payload_size(rec.op, rec.flags, rec.len);
+	if (_pos + TRACE_RECORD_HDR_SIZE + payload_len > _trace.size())
+		throw std::runtime_error("replay: truncated trace");
+
+	if (rec.op != op || rec.len != len) {
+		char mess[256];
+		snprintf(mess, sizeof(mess),
+			"replay: record %u: %s(%u) recorded, %s(%u) requested",
+			_nb_records, op_name(rec.op), rec.len, op_name(op), len);
+		throw std::runtime_error(mess);
+	}
+
+	_pos += TRACE_RECORD_HDR_SIZE + payload_len;
+	_nb_records++;
+	_last_timestamp = rec.timestamp;
+	return rec;
+}
+
+void JtagReplay::check(const record_t &rec, const uint8_t *data,
+		const uint8_t *ref, uint32_t nb_bits)
+{
+	uint32_t nb_byte = nb_bits / 8;
+	bool match = (memcmp(data, ref, nb_byte) == 0);
+	if (match && (nb_bits & 0x07)) {
+		uint8_t mask = (1 << (nb_bits & 0x07)) - 1;
+		match = ((data[nb_byte] ^ ref[nb_byte]) & mask) == 0;
+	}
+	if (match)
+		return;
+
+	if (_nb_mismatch == 0 || _verbose > 0) {
+		char mess[128];
+		snprintf(mess, sizeof(mess), "replay: record %u: %s data mismatch",
+			_nb_records - 1, op_name(rec.op));
+		printWarn(mess);
+	}
+	_nb_mismatch++;
+}
+
+int JtagReplay::setClkFreq(uint32_t clkHZ)
+{
+	record_t rec = next(TRACE_SETCLK, clkHZ);
+	_clkHZ = clkHZ;
+	return rec.ret;
+}
+
+int JtagReplay::writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer)
+{
+	record_t rec = next(TRACE_TMS, len);
+	if (((rec.flags & TRACE_FLAG_END) != 0) != flush_buffer)
+		_nb_mismatch++;
+	check(rec, tms, rec.payload, len);
+	return rec.ret;
+}
+
+int JtagReplay::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
+{
+	return writeTDI(tx, rx, len, end, false);
+}
+
+int JtagReplay::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end,
+		bool msb_first)
+{
+	record_t rec = next(TRACE_TDI, len);
+	uint32_t nb_byte = (len + 7) / 8;
+	const uint8_t *payload = rec.payload;
+	uint8_t flags = ((end) ? TRACE_FLAG_END : 0) |
+		((tx) ? TRACE_FLAG_TX : 0) | ((rx) ? TRACE_FLAG_RX : 0) |
+		((msb_first) ? TRACE_FLAG_MSB : 0);
+
+	if (flags != rec.flags) {
+		char mess[128];
+		snprintf(mess, sizeof(mess), "replay: record %u: writeTDI flags mismatch",
+			_nb_records - 1);
+		printWarn(mess);
+		_nb_mismatch++;
+	}
+
+	if (rec.flags & TRACE_FLAG_TX) {
+		if (tx)
+			check(rec, tx, payload, len);
+		payload += nb_byte;
+	}
+	if (rx) {
+		if (rec.flags & TRACE_FLAG_RX)
+			memcpy(rx, payload, nb_byte);
+		else
+			memset(rx, 0, nb_byte);
+	}
+	return rec.ret;
+}
+
+int JtagReplay::toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len)
+{
+	(void)tms;
+	(void)tdi;
+	return next(TRACE_CLK, clk_len).ret;
+}
+
+int JtagReplay::waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms)
+{
+	(void)tms;
+	record_t rec = next(TRACE_WAIT, min_clocks);
+	if (get_u32(rec.payload) != min_us)
+		_nb_mismatch++;
+	return rec.ret;
+}
+
+int JtagReplay::flush()
+{
+	_nb_flush++;
+	return next(TRACE_FLUSH, 0).ret;
+}
+
+bool JtagReplay::setDeferredRead(bool enable)
+{
+	(void)enable;
+	return next(TRACE_DEFER, 0).ret != 0;
+}
+
+/* ------------- */
+/* trace summary */
+/* ------------- */
+
+bool trace_summary(const std::string &filename, trace_summary_t &summary)
+{
+	summary = trace_summary_t();
+
+	std::ifstream fd(filename, std::ios::binary);
+	if (!fd.is_open())
+		return false;
+	std::vector<uint8_t> trace((std::istreambuf_iterator<char>(fd)),
+		std::istreambuf_iterator<char>());
+	if (trace.size() < TRACE_FILE_HDR_SIZE ||
+			memcmp(trace.data(), TRACE_MAGIC, 8) != 0)
+		return false;
+
+	bool deferred = false;
+	size_t pos = TRACE_FILE_HDR_SIZE;
+	while (pos + TRACE_RECORD_HDR_SIZE <= trace.size()) {
+		const uint8_t *ptr = &trace[pos];
+		uint8_t op = ptr[0];
+		uint8_t flags = ptr[1];
+		uint32_t len = get_u32(ptr + 2);
+		int32_t ret = static_cast<int32_t>(get_u32(ptr + 10));
+
+		summary.records++;
+		switch (op) {
+		case TRACE_TMS:
+			summary.tms_bits += len;
+			break;
+		case TRACE_TDI:
+			summary.tdi_bits += len;
+			if (flags & TRACE_FLAG_RX) {
+				summary.reads++;
+				/* converter answers at once: host waits */
+				if (!deferred)
+					summary.round_trips++;
+			}
+			break;
+		case TRACE_FLUSH:
+			summary.flush++;
+			summary.round_trips++;
+			break;
+		case TRACE_DEFER:
+			deferred = (ret != 0) && (flags & TRACE_FLAG_END);
+			break;
+		default:
+			break;
+		}
+		pos += TRACE_RECORD_HDR_SIZE + payload_size(op, flags, len);
+	}
+	return pos == trace.size();
+}
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#ifndef SRC_JTAGTRACE_HPP_
+#define SRC_JTAGTRACE_HPP_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "jtagInterface.hpp"
+
+/*!
+ * \file jtagTrace.hpp
+ * \class JtagRecorder
+ * \brief JtagInterface decorator: all accesses to the converter are
+ *        forwarded and logged (with TDO and host timestamp) in a binary
+ *        trace file
+ *
+ * trace format (little endian):
+ * - header: "OFLTRACE", version (u16), clock frequency (u32),
+ *   buffer size (i32)
+ * - records: op (u8), flags (u8), len (u32), timestamp in us (u32),
+ *   return value (i32), followed by op dependent payload:
+ *   - TRACE_TMS: tms bits
+ *   - TRACE_TDI: tdi bits (TRACE_FLAG_TX), tdo bits (TRACE_FLAG_RX)
+ *   - TRACE_WAIT: delay in us (u32)
+ */
+
+#define TRACE_MAGIC   "OFLTRACE"
+#define TRACE_VERSION 1
+
+enum trace_op_t {
+	TRACE_SETCLK = 0, /*!< len: requested frequency */
+	TRACE_TMS    = 1, /*!< len: number of bits */
+	TRACE_TDI    = 2, /*!< len: number of bits */
+	TRACE_CLK    = 3, /*!< len: number of clock cycles */
+	TRACE_WAIT   = 4, /*!< len: minimal number of clock cycles */
+	TRACE_FLUSH  = 5, /*!< no len */
+	TRACE_DEFER  = 6, /*!< no len */
+};
+
+enum trace_flags_t {
+	TRACE_FLAG_END  = (1 << 0), /*!< TDI: end, TMS: flush_buffer, DEFER: enable */
+	TRACE_FLAG_TX   = (1 << 1), /*!< TDI: tdi payload present */
+	TRACE_FLAG_RX   = (1 << 2), /*!< TDI: tdo payload present */
+	TRACE_FLAG_MSB  = (1 << 3), /*!< TDI: MSB first */
+	TRACE_FLAG_TMS  = (1 << 4), /*!< CLK/WAIT: tms state */
+	TRACE_FLAG_TDI  = (1 << 5), /*!< CLK: tdi state */
+};
+
+class JtagRecorder : public JtagInterface {
+ public:
+	/*!
+	 * \brief wrap a converter
+	 * \param[in] jtag: converter (owned by the recorder)
+	 * \param[in] filename: trace file
+	 */
+	JtagRecorder(JtagInterface *jtag, const std::string &filename);
+	~JtagRecorder();
+
+	int setClkFreq(uint32_t clkHZ) override;
+	uint32_t getClkFreq() override { return _jtag->getClkFreq(); }
+
+	int writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer) override;
+	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) override;
+	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end,
+		bool msb_first) override;
+	int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override;
+	int waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms) override;
+
+	int get_buffer_size() override { return _jtag->get_buffer_size(); }
+	bool isFull() override { return _jtag->isFull(); }
+	int flush() override;
+	bool setDeferredRead(bool enable) override;
+
+ private:
+	/*!
+	 * \brief append a record to staging buffer
+	 * \return offset of payload in staging buffer
+	 */
+	size_t add_record(uint8_t op, uint8_t flags, uint32_t len, int32_t ret,
+		const uint8_t *payload, uint32_t payload_len);
+	int record_tdi(uint8_t *tx, uint8_t *rx, uint32_t len, bool end,
+		bool msb_first, int ret);
+	/*!
+	 * \brief copy deferred tdo in staged records and write them
+	 */
+	void commit();
+
+	typedef struct {
+		size_t offset;   /*!< tdo offset in staging buffer */
+		uint8_t *rx;     /*!< tdo buffer given by the caller */
+		uint32_t len;    /*!< tdo size (bytes) */
+	} pending_rx_t;
+
+	JtagInterface *_jtag;            /*!< real converter */
+	FILE *_fd;                       /*!< trace file */
+	bool _deferred_read;             /*!< converter defers reads */
+	std::vector<uint8_t> _staged;    /*!< records not yet written */
+	std::vector<pending_rx_t> _pending; /*!< tdo resolved at flush */
+	std::chrono::steady_clock::time_point _start; /*!< trace origin */
+};
+
+/*!
+ * \class JtagReplay
+ * \brief converter replaying a trace produced by JtagRecorder: tdo is
+ *        provided by the trace and each access is compared to the
+ *        recorded one
+ */
+class JtagReplay : public JtagInterface {
+ public:
+	JtagReplay(const std::string &filename, int8_t verbose);
+	~JtagReplay();
+
+	int setClkFreq(uint32_t clkHZ) override;
+
+	int writeTMS(uint8_t *tms, uint32_t len, bool flush_buffer) override;
+	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end) override;
+	int writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end,
+		bool msb_first) override;
+	int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override;
+	int waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms) override;
+
+	int get_buffer_size() override { return _buffer_size; }
+	bool isFull() override { return false; }
+	int flush() override;
+	bool setDeferredRead(bool enable) override;
+
+ private:
+	typedef struct {
+		uint8_t op;
+		uint8_t flags;
+		uint32_t len;
+		uint32_t timestamp;
+		int32_t ret;
+		const uint8_t *payload;
+	} record_t;
+	/*!
+	 * \brief consume next record, throw if op or len doesn't match
+	 */
+	record_t next(uint8_t op, uint32_t len);
+	/*!
+	 * \brief compare data sent with recorded one
+	 */
+	void check(const record_t &rec, const uint8_t *data,
+		const uint8_t *ref, uint32_t nb_bits);
+
+	std::vector<uint8_t> _trace; /*!< full trace content */
+	size_t _pos;                 /*!< current read position */
+	uint32_t _nb_records;        /*!< records consumed */
+	uint32_t _nb_flush;          /*!< flush records consumed */
+	uint32_t _nb_mismatch;       /*!< data mismatches */
+	uint32_t _last_timestamp;    /*!< timestamp of last record */
+	int _buffer_size;            /*!< recorded buffer size */
+	int8_t _verbose;
+};
+
+/*!
+ * \brief trace content, for transfer count regression checks
+ */
+typedef struct {
+	uint32_t records;     /*!< all records */
+	uint32_t flush;       /*!< flush records */
+	uint32_t reads;       /*!< writeTDI records with tdo */
+	uint32_t round_trips; /*!< flushes and non deferred reads */
+	uint64_t tms_bits;    /*!< bits sent by writeTMS */
+	uint64_t tdi_bits;    /*!< bits shifted by writeTDI */
+} trace_summary_t;
+
+/*!
+ * \brief count records of a trace produced by JtagRecorder
+ * \param[in] filename: trace file
+ * \param[out] summary: counters
+ * \return false if the file can't be read or is truncated
+ */
+bool trace_summary(const std::string &filename, trace_summary_t &summary);
+
+#endif  // SRC_JTAGTRACE_HPP_
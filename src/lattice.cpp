@@ -10,8 +10,11 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #include "jtag.hpp"
 #include "lattice.hpp"
@@ -22,6 +25,7 @@
 #include "display.hpp"
 #include "part.hpp"
 #include "spiFlash.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -136,6 +140,13 @@ using namespace std;
 
 #define PUBKEY_LENGTH_BYTES				64			/* length of the public key (MachXO3D) in bytes */
 
+/* RUN_TEST_IDLE delay after commands: at least 2 TCK and 200us, never
+ * shorter than the historical 1000 TCK
+ */
+#define RUNTEST_US      200
+#define RUNTEST_TCK     2
+#define RUNTEST_OLD_TCK 1000
+
 Lattice::Lattice(Jtag *jtag, const string filename, const string &file_type,
 	Device::prog_type_t prg_type, std::string flash_sector, bool verify, int8_t verbose):
 		Device(jtag, filename, file_type, verify, verbose),
@@ -327,7 +338,7 @@ bool Lattice::program_mem()
 	/* LSC_INIT_ADDRESS */
 	wr_rd(0x46, NULL, 0, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 
 	uint8_t *data = _bit.getData();
 	int length = _bit.getLength()/8;
@@ -335,25 +346,10 @@ bool Lattice::program_mem()
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
 	_jtag->toggleClk(2);
 
-	uint8_t tmp[1024];
-	int size = 1024;
-	int next_state = Jtag::SHIFT_DR;
-
 	ProgressBar progress("Loading", length, 50, _quiet);
 
-	for (int i = 0; i < length; i += size) {
-		progress.display(i);
-
-		if (length < i + size) {
-			size = length-i;
-			next_state = Jtag::RUN_TEST_IDLE;
-		}
-
-		for (int ii = 0; ii < size; ii++)
-			tmp[ii] = ConfigBitstreamParser::reverseByte(data[i+ii]);
-
-		_jtag->shiftDR(tmp, NULL, size*8, next_state);
-	}
+	_jtag->shiftDR_stream(data, length, Jtag::RUN_TEST_IDLE,
+		[&progress](uint32_t done) { progress.display(done); }, true);
 
 	uint32_t status_mask;
 	if (_fpga_family == MACHXO3D_FAMILY)
@@ -448,7 +444,7 @@ bool Lattice::program_intFlash(JedParser& _jed)
 	/* LSC_INIT_ADDRESS */
 	wr_rd(0x46, NULL, 0, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 
 	/* flash CfgFlash */
 	if (false == flashProg(0, "data", cfg_data))
@@ -470,7 +466,7 @@ bool Lattice::program_intFlash(JedParser& _jed)
 	/* LSC_INIT_ADDRESS */
 	wr_rd(0x46, NULL, 0, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 
 	if ((eraseMode & FLASH_ERASE_FEATURE) != 0) {
 		/* write feature row */
@@ -707,7 +703,7 @@ bool Lattice::EnableISC(uint8_t flash_mode)
 	wr_rd(ISC_ENABLE, &flash_mode, 1, NULL, 0);
 
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 	if (!pollBusyFlag())
 		return false;
 	if (!checkStatus(REG_STATUS_ISC_EN, REG_STATUS_ISC_EN))
@@ -719,7 +715,7 @@ bool Lattice::DisableISC()
 {
 	wr_rd(ISC_DISABLE, NULL, 0, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 	if (!pollBusyFlag())
 		return false;
 	if (!checkStatus(0, REG_STATUS_ISC_EN))
@@ -732,7 +728,7 @@ bool Lattice::EnableCfgIf()
 	uint8_t tx_buf = 0x08;
 	wr_rd(0x74, &tx_buf, 1, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 	return pollBusyFlag();
 }
 
@@ -741,7 +737,7 @@ bool Lattice::DisableCfg()
 	uint8_t tx_buf, rx_buf;
 	wr_rd(0x26, &tx_buf, 1, &rx_buf, 1);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 	return true;
 }
 
@@ -772,7 +768,7 @@ bool Lattice::checkID()
 	uint8_t tx[4];
 	wr_rd(0xE2, tx, 4, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 
 	uint32_t reg = readStatusReg();
 	displayReadReg(reg);
@@ -783,7 +779,7 @@ bool Lattice::checkID()
 	tx[0] = 0x43;
 	wr_rd(0xE2, tx, 4, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 	reg = readStatusReg();
 	displayReadReg(reg);
 	printf("%08x\n", reg);
@@ -803,7 +799,7 @@ uint32_t Lattice::readStatusReg()
 	memset(tx, 0, 4);
 	wr_rd(READ_STATUS_REGISTER, tx, 4, rx, 4);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 	reg = rx[3] << 24 | rx[2] << 16 | rx[1] << 8 | rx[0];
 	return reg;
 }
@@ -1002,7 +998,7 @@ bool Lattice::pollBusyFlag(bool verbose)
 	do {
 		wr_rd(READ_BUSY_FLAG, NULL, 0, &rx, 1);
 		_jtag->set_state(Jtag::RUN_TEST_IDLE);
-		_jtag->toggleClk(1000);
+		runtest_wait();
 		if (verbose)
 			printf("pollBusyFlag :%02x\n", rx);
 		if (timeout == 100000000){
@@ -1023,6 +1019,7 @@ bool Lattice::flashEraseAll()
 
 bool Lattice::flashErase(uint32_t  mask)
 {
+	UsbStatsPhase phase(UsbStats::PHASE_ERASE);
 	if (_fpga_family == MACHXO3D_FAMILY) {
 		uint8_t tx[2] = {
 			(uint8_t)((mask >> 8) & 0xff),
@@ -1034,7 +1031,7 @@ bool Lattice::flashErase(uint32_t  mask)
 		wr_rd(FLASH_ERASE, tx, 1, NULL, 0);
 	}
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 
 	if (!pollBusyFlag())
 		return false;
@@ -1053,7 +1050,7 @@ bool Lattice::flashProg(uint32_t start_addr, const string &name, vector<string>
 		wr_rd(PROG_CFG_FLASH, (uint8_t *)data[line].c_str(),
 				16, NULL, 0);
 		_jtag->set_state(Jtag::RUN_TEST_IDLE);
-		_jtag->toggleClk(1000);
+		runtest_wait();
 		progress.display(line);
 		if (pollBusyFlag() == false)
 			return false;
@@ -1062,9 +1059,13 @@ bool Lattice::flashProg(uint32_t start_addr, const string &name, vector<string>
 	return true;
 }
 
+/* number of rows read before comparison */
+#define VERIFY_BATCH 32
+
 bool Lattice::Verify(std::vector<std::string> data, bool unlock, uint32_t flash_area)
 {
-	uint8_t tx_buf[16], rx_buf[16];
+	UsbStatsPhase phase(UsbStats::PHASE_VERIFY);
+	uint8_t tx_buf[16], rx_buf[VERIFY_BATCH][16];
 	if (unlock)
 		EnableISC(0x08);
 
@@ -1079,31 +1080,43 @@ bool Lattice::Verify(std::vector<std::string> data, bool unlock, uint32_t flash_
 	}
 
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 
 	tx_buf[0] = REG_CFG_FLASH;
 	_jtag->shiftIR(tx_buf, NULL, 8, Jtag::PAUSE_IR);
 
 	memset(tx_buf, 0, 16);
 	bool failure = false;
+	/* rows are read by batch: with an interface able to defer
+	 * reads, a batch costs only one round trip
+	 */
+	size_t batch = (_jtag->queue_begin()) ? VERIFY_BATCH : 1;
 	ProgressBar progress("Verifying", data.size(), 50, _quiet);
-	for (size_t line = 0;  line< data.size(); line++) {
-		_jtag->set_state(Jtag::RUN_TEST_IDLE);
-		_jtag->toggleClk(2);
-		_jtag->shiftDR(tx_buf, rx_buf, 16*8, Jtag::PAUSE_DR);
-		for (size_t i = 0; i < data[line].size(); i++) {
-			if (rx_buf[i] != (unsigned char)data[line][i]) {
-				printf("%3zu %3zu %02x -> %02x\n", line, i,
-						rx_buf[i], (unsigned char)data[line][i]);
-				failure = true;
-			}
+	for (size_t base = 0; base < data.size() && !failure; base += batch) {
+		size_t nb_rows = std::min(batch, data.size() - base);
+		for (size_t row = 0; row < nb_rows; row++) {
+			_jtag->set_state(Jtag::RUN_TEST_IDLE);
+			_jtag->toggleClk(2);
+			_jtag->shiftDR(tx_buf, rx_buf[row], 16*8, Jtag::PAUSE_DR);
 		}
-		if (failure) {
-			printf("Verify Failure\n");
-			break;
+		_jtag->queue_flush();
+		for (size_t row = 0; row < nb_rows; row++) {
+			size_t line = base + row;
+			for (size_t i = 0; i < data[line].size(); i++) {
+				if (rx_buf[row][i] != (unsigned char)data[line][i]) {
+					printf("%3zu %3zu %02x -> %02x\n", line, i,
+							rx_buf[row][i], (unsigned char)data[line][i]);
+					failure = true;
+				}
+			}
+			if (failure) {
+				printf("Verify Failure\n");
+				break;
+			}
+			progress.display(line);
 		}
-		progress.display(line);
 	}
+	_jtag->queue_end();
 	if (unlock)
 		DisableISC();
 
@@ -1132,7 +1145,7 @@ uint16_t Lattice::readFeabits()
 	uint8_t rx_buf[2];
 	wr_rd(READ_FEABITS, NULL, 0, rx_buf, 2);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 
 	return rx_buf[0] | (((uint16_t)rx_buf[1]) << 8);
 }
@@ -1144,7 +1157,7 @@ bool Lattice::writeFeaturesRow(uint64_t features, bool verify)
 		tx_buf[i] = ((features >> (i*8)) & 0x00ff);
 	wr_rd(PROG_FEATURE_ROW, tx_buf, 8, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 	if (!pollBusyFlag())
 		return false;
 	if (verify)
@@ -1159,7 +1172,7 @@ bool Lattice::writeFeabits(uint16_t feabits, bool verify)
 
 	wr_rd(PROG_FEABITS, tx_buf, 2, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 	if (!pollBusyFlag())
 		return false;
 	if (verify)
@@ -1171,7 +1184,7 @@ bool Lattice::writeProgramDone()
 {
 	wr_rd(PROG_DONE, NULL, 0, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 	if (!pollBusyFlag())
 		return false;
 	if (!checkStatus(REG_STATUS_DONE, REG_STATUS_DONE))
@@ -1183,7 +1196,7 @@ bool Lattice::loadConfiguration()
 {
 	wr_rd(REFRESH, NULL, 0, NULL, 0);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 	if (!pollBusyFlag())
 		return false;
 	if (!checkStatus(REG_STATUS_DONE, REG_STATUS_DONE))
@@ -1198,83 +1211,98 @@ bool Lattice::loadConfiguration()
 int Lattice::spi_put(uint8_t cmd, uint8_t *tx, uint8_t *rx, uint32_t len)
 {
 	int xfer_len = len + 1;
-	uint8_t jtx[xfer_len];
-	uint8_t jrx[xfer_len];
+	std::vector<uint8_t> jtx(xfer_len);
+	std::vector<uint8_t> jrx(xfer_len);
 
-	jtx[0] = LatticeBitParser::reverseByte(cmd);
+	jtx[0] = cmd;
 
-	if (tx) {
-		for (uint32_t i=0; i < len; i++)
-			jtx[i+1] = LatticeBitParser::reverseByte(tx[i]);
-	}
+	if (tx)
+		memcpy(jtx.data() + 1, tx, len);
 
 	/* send first already stored cmd,
 	 * in the same time store each byte
 	 * to next
 	 */
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
+	_jtag->shiftDR(jtx.data(), (rx == NULL)? NULL: jrx.data(), 8*xfer_len,
+		Jtag::RUN_TEST_IDLE, true);
 
-	if (rx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			rx[i] = LatticeBitParser::reverseByte(jrx[i+1]);
-	}
+	if (rx != NULL)
+		memcpy(rx, jrx.data() + 1, len);
 	return 0;
 }
 
-int Lattice::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
+void Lattice::runtest_wait()
 {
-	int xfer_len = len;
-	uint8_t jtx[xfer_len];
-	uint8_t jrx[xfer_len];
-
-	if (tx) {
-		for (uint32_t i=0; i < len; i++)
-			jtx[i] = LatticeBitParser::reverseByte(tx[i]);
-	}
+	uint64_t us = RUNTEST_US;
+	uint32_t freq = _jtag->getClkFreq();
+	if (freq != 0) {
+		uint64_t old_us = (static_cast<uint64_t>(RUNTEST_OLD_TCK) * 1000000 +
+			freq - 1) / freq;
+		if (old_us > us)
+			us = old_us;
+	}
+	_jtag->waitUs(static_cast<uint32_t>(us), RUNTEST_TCK);
+}
 
-	/* send first already stored cmd,
-	 * in the same time store each byte
-	 * to next
-	 */
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
+int Lattice::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+	/* bytes are sent MSB first: tx and rx are used as is */
+	_jtag->shiftDR(tx, rx, 8*len, Jtag::RUN_TEST_IDLE, true);
 
-	if (rx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			rx[i] = LatticeBitParser::reverseByte(jrx[i]);
-	}
 	return 0;
 }
 
+/* number of status reads queued before checking them */
+#define SPI_WAIT_BATCH 16
+
 int Lattice::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 		uint32_t timeout, bool verbose)
 {
-	uint8_t rx;
+	uint8_t rx[SPI_WAIT_BATCH];
 	uint8_t dummy[2];
-	uint8_t tmp;
-	uint8_t tx = LatticeBitParser::reverseByte(cmd);
+	uint8_t tmp = 0;
 	uint32_t count = 0;
+	bool done = false, match = false;
+	/* fail after timeout reads and timeout * SPI_WAIT_TRY_US: batched
+	 * reads are faster than one try, slow cables are slower
+	 */
+	auto deadline = std::chrono::steady_clock::now() +
+		std::chrono::microseconds(static_cast<uint64_t>(timeout) *
+		SPI_WAIT_TRY_US);
 
 	/* CS is low until state goes to EXIT1_IR
 	 * so manually move to state machine to stay is this
 	 * state as long as needed
 	 */
-	_jtag->shiftDR(&tx, NULL, 8, Jtag::SHIFT_DR);
+	_jtag->shiftDR(&cmd, NULL, 8, Jtag::SHIFT_DR, true);
+
+	/* when the interface defers reads, status is polled by batch
+	 * with one round trip per batch
+	 */
+	int batch = (_jtag->queue_begin()) ? SPI_WAIT_BATCH : 1;
 
 	do {
-		_jtag->shiftDR(dummy, &rx, 8, Jtag::SHIFT_DR);
-		tmp = (LatticeBitParser::reverseByte(rx));
-		count++;
-		if (count == timeout){
-			printf("timeout: %x %x %u\n", tmp, rx, count);
-			break;
+		for (int i = 0; i < batch; i++)
+			_jtag->shiftDR(dummy, &rx[i], 8, Jtag::SHIFT_DR, true);
+		_jtag->queue_flush();
+		for (int i = 0; i < batch && !match; i++) {
+			tmp = rx[i];
+			count++;
+			if (verbose) {
+				printf("%x %x %x %u\n", tmp, mask, cond, count);
+			}
+			match = ((tmp & mask) == cond);
 		}
-
-		if (verbose) {
-			printf("%x %x %x %u\n", tmp, mask, cond, count);
+		done = match;
+		if (!match && count >= timeout &&
+				std::chrono::steady_clock::now() >= deadline) {
+			printf("timeout: %x %u\n", tmp, count);
+			done = true;
 		}
-	} while ((tmp & mask) != cond);
-	_jtag->shiftDR(dummy, &rx, 8, Jtag::RUN_TEST_IDLE);
-	if (count == timeout) {
+	} while (!done);
+	_jtag->shiftDR(dummy, rx, 8, Jtag::RUN_TEST_IDLE);
+	_jtag->queue_end();
+	if (!match) {
 		printf("%x\n", tmp);
 		std::cout << "wait: Error" << std::endl;
 		return -ETIME;
@@ -1799,7 +1827,7 @@ bool Lattice::program_intFlash_MachXO3D(JedParser& _jed)
 			wr_rd(LSC_WRITE_ADDRESS, tx, 3, NULL, 0);
 		}
 		_jtag->set_state(Jtag::RUN_TEST_IDLE);
-		_jtag->toggleClk(1000);
+		runtest_wait();
 
 		/* flash CfgFlash */
 		if (false == flashProg(0, area_name, data))
@@ -1829,7 +1857,7 @@ bool Lattice::program_intFlash_MachXO3D(JedParser& _jed)
 		wr_rd(RESET_CFG_ADDR, tx, 2, NULL, 0);
 	}
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(1000);
+	runtest_wait();
 
 	/* ISC program done 0x5E */
 	printInfo("Write program Done: ", false);
@@ -90,6 +90,11 @@ class Lattice: public Device, SPIInterface {
 		bool EnableCfgIf();
 		bool DisableCfg();
 		bool pollBusyFlag(bool verbose = false);
+		/*!
+		 * \brief RUN_TEST_IDLE delay after a command: max of RUNTEST_US
+		 *        and RUNTEST_OLD_TCK clock cycles, at least RUNTEST_TCK
+		 */
+		void runtest_wait();
 		bool flashEraseAll();
 		bool flashErase(uint32_t mask);
 		bool flashProg(uint32_t start_addr, const std::string &name,
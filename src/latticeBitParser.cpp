@@ -18,6 +18,7 @@
 #include "part.hpp"
 
 #include "latticeBitParser.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -78,6 +79,7 @@ int LatticeBitParser::parseHeader()
 
 int LatticeBitParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	/* until 0xFFFFBDB3 0xFFFF */
 	if (parseHeader() < 0)
 		return EXIT_FAILURE;
@@ -3,10 +3,12 @@
  * Copyright (C) 2019 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
  */
 #include "cxxopts.hpp"
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string.h>
 #include <unistd.h>
@@ -29,6 +31,7 @@
 #include "part.hpp"
 #include "spiFlash.hpp"
 #include "rawParser.hpp"
+#include "usbStats.hpp"
 #include "xilinx.hpp"
 
 #define DEFAULT_FREQ 	6000000
@@ -67,22 +70,52 @@ struct arguments {
 	uint32_t protect_flash;
 	bool unprotect_flash;
 	string flash_sector;
+	bool skip_detect;
+	bool chain_cache;
+	string record_trace;
+	string replay_trace;
+	string sim_chain;
+	string stats_json;
+	int benchmark;
+	bool flash_diff;
 };
 
 int parse_opt(int argc, char **argv, struct arguments *args, jtag_pins_conf_t *pins_config);
 
 void displaySupported(const struct arguments &args);
 
+Device *create_device(Jtag *jtag, const struct arguments &args, int idcode,
+	const string &bit_file);
+
+int run(struct arguments &args, jtag_pins_conf_t &pins_config);
+
+int benchmark(const struct arguments &args,
+	const jtag_pins_conf_t &pins_config);
+
+/* write transfer statistics report at the end of a session */
+class StatsReport {
+ public:
+	explicit StatsReport(const struct arguments &args): _args(args) {}
+	~StatsReport()
+	{
+		if (_args.stats_json.empty())
+			return;
+		if (!UsbStats::write_json(_args.stats_json, _args.cable, _args.freq))
+			printError("Error: fail to write " + _args.stats_json);
+	}
+ private:
+	const struct arguments &_args;
+};
+
 int main(int argc, char **argv)
 {
-	cable_t cable;
-	target_board_t *board = NULL;
 	jtag_pins_conf_t pins_config = {0, 0, 0, 0};
 
 	/* command line args. */
 	struct arguments args = {0, false, false, false, 0, "", "", "-", "", -1,
 			0, false, "-", false, false, false, false, Device::PRG_NONE, false,
-			false, false, "", "", "", -1, 0, false, -1, 0, 0, 0, false, ""};
+			false, false, "", "", "", -1, 0, false, -1, 0, 0, 0, false, "",
+			false, false, "", "", "", "", 0, false};
 	/* parse arguments */
 	try {
 		if (parse_opt(argc, argv, &args, &pins_config))
@@ -97,6 +130,23 @@ int main(int argc, char **argv)
 		return EXIT_SUCCESS;
 	}
 
+	if (args.benchmark > 0)
+		return benchmark(args, pins_config);
+
+	return run(args, pins_config);
+}
+
+/* one complete session: cable open, chain detection and operations
+ * requested by the user
+ */
+int run(struct arguments &args, jtag_pins_conf_t &pins_config)
+{
+	cable_t cable;
+	target_board_t *board = NULL;
+	StatsReport stats_report(args);
+
+	SPIFlash::set_differential(args.flash_diff);
+
 	if (args.prg_type == Device::WR_SRAM)
 		cout << "write to ram" << endl;
 	if (args.prg_type == Device::WR_FLASH)
@@ -149,6 +199,19 @@ int main(int argc, char **argv)
 			args.freq = board->default_freq;
 	}
 
+	/* replay: recorded trace is used instead of a cable */
+	if (!args.replay_trace.empty()) {
+		if (!args.record_trace.empty()) {
+			printError("Error: record-trace and replay-trace are exclusive");
+			return EXIT_FAILURE;
+		}
+		args.cable = "replay";
+	}
+
+	/* simulated chain: software TAP instead of a cable */
+	if (!args.sim_chain.empty())
+		args.cable = "sim";
+
 	if (args.cable[0] == '-') { /* if no board and no cable */
 		if (args.verbose > 0)
 			cout << "No cable or board specified: using direct ft2232 interface" << endl;
@@ -206,6 +269,7 @@ int main(int argc, char **argv)
 			pins_config = board->spi_pins_config;
 
 		try {
+			UsbStatsPhase phase(UsbStats::PHASE_OPEN);
 			spi = new FtdiSpi(cable.config, pins_config, args.freq, args.verbose > 0);
 		} catch (std::exception &e) {
 			printError("Error: Failed to claim cable");
@@ -215,29 +279,32 @@ int main(int argc, char **argv)
 		int spi_ret = EXIT_SUCCESS;
 
 		if (board && board->manufacturer != "none") {
-			Device *target;
+			/* released before spi, on every path */
+			std::unique_ptr<Device> target;
 			if (board->manufacturer == "efinix") {
-				target = new Efinix(spi, args.bit_file, args.file_type,
+				target.reset(new Efinix(spi, args.bit_file, args.file_type,
 					board->reset_pin, board->done_pin, board->oe_pin,
-					args.verify, args.verbose);
+					args.verify, args.verbose));
 			} else if (board->manufacturer == "lattice") {
-				target = new Ice40(spi, args.bit_file, args.file_type,
+				target.reset(new Ice40(spi, args.bit_file, args.file_type,
 					args.prg_type,
-					board->reset_pin, board->done_pin, args.verify, args.verbose);
+					board->reset_pin, board->done_pin, args.verify, args.verbose));
 			} else if (board->manufacturer == "colognechip") {
-				target = new CologneChip(spi, args.bit_file, args.file_type, args.prg_type,
+				target.reset(new CologneChip(spi, args.bit_file, args.file_type, args.prg_type,
 					board->reset_pin, board->done_pin, DBUS6, board->oe_pin,
-					args.verify, args.verbose);
+					args.verify, args.verbose));
 			}
 			if (args.prg_type == Device::RD_FLASH) {
 				if (args.file_size == 0) {
 					printError("Error: 0 size for dump");
 				} else {
+					UsbStatsPhase phase(UsbStats::PHASE_READ);
 					target->dumpFlash(args.offset, args.file_size);
 				}
 			} else if ((args.prg_type == Device::WR_FLASH ||
 						args.prg_type == Device::WR_SRAM) ||
 						!args.bit_file.empty() || !args.file_type.empty()) {
+				UsbStatsPhase phase(UsbStats::PHASE_PROGRAM);
 				target->program(args.offset, args.unprotect_flash);
 			}
 			if (args.unprotect_flash && args.bit_file.empty())
@@ -253,50 +320,62 @@ int main(int argc, char **argv)
 				spi->gpio_clear(board->reset_pin, true);
 			}
 
-			SPIFlash flash((SPIInterface *)spi, args.unprotect_flash, args.verbose);
-			flash.display_status_reg();
+			/* flash (and its address mode guard) released before reset */
+			{
+				SPIFlash flash((SPIInterface *)spi, args.unprotect_flash, args.verbose);
+				SPIFlashAddrGuard addr_guard(flash);
+				flash.display_status_reg();
+
+				if (args.prg_type != Device::RD_FLASH &&
+						(!args.bit_file.empty() || !args.file_type.empty())) {
+					printInfo("Open file " + args.bit_file + " ", false);
+					try {
+						bit = new RawParser(args.bit_file, false);
+						printSuccess("DONE");
+					} catch (std::exception &e) {
+						printError("FAIL");
+						spi_ret = EXIT_FAILURE;
+					}
 
-			if (args.prg_type != Device::RD_FLASH &&
-					(!args.bit_file.empty() || !args.file_type.empty())) {
-				printInfo("Open file " + args.bit_file + " ", false);
-				try {
-					bit = new RawParser(args.bit_file, false);
-					printSuccess("DONE");
-				} catch (std::exception &e) {
-					printError("FAIL");
-					delete spi;
-					return EXIT_FAILURE;
+					if (bit) {
+						printInfo("Parse file ", false);
+						if (bit->parse() == EXIT_FAILURE) {
+							printError("FAIL");
+							spi_ret = EXIT_FAILURE;
+						} else {
+							printSuccess("DONE");
+
+							try {
+								flash.erase_and_prog(args.offset, bit->getData(),
+									bit->getLength()/8);
+							} catch (std::exception &e) {
+								printError("FAIL: " + string(e.what()));
+							}
+
+							if (args.verify)
+								flash.verify(args.offset, bit->getData(),
+									bit->getLength() / 8);
+						}
+
+						delete bit;
+					}
+				} else if (args.prg_type == Device::RD_FLASH) {
+					flash.dump(args.bit_file, args.offset, args.file_size);
 				}
 
-				printInfo("Parse file ", false);
-				if (bit->parse() == EXIT_FAILURE) {
-					printError("FAIL");
-					delete spi;
-					return EXIT_FAILURE;
-				} else {
-					printSuccess("DONE");
+				if (spi_ret == EXIT_SUCCESS) {
+					if (args.unprotect_flash && args.bit_file.empty())
+						if (!flash.disable_protection())
+							spi_ret = EXIT_FAILURE;
+					if (args.protect_flash)
+						if (!flash.enable_protection(args.protect_flash))
+							spi_ret = EXIT_FAILURE;
 				}
 
-				try {
-					flash.erase_and_prog(args.offset, bit->getData(), bit->getLength()/8);
-				} catch (std::exception &e) {
-					printError("FAIL: " + string(e.what()));
-				}
-
-				if (args.verify)
-					flash.verify(args.offset, bit->getData(), bit->getLength() / 8);
-
-				delete bit;
-			} else if (args.prg_type == Device::RD_FLASH) {
-				flash.dump(args.bit_file, args.offset, args.file_size);
-			}
-
-			if (args.unprotect_flash && args.bit_file.empty())
-				if (!flash.disable_protection())
-					spi_ret = EXIT_FAILURE;
-			if (args.protect_flash)
-				if (!flash.enable_protection(args.protect_flash))
+				/* explicit call to report failure: the guard is then a no-op */
+				if (flash.restore_addr_mode() != 0)
 					spi_ret = EXIT_FAILURE;
+			}
 
 			if (board->reset_pin)
 				spi->gpio_set(board->reset_pin, true);
@@ -312,7 +391,7 @@ int main(int argc, char **argv)
 	/* ------------------- */
 	if (args.dfu || (board && board->mode == COMM_DFU)) {
 		/* try to init DFU probe */
-		DFU *dfu = NULL;
+		std::unique_ptr<DFU> dfu;
 		uint16_t vid = 0, pid = 0;
 		int altsetting = -1;
 		if (board) {
@@ -338,7 +417,7 @@ int main(int argc, char **argv)
 		}
 
 		try {
-			dfu = new DFU(args.bit_file, vid, pid, altsetting, args.verbose);
+			dfu.reset(new DFU(args.bit_file, vid, pid, altsetting, args.verbose));
 		} catch (std::exception &e) {
 			printError("DFU init failed with: " + string(e.what()));
 			return EXIT_FAILURE;
@@ -367,11 +446,27 @@ int main(int argc, char **argv)
 	if (args.prg_type == Device::PRG_NONE)
 		args.prg_type = Device::WR_SRAM;
 
+	/* chain detection mode: full scan by default, cached topology
+	 * (validated, then updated) only on request
+	 */
+	int detect_mode = Jtag::DETECT_FULL;
+	if (args.skip_detect)
+		detect_mode = Jtag::DETECT_NONE;
+	else if (args.chain_cache && !args.detect)
+		detect_mode = Jtag::DETECT_CACHE;
+
+	/* trace must not depend on local chain cache */
+	string trace_file = args.record_trace;
+	if (!args.replay_trace.empty())
+		trace_file = args.replay_trace;
+	if (!trace_file.empty() || cable.type == MODE_SIM)
+		detect_mode = Jtag::DETECT_FULL;
+
 	Jtag *jtag;
 	try {
 		jtag = new Jtag(cable, &pins_config, args.device, args.ftdi_serial,
 				args.freq, args.verbose, args.invert_read_edge,
-				args.probe_firmware);
+				args.probe_firmware, detect_mode, trace_file, args.sim_chain);
 	} catch (std::exception &e) {
 		printError("JTAG init failed with: " + string(e.what()));
 		return EXIT_FAILURE;
@@ -404,6 +499,9 @@ int main(int argc, char **argv)
 				t,
 				misc_dev_list[t].name.c_str(),
 				misc_dev_list[t].irlength);
+			} else {
+				printf("\tidcode   0x%x\n\ttype     unknown\n\tirlength %d\n",
+				t, jtag->get_irlength_list()[i]);
 			}
 		}
 		if (args.detect == true) {
@@ -455,45 +553,23 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
-	string fab = fpga_list[idcode].manufacturer;
-
 	Device *fpga;
 	try {
-		if (fab == "xilinx") {
-			fpga = new Xilinx(jtag, args.bit_file, args.file_type,
-				args.prg_type, args.fpga_part, args.verify, args.verbose);
-		} else if (fab == "altera") {
-			fpga = new Altera(jtag, args.bit_file, args.file_type,
-				args.prg_type, args.fpga_part, args.verify, args.verbose);
-		} else if (fab == "anlogic") {
-			fpga = new Anlogic(jtag, args.bit_file, args.file_type,
-				args.prg_type, args.verify, args.verbose);
-		} else if (fab == "efinix") {
-			fpga = new Efinix(jtag, args.bit_file, args.file_type,
-				/*DBUS4 | DBUS7, DBUS5*/args.board, args.verify, args.verbose);
-		} else if (fab == "Gowin") {
-			fpga = new Gowin(jtag, args.bit_file, args.file_type,
-				args.prg_type, args.external_flash, args.verify, args.verbose);
-		} else if (fab == "lattice") {
-			fpga = new Lattice(jtag, args.bit_file, args.file_type,
-				args.prg_type, args.flash_sector, args.verify, args.verbose);
-		} else if (fab == "colognechip") {
-			fpga = new CologneChip(jtag, args.bit_file, args.file_type,
-				args.prg_type, args.board, args.cable, args.verify, args.verbose);
-		} else {
-			printError("Error: manufacturer " + fab + " not supported");
-			delete(jtag);
-			return EXIT_FAILURE;
-		}
+		fpga = create_device(jtag, args, idcode, args.bit_file);
 	} catch (std::exception &e) {
 		printError("Error: Failed to claim FPGA device: " + string(e.what()));
 		delete(jtag);
 		return EXIT_FAILURE;
 	}
+	if (!fpga) {
+		delete(jtag);
+		return EXIT_FAILURE;
+	}
 
 	if ((!args.bit_file.empty() || !args.file_type.empty())
 			&& args.prg_type != Device::RD_FLASH) {
 		try {
+			UsbStatsPhase phase(UsbStats::PHASE_PROGRAM);
 			fpga->program(args.offset, args.unprotect_flash);
 		} catch (std::exception &e) {
 			printError("Error: Failed to program FPGA: " + string(e.what()));
@@ -517,15 +593,130 @@ int main(int argc, char **argv)
 		if (args.file_size == 0) {
 			printError("Error: 0 size for dump");
 		} else {
+			UsbStatsPhase phase(UsbStats::PHASE_READ);
 			fpga->dumpFlash(args.offset, args.file_size);
 		}
 	}
 
-	if (args.reset)
+	if (args.reset) {
+		UsbStatsPhase phase(UsbStats::PHASE_RESET);
 		fpga->reset();
+	}
 
 	delete(fpga);
 	delete(jtag);
+
+	return EXIT_SUCCESS;
+}
+
+/* run the session args.benchmark times and display min / median / max
+ * time and USB throughput for each phase
+ */
+int benchmark(const struct arguments &args,
+	const jtag_pins_conf_t &pins_config)
+{
+	vector<vector<UsbStats::counters_t>> runs;
+
+	/* a cached chain would turn every run after the first one into a
+	 * warm run: all runs scan it
+	 */
+	if (args.chain_cache)
+		printWarn("benchmark: --chain-cache ignored");
+
+	for (int i = 0; i < args.benchmark; i++) {
+		/* each run starts from the command line arguments, report
+		 * written once for all runs
+		 */
+		struct arguments run_args = args;
+		run_args.chain_cache = false;
+		run_args.stats_json = "";
+		jtag_pins_conf_t run_pins = pins_config;
+
+		UsbStats::reset();
+		int ret = run(run_args, run_pins);
+		if (ret != EXIT_SUCCESS) {
+			printError("benchmark: run " + std::to_string(i + 1) + " failed");
+			return ret;
+		}
+
+		vector<UsbStats::counters_t> counters;
+		for (int phase = 0; phase < UsbStats::PHASE_MAX; phase++)
+			counters.push_back(UsbStats::get(
+				static_cast<UsbStats::phase_t>(phase)));
+		runs.push_back(counters);
+	}
+
+	if (!args.stats_json.empty() &&
+			!UsbStats::write_json(args.stats_json, args.cable, args.freq, runs))
+		printError("Error: fail to write " + args.stats_json);
+
+	printf("\nbenchmark: %d run(s)\n", args.benchmark);
+	printf("%-8s %12s %12s %12s %12s %12s\n", "phase", "min (ms)",
+		"median (ms)", "max (ms)", "USB bytes", "USB KB/s");
+
+	double total_ms = 0;
+	for (int phase = 0; phase < UsbStats::PHASE_MAX; phase++) {
+		vector<uint64_t> elapsed;
+		uint64_t bytes = 0;
+		for (auto &counters : runs) {
+			const UsbStats::counters_t &c = counters[phase];
+			elapsed.push_back(c.elapsed_ns);
+			bytes += c.wr_bytes + c.rd_bytes;
+		}
+		bytes /= runs.size();
+		std::sort(elapsed.begin(), elapsed.end());
+		/* skip phases not used by this flow */
+		if (elapsed.back() < 1000 && bytes == 0)
+			continue;
+
+		double median = elapsed[elapsed.size() / 2] / 1e6;
+		total_ms += median;
+		char rate[16] = "-";
+		if (bytes != 0 && median > 0)
+			snprintf(rate, sizeof(rate), "%.1f", bytes / median);
+		printf("%-8s %12.3f %12.3f %12.3f %12llu %12s\n",
+			UsbStats::phase_name(static_cast<UsbStats::phase_t>(phase)),
+			elapsed.front() / 1e6, median, elapsed.back() / 1e6,
+			static_cast<unsigned long long>(bytes), rate);
+	}
+	printf("%-8s %12s %12.3f\n", "total", "", total_ms);
+
+	return EXIT_SUCCESS;
+}
+
+/* create device instance for manufacturer of idcode
+ * return NULL if manufacturer is not supported
+ */
+Device *create_device(Jtag *jtag, const struct arguments &args, int idcode,
+	const string &bit_file)
+{
+	string fab = fpga_list[idcode].manufacturer;
+
+	if (fab == "xilinx") {
+		return new Xilinx(jtag, bit_file, args.file_type,
+			args.prg_type, args.fpga_part, args.verify, args.verbose);
+	} else if (fab == "altera") {
+		return new Altera(jtag, bit_file, args.file_type,
+			args.prg_type, args.fpga_part, args.verify, args.verbose);
+	} else if (fab == "anlogic") {
+		return new Anlogic(jtag, bit_file, args.file_type,
+			args.prg_type, args.verify, args.verbose);
+	} else if (fab == "efinix") {
+		return new Efinix(jtag, bit_file, args.file_type,
+			/*DBUS4 | DBUS7, DBUS5*/args.board, args.verify, args.verbose);
+	} else if (fab == "Gowin") {
+		return new Gowin(jtag, bit_file, args.file_type,
+			args.prg_type, args.external_flash, args.verify, args.verbose);
+	} else if (fab == "lattice") {
+		return new Lattice(jtag, bit_file, args.file_type,
+			args.prg_type, args.flash_sector, args.verify, args.verbose);
+	} else if (fab == "colognechip") {
+		return new CologneChip(jtag, bit_file, args.file_type,
+			args.prg_type, args.board, args.cable, args.verify, args.verbose);
+	}
+
+	printError("Error: manufacturer " + fab + " not supported");
+	return NULL;
 }
 
 // parse double from string in engineering notation
@@ -576,11 +767,15 @@ int parse_opt(int argc, char **argv, struct arguments *args, jtag_pins_conf_t *p
 			.add_options()
 			("altsetting", "DFU interface altsetting (only for DFU mode)",
 				cxxopts::value<int16_t>(args->altsetting))
+			("benchmark", "time each phase (open, detect, parse, erase, program, verify, ...) over N runs",
+				cxxopts::value<int>(args->benchmark)->implicit_value("1"))
 			("bitstream", "bitstream",
 				cxxopts::value<std::string>(args->bit_file))
 			("b,board",     "board name, may be used instead of cable",
 				cxxopts::value<string>(args->board))
 			("c,cable", "jtag interface", cxxopts::value<string>(args->cable))
+			("chain-cache", "use (and update) a cached JTAG chain topology, validated by an IDCODE scan",
+				cxxopts::value<bool>(args->chain_cache))
 			("invert-read-edge", "JTAG mode / FTDI: read on negative edge instead of positive",
 				cxxopts::value<bool>(args->invert_read_edge))
 			("vid", "probe Vendor ID", cxxopts::value<uint16_t>(args->vid))
@@ -603,6 +798,8 @@ int parse_opt(int argc, char **argv, struct arguments *args, jtag_pins_conf_t *p
 				cxxopts::value<unsigned int>(args->file_size))
 			("file-type",   "provides file type instead of let's deduced by using extension",
 				cxxopts::value<string>(args->file_type))
+			("flash-diff", "only erase/write flash sectors differing from bitstream (flash is read first)",
+				cxxopts::value<bool>(args->flash_diff))
 			("flash-sector","flash sector (Lattice parts only)", cxxopts::value<string>(args->flash_sector))
 			("fpga-part",   "fpga model flavor + package", cxxopts::value<string>(args->fpga_part))
 			("freq",        "jtag frequency (Hz)", cxxopts::value<string>(freqo))
@@ -628,10 +825,21 @@ int parse_opt(int argc, char **argv, struct arguments *args, jtag_pins_conf_t *p
 				cxxopts::value<uint32_t>(args->protect_flash))
 			("quiet", "Produce quiet output (no progress bar)",
 				cxxopts::value<bool>(quiet))
+			("record-trace", "record all JTAG converter accesses in a trace file",
+				cxxopts::value<string>(args->record_trace))
+			("replay-trace", "use a recorded trace instead of a cable (no hardware)",
+				cxxopts::value<string>(args->replay_trace))
 			("r,reset",   "reset FPGA after operations",
 				cxxopts::value<bool>(args->reset))
+			("sim-chain", "simulated JTAG chain (cable sim): comma separated "
+				"artix7, ecp5, machxo2, gw1n, cyclone10 or idcode:irlength",
+				cxxopts::value<string>(args->sim_chain))
+			("skip-detect", "don't scan JTAG chain: use topology cached by --chain-cache",
+				cxxopts::value<bool>(args->skip_detect))
 			("spi",   "SPI mode (only for FTDI in serial mode)",
 				cxxopts::value<bool>(args->spi))
+			("stats-json", "write USB transfer statistics (per phase) to a JSON file (- for stdout)",
+				cxxopts::value<string>(args->stats_json))
 			("unprotect-flash",   "Unprotect flash blocks",
 				cxxopts::value<bool>(args->unprotect_flash))
 			("v,verbose", "Produce verbose output", cxxopts::value<bool>(verbose))
@@ -6,9 +6,11 @@
 #include <sstream>
 #include <string>
 
+#include "bitOps.hpp"
 #include "configBitstreamParser.hpp"
 #include "display.hpp"
 #include "mcsParser.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -41,6 +43,7 @@ McsParser::McsParser(const string &filename, bool reverseOrder, bool verbose):
 
 int McsParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	string str;
 	istringstream lineStream(_raw_data);
 
@@ -75,9 +78,13 @@ int McsParser::parse()
 			ptr = (char *)&str[DATA_BASE];
 			for (int i = 0; i < byteLen; i++, ptr += 2) {
 				sscanf(ptr, "%2hx", &tmp);
-				_bit_data[loc_addr + i] = (_reverseOrder)? reverseByte(tmp):tmp;
+				_bit_data[loc_addr + i] = tmp;
 				sum += tmp;
 			}
+			if (_reverseOrder) {
+				uint8_t *data = reinterpret_cast<uint8_t *>(&_bit_data[loc_addr]);
+				reverseBytes(data, data, byteLen);
+			}
 			_bit_length += (byteLen * 8);
 			break;
 		case 1:
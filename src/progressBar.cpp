@@ -14,7 +14,7 @@ ProgressBar::ProgressBar(std::string mess, int maxValue, int progressLen,
 		bool quiet): _mess(mess), _maxValue(maxValue),
 		_progressLen(progressLen), _quiet(quiet), _first(true)
 {
-	last_time = std::chrono::system_clock::now();
+	last_time = std::chrono::steady_clock::now();
 }
 void ProgressBar::display(int value, char force)
 {
@@ -26,8 +26,8 @@ void ProgressBar::display(int value, char force)
 		return;
 	}
 
-	std::chrono::time_point<std::chrono::system_clock> this_time;
-	this_time = std::chrono::system_clock::now();
+	std::chrono::time_point<std::chrono::steady_clock> this_time;
+	this_time = std::chrono::steady_clock::now();
 	std::chrono::duration<double> diff = this_time - last_time;
 
 	if (!force && diff.count() < 1)
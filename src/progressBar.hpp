@@ -20,7 +20,7 @@ class ProgressBar {
 		int _maxValue;
 		int _progressLen;
 		//records the time of last progress bar update
-		std::chrono::time_point<std::chrono::system_clock> last_time;
+		std::chrono::time_point<std::chrono::steady_clock> last_time;
 		bool _quiet;
 		bool _first;
 };
@@ -6,9 +6,11 @@
 #include <stdexcept>
 #include <utility>
 
+#include "bitOps.hpp"
 #include "configBitstreamParser.hpp"
 #include "display.hpp"
 #include "rawParser.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -19,14 +21,14 @@ RawParser::RawParser(const string &filename, bool reverseOrder):
 
 int RawParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	_bit_data.resize(_file_size);
 	std::move(_raw_data.begin(), _raw_data.end(), _bit_data.begin());
 	_bit_length = _bit_data.size();
 
 	if (_reverseOrder) {
-		for (int i = 0; i < _bit_length; i++) {
-			_bit_data[i] = reverseByte(_bit_data[i]);
-		}
+		uint8_t *data = reinterpret_cast<uint8_t *>(&_bit_data[0]);
+		reverseBytes(data, data, _bit_length);
 	}
 
 	/* convert size to bit */
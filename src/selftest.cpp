@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+/*
+ * Self checks (openFPGALoader-selftest, BUILD_TESTS=ON, run by ctest):
+ * complete flows against the simulated cable, so transfer counts and
+ * data paths are checked without hardware.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "board.hpp"
+#include "cable.hpp"
+#include "device.hpp"
+#include "display.hpp"
+#include "jtag.hpp"
+#include "jtagTrace.hpp"
+#include "lattice.hpp"
+
+using namespace std;
+
+static int nb_fail = 0;
+
+static void check(bool cond, const string &what)
+{
+	if (cond) {
+		printSuccess("PASS " + what);
+	} else {
+		printError("FAIL " + what);
+		nb_fail++;
+	}
+}
+
+/* unique file name in TMPDIR (or /tmp) */
+static string tmp_file(const string &name)
+{
+	const char *tmp = getenv("TMPDIR");
+	return string((tmp && tmp[0] != '\0') ? tmp : "/tmp") +
+		"/openFPGALoader-selftest-" + std::to_string(getpid()) + "-" + name;
+}
+
+/* simulated chain, full detection (never the chain cache) */
+static Jtag *sim_jtag(const string &chain, const string &trace_file)
+{
+	cable_t cable = cable_list["sim"];
+	jtag_pins_conf_t pins = {0, 0, 0, 0};
+	return new Jtag(cable, &pins, "", "", 6000000, 0, false, "",
+		Jtag::DETECT_FULL, trace_file, chain);
+}
+
+/* ----- */
+/* trace */
+/* ----- */
+
+/* chain scan of two devices: IDCODE/IR length detection must keep the
+ * same number of host/converter round trips
+ */
+#define DETECT_ROUND_TRIPS 4
+#define DETECT_READS       3
+
+static void check_trace()
+{
+	string trace = tmp_file("detect.trace");
+	size_t found = 0;
+	try {
+		Jtag *jtag = sim_jtag("artix7,artix7", trace);
+		found = jtag->get_devices_list().size();
+		delete jtag;
+	} catch (std::exception &e) {
+		printError(e.what());
+	}
+	check(found == 2, "trace: two devices detected");
+
+	trace_summary_t sum;
+	bool ok = trace_summary(trace, sum);
+	remove(trace.c_str());
+	check(ok, "trace: trace file complete");
+	printf("%u records, %u reads, %u flush, %u round trips\n", sum.records,
+		sum.reads, sum.flush, sum.round_trips);
+	check(sum.round_trips == DETECT_ROUND_TRIPS,
+		"trace: detect round trips == " + std::to_string(DETECT_ROUND_TRIPS));
+	check(sum.reads == DETECT_READS,
+		"trace: detect reads == " + std::to_string(DETECT_READS));
+}
+
+/* ----- */
+/* flash */
+/* ----- */
+
+/* ECP5 boot flash: erase/program/verify a bitstream image through the
+ * sysCONFIG SPI access, then dump it back with a new session
+ */
+#define FLASH_IMAGE_SIZE 0x30000
+
+static bool write_file(const string &filename, const vector<uint8_t> &data)
+{
+	FILE *fd = fopen(filename.c_str(), "wb");
+	if (!fd)
+		return false;
+	bool ret = fwrite(data.data(), 1, data.size(), fd) == data.size();
+	fclose(fd);
+	return ret;
+}
+
+static void check_flash()
+{
+	/* preamble: the simulated FPGA boots from this image at refresh */
+	vector<uint8_t> image(FLASH_IMAGE_SIZE);
+	image[0] = 0xff;
+	image[1] = 0xff;
+	image[2] = 0xbd;
+	image[3] = 0xb3;
+	srand(1);
+	for (size_t i = 4; i < image.size(); i++)
+		image[i] = rand() & 0xff;
+
+	string bin = tmp_file("image.bin");
+	string dump = tmp_file("dump.bin");
+	check(write_file(bin, image), "flash: image written");
+
+	bool programmed = false, dumped = false;
+	try {
+		Jtag *jtag = sim_jtag("ecp5", "");
+		jtag->device_select(0);
+		{
+			Lattice lattice(jtag, bin, "bin", Device::WR_FLASH, "", true, -1);
+			lattice.program(0, false);
+			programmed = true;
+		}
+		{
+			Lattice lattice(jtag, dump, "bin", Device::RD_FLASH, "", false, -1);
+			dumped = lattice.dumpFlash(0, FLASH_IMAGE_SIZE);
+		}
+		delete jtag;
+	} catch (std::exception &e) {
+		printError(e.what());
+	}
+	check(programmed, "flash: program, verify and refresh");
+	check(dumped, "flash: dump");
+
+	std::ifstream fd(dump, std::ios::binary);
+	vector<uint8_t> content((std::istreambuf_iterator<char>(fd)),
+		std::istreambuf_iterator<char>());
+	check(content == image, "flash: dump matches image");
+
+	remove(bin.c_str());
+	remove(dump.c_str());
+}
+
+int main(int argc, char **argv)
+{
+	string test = (argc > 1) ? argv[1] : "";
+
+	if (test.empty() || test == "trace")
+		check_trace();
+	if (test.empty() || test == "flash")
+		check_flash();
+
+	return (nb_fail == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
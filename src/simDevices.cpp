@@ -0,0 +1,935 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "configBitstreamParser.hpp"
+#include "simDevices.hpp"
+
+/* ----------- */
+/* SimSpiFlash */
+/* ----------- */
+
+#define SPI_WRSR      0x01
+#define SPI_PP        0x02
+#define SPI_READ      0x03
+#define SPI_WRDI      0x04
+#define SPI_RDSR      0x05
+#  define SPI_RDSR_WIP 0x01
+#  define SPI_RDSR_WEL 0x02
+#define SPI_WREN      0x06
+#define SPI_FAST_READ 0x0B
+#define SPI_4FAST_READ 0x0C
+#define SPI_4PP       0x12
+#define SPI_4READ     0x13
+#define SPI_SE        0x20
+#define SPI_4SE       0x21
+#define SPI_BE32      0x52
+#define SPI_RDSFDP    0x5A
+#define SPI_CE2       0x60
+#define SPI_RDID      0x9F
+#define SPI_EN4B      0xB7
+#define SPI_WREAR     0xC5
+#define SPI_RDEAR     0xC8
+#define SPI_CE        0xC7
+#define SPI_BE64      0xD8
+#define SPI_4BE64     0xDC
+#define SPI_EX4B      0xE9
+
+/* status reads with WIP set after an operation */
+#define SPI_BUSY_PROG  2
+#define SPI_BUSY_ERASE 8
+#define SPI_BUSY_CHIP  32
+
+SimSpiFlash::SimSpiFlash(uint32_t jedec_id, uint32_t size):
+	_mem(size, 0xff), _page(256, 0xff), _jedec_id(jedec_id), _status(0),
+	_busy(0), _selected(false), _in(0), _out(0xff), _nb_bit(0),
+	_nb_byte(0), _cmd(0), _arg(0), _addr(0), _addr4(false), _ear(0)
+{
+	/* SFDP: header, one parameter header and a 16 DWORDs JESD216B
+	 * Basic Flash Parameter Table at 0x10
+	 */
+	const uint32_t bfpt[16] = {
+		/* 4KB erase 0x20, 3 or 4-byte address above 16MB */
+		0x000020e5 | ((size > 0x1000000) ? (1u << 17) : 0u),
+		size * 8 - 1,
+		0, 0, 0, 0, 0,
+		/* erase types: 4KB 0x20, 32KB 0x52, 64KB 0xD8 */
+		0x520f200c, 0x0000d810,
+		/* erase max = 4 x typ, typ 48ms, 128ms, 160ms */
+		(41 << 18) | (39 << 11) | (34 << 4) | 1,
+		/* chip erase typ 40s, page program typ 384us (max 6 x typ),
+		 * 256B pages
+		 */
+		(73 << 24) | (37 << 8) | (8 << 4) | 2,
+		0, 0, 0, 0,
+		/* EN4B, extended address register and 4-byte opcodes */
+		0x25u << 24};
+	const uint8_t hdr[16] = {'S', 'F', 'D', 'P', 0x06, 0x01, 0x00, 0xff,
+		0x00, 0x06, 0x01, 16, 0x10, 0x00, 0x00, 0xff};
+	_sfdp.assign(hdr, hdr + 16);
+	for (uint32_t dw : bfpt) {
+		for (int i = 0; i < 4; i++)
+			_sfdp.push_back((dw >> (8 * i)) & 0xff);
+	}
+}
+
+void SimSpiFlash::select()
+{
+	_selected = true;
+	_nb_bit = 0;
+	_nb_byte = 0;
+	_out = 0xff;
+	_cmd = 0;
+}
+
+void SimSpiFlash::deselect()
+{
+	if (!_selected)
+		return;
+	_selected = false;
+	_out = 0xff;
+
+	bool wel = (_status & SPI_RDSR_WEL) != 0;
+	uint32_t alen = addr_len();
+
+	switch (_cmd) {
+	case SPI_WREN:
+		if (_nb_byte == 1)
+			_status |= SPI_RDSR_WEL;
+		break;
+	case SPI_WRDI:
+		_status &= ~SPI_RDSR_WEL;
+		break;
+	case SPI_WRSR:
+		if (wel && _nb_byte >= 2) {
+			/* WIP and WEL are read only */
+			_status = _arg & ~(SPI_RDSR_WIP | SPI_RDSR_WEL);
+			_busy = SPI_BUSY_PROG;
+		}
+		break;
+	case SPI_EN4B:
+	case SPI_EX4B:
+		if (_nb_byte == 1)
+			_addr4 = (_cmd == SPI_EN4B);
+		break;
+	case SPI_WREAR:
+		if (wel && _nb_byte >= 2) {
+			_ear = _arg;
+			_status &= ~SPI_RDSR_WEL;
+		}
+		break;
+	case SPI_PP:
+	case SPI_4PP:
+		if (wel && _nb_byte > alen + 1) {
+			uint32_t base = _addr & ~0xff;
+			for (uint32_t i = 0; i < 256; i++)
+				_mem[(base + i) % _mem.size()] &= _page[i];
+			_status &= ~SPI_RDSR_WEL;
+			_busy = SPI_BUSY_PROG;
+		}
+		break;
+	case SPI_SE:
+	case SPI_4SE:
+		if (wel && _nb_byte >= alen + 1)
+			erase(_addr, 0x1000);
+		break;
+	case SPI_BE32:
+		if (wel && _nb_byte >= alen + 1)
+			erase(_addr, 0x8000);
+		break;
+	case SPI_BE64:
+	case SPI_4BE64:
+		if (wel && _nb_byte >= alen + 1)
+			erase(_addr, 0x10000);
+		break;
+	case SPI_CE:
+	case SPI_CE2:
+		if (wel && _nb_byte == 1) {
+			erase(0, _mem.size());
+			_busy = SPI_BUSY_CHIP;
+		}
+		break;
+	}
+}
+
+bool SimSpiFlash::contains(const uint8_t *pattern, uint32_t pattern_len,
+		uint32_t len) const
+{
+	len = std::min(len, static_cast<uint32_t>(_mem.size()));
+	return std::search(_mem.begin(), _mem.begin() + len, pattern,
+		pattern + pattern_len) != _mem.begin() + len;
+}
+
+void SimSpiFlash::rx_byte(uint8_t val)
+{
+	uint32_t n = _nb_byte;
+
+	if (n == 0) {
+		_cmd = val;
+		_addr = 0;
+		switch (val) {
+		case SPI_RDSR:
+			_out = read_status();
+			break;
+		case SPI_RDID:
+			_out = (_jedec_id >> 16) & 0xff;
+			break;
+		case SPI_RDEAR:
+			_out = _ear;
+			break;
+		case SPI_PP:
+		case SPI_4PP:
+			std::fill(_page.begin(), _page.end(), 0xff);
+			_out = 0xff;
+			break;
+		default:
+			_out = 0xff;
+		}
+		return;
+	}
+
+	switch (_cmd) {
+	case SPI_RDSR:
+		_out = read_status();
+		break;
+	case SPI_RDID:
+		_out = (n < 3) ? (_jedec_id >> (8 * (2 - n))) & 0xff : 0x00;
+		break;
+	case SPI_RDEAR:
+		_out = _ear;
+		break;
+	case SPI_RDSFDP:
+		if (n <= 3)
+			_addr = (_addr << 8) | val;
+		/* data after address and dummy byte */
+		if (n >= 4)
+			_out = (_addr < _sfdp.size()) ? _sfdp[_addr++] : 0xff;
+		break;
+	case SPI_WRSR:
+	case SPI_WREAR:
+		_arg = val;
+		break;
+	case SPI_READ:
+	case SPI_4READ:
+	case SPI_FAST_READ:
+	case SPI_4FAST_READ:
+	case SPI_PP:
+	case SPI_4PP:
+	case SPI_SE:
+	case SPI_4SE:
+	case SPI_BE32:
+	case SPI_BE64:
+	case SPI_4BE64: {
+		uint32_t alen = addr_len();
+		bool fast = (_cmd == SPI_FAST_READ || _cmd == SPI_4FAST_READ);
+		bool pp = (_cmd == SPI_PP || _cmd == SPI_4PP);
+		if (n <= alen)
+			_addr = (_addr << 8) | val;
+		/* 3-byte address: bits 31:24 from extended address register */
+		if (n == alen && alen == 3)
+			_addr |= static_cast<uint32_t>(_ear) << 24;
+		if (pp && n > alen)
+			_page[(_addr + n - alen - 1) & 0xff] &= val;
+		/* data starts after address (and dummy byte for fast read) */
+		if (!pp && ((!fast && n >= alen) || (fast && n >= alen + 1)))
+			_out = _mem[_addr++ % _mem.size()];
+		break;
+	}
+	default:
+		_out = 0xff;
+	}
+}
+
+uint32_t SimSpiFlash::addr_len() const
+{
+	switch (_cmd) {
+	case SPI_4READ:
+	case SPI_4FAST_READ:
+	case SPI_4PP:
+	case SPI_4SE:
+	case SPI_4BE64:
+		return 4;
+	default:
+		return (_addr4) ? 4 : 3;
+	}
+}
+
+uint8_t SimSpiFlash::read_status()
+{
+	uint8_t status = _status;
+	if (_busy) {
+		status |= SPI_RDSR_WIP;
+		_busy--;
+	}
+	return status;
+}
+
+void SimSpiFlash::erase(uint32_t addr, uint32_t size)
+{
+	uint32_t base = (addr % _mem.size()) & ~(size - 1);
+	std::fill(_mem.begin() + base, _mem.begin() + base + size, 0xff);
+	_status &= ~SPI_RDSR_WEL;
+	_busy = SPI_BUSY_ERASE;
+}
+
+/* flash used by models with a bridge: Winbond W25Q128 */
+#define SIM_FLASH_ID   0xef4018
+#define SIM_FLASH_SIZE (16 << 20)
+
+/* --------- */
+/* SimXilinx */
+/* --------- */
+
+#define XIL_USER1     0x02
+#define XIL_CFG_IN    0x05
+#define XIL_USERCODE  0x08
+#define XIL_IDCODE    0x09
+#define XIL_JPROGRAM  0x0B
+#define XIL_JSTART    0x0C
+/* IR capture: bit 4 init complete, bit 5 DONE */
+#define XIL_IR_INIT   (1 << 4)
+#define XIL_IR_DONE   (1 << 5)
+#define XIL_SYNC_WORD 0xAA995566
+/* startup sequence length (clock cycles) */
+#define XIL_STARTUP_CLK 12
+
+SimXilinx::SimXilinx(uint32_t idcode): SimDevice(idcode, 6, XIL_IDCODE),
+	_flash(SIM_FLASH_ID, SIM_FLASH_SIZE), _sync(0), _synced(false),
+	_startup(false), _startup_clk(0), _done(false), _bridge_sel(false),
+	_miso(true)
+{}
+
+uint32_t SimXilinx::capture_ir()
+{
+	return 0x01 | XIL_IR_INIT | ((_done) ? XIL_IR_DONE : 0);
+}
+
+void SimXilinx::update_ir(uint32_t ir)
+{
+	SimDevice::update_ir(ir);
+	switch (ir) {
+	case XIL_JPROGRAM:
+		_done = false;
+		_synced = false;
+		_sync = 0;
+		_startup = false;
+		break;
+	case XIL_JSTART:
+		_startup = true;
+		_startup_clk = 0;
+		break;
+	}
+}
+
+void SimXilinx::capture_dr()
+{
+	switch (_ir) {
+	case XIL_CFG_IN:
+		return;
+	case XIL_USERCODE:
+		_dr.load_value(0xffffffff, 32);
+		return;
+	case XIL_USER1:
+		/* bridge only present once a bitstream is loaded */
+		if (_done) {
+			_bridge_sel = true;
+			_miso = true;
+			_flash.select();
+			return;
+		}
+		break;
+	}
+	SimDevice::capture_dr();
+}
+
+bool SimXilinx::shift_dr(bool tdi)
+{
+	if (_ir == XIL_CFG_IN) {
+		_sync = (_sync << 1) | tdi;
+		if (_sync == XIL_SYNC_WORD)
+			_synced = true;
+		return false;
+	}
+	if (_bridge_sel) {
+		/* BSCAN register adds one cycle to MISO */
+		bool tdo = _miso;
+		_miso = _flash.miso();
+		_flash.clock(tdi);
+		return tdo;
+	}
+	return _dr.shift(tdi);
+}
+
+void SimXilinx::exit_shift_dr()
+{
+	if (_bridge_sel) {
+		_flash.deselect();
+		_bridge_sel = false;
+	}
+}
+
+void SimXilinx::idle(uint64_t nb_clk)
+{
+	if (!_startup || !_synced || _done)
+		return;
+	_startup_clk += nb_clk;
+	if (_startup_clk >= XIL_STARTUP_CLK)
+		_done = true;
+}
+
+/* ---------- */
+/* SimLattice */
+/* ---------- */
+
+#define LAT_ERASE          0x0E
+#  define LAT_ERASE_SRAM    (1 << 0)
+#  define LAT_ERASE_FEATURE (1 << 1)
+#  define LAT_ERASE_CFG     (1 << 2)
+#define LAT_ISC_DISABLE    0x26
+#define LAT_READ_STATUS    0x3C
+#  define LAT_STATUS_DONE   (1 << 8)
+#  define LAT_STATUS_ISC_EN (1 << 9)
+#  define LAT_STATUS_BUSY   (1 << 12)
+#define LAT_PROG_SPI       0x3A
+#  define LAT_SPI_KEY       0x68FE
+#define LAT_INIT_ADDR      0x46
+#define LAT_PROG_DONE      0x5E
+#define LAT_PROG_INCR_NV   0x70
+#define LAT_READ_INCR_NV   0x73
+#define LAT_ISC_ENABLE_X   0x74
+#define LAT_REFRESH        0x79
+#define LAT_BURST          0x7A
+#define LAT_USERCODE       0xC0
+#define LAT_ISC_ENABLE     0xC6
+#define LAT_IDCODE         0xE0
+#define LAT_PROG_FEATURE   0xE4
+#define LAT_READ_FEATURE   0xE7
+#define LAT_CHECK_BUSY     0xF0
+#define LAT_PROG_FEABITS   0xF8
+#define LAT_READ_FEABITS   0xFB
+#define LAT_ROW_SIZE       16
+#define LAT_PREAMBLE       0xFFFFBDB3
+/* flash area searched for a bitstream at refresh */
+#define LAT_BOOT_SEARCH    0x10000
+/* busy polls after an erase */
+#define LAT_BUSY_ERASE     4
+
+SimLattice::SimLattice(uint32_t idcode, bool ecp5):
+	SimDevice(idcode, 8, LAT_IDCODE), _flash(NULL), _row(0),
+	_features(0), _feabits(0), _isc_en(false), _prog_done(false),
+	_done(false), _busy(0), _sync(0), _synced(false), _spi_en(false),
+	_bridge_sel(false)
+{
+	if (ecp5)
+		_flash = new SimSpiFlash(SIM_FLASH_ID, SIM_FLASH_SIZE);
+}
+
+SimLattice::~SimLattice()
+{
+	delete _flash;
+}
+
+uint32_t SimLattice::status()
+{
+	uint32_t reg = 0;
+	/* DONE means programmed when configuration mode is enabled */
+	if ((_isc_en) ? _prog_done : _done)
+		reg |= LAT_STATUS_DONE;
+	if (_isc_en)
+		reg |= LAT_STATUS_ISC_EN;
+	if (_busy)
+		reg |= LAT_STATUS_BUSY;
+	return reg;
+}
+
+void SimLattice::update_ir(uint32_t ir)
+{
+	SimDevice::update_ir(ir);
+	if (ir != LAT_PROG_SPI)
+		_spi_en = false;
+
+	switch (ir) {
+	case LAT_ISC_DISABLE:
+		/* wake up with the bitstream received by burst */
+		if (_isc_en && _synced)
+			_done = true;
+		_isc_en = false;
+		_busy = 1;
+		break;
+	case LAT_INIT_ADDR:
+		_row = 0;
+		break;
+	case LAT_PROG_DONE:
+		if (_isc_en) {
+			_prog_done = true;
+			_busy = 1;
+		}
+		break;
+	case LAT_REFRESH: {
+		static const uint8_t preamble[4] = {0xff, 0xff, 0xbd, 0xb3};
+		_isc_en = false;
+		if (_flash)
+			_done = _flash->contains(preamble, 4, LAT_BOOT_SEARCH);
+		else
+			_done = _prog_done;
+		_busy = 2;
+		break;
+	}
+	case LAT_BURST:
+		_sync = 0;
+		_synced = false;
+		break;
+	}
+}
+
+void SimLattice::capture_dr()
+{
+	switch (_ir) {
+	case LAT_READ_STATUS:
+		_dr.load_value(status(), 32);
+		return;
+	case LAT_CHECK_BUSY:
+		_dr.load_value((_busy) ? 0x01 : 0x00, 8);
+		if (_busy)
+			_busy--;
+		return;
+	case LAT_USERCODE:
+		_dr.load_value(0x00000000, 32);
+		return;
+	case LAT_READ_INCR_NV: {
+		size_t off = _row++ * LAT_ROW_SIZE;
+		if (off + LAT_ROW_SIZE <= _rows.size())
+			_dr.load(&_rows[off], 8 * LAT_ROW_SIZE);
+		else
+			_dr.load(NULL, 8 * LAT_ROW_SIZE);
+		return;
+	}
+	case LAT_READ_FEATURE:
+		_dr.load_value(_features, 64);
+		return;
+	case LAT_READ_FEABITS:
+		_dr.load_value(_feabits, 16);
+		return;
+	case LAT_ISC_ENABLE:
+	case LAT_ISC_ENABLE_X:
+	case LAT_ERASE:
+		_dr.load_value(0, 8);
+		return;
+	case LAT_PROG_INCR_NV:
+		_dr.load(NULL, 8 * LAT_ROW_SIZE);
+		return;
+	case LAT_PROG_FEATURE:
+		_dr.load_value(0, 64);
+		return;
+	case LAT_PROG_FEABITS:
+		_dr.load_value(0, 16);
+		return;
+	case LAT_BURST:
+		return;
+	case LAT_PROG_SPI:
+		if (_flash && _spi_en) {
+			_bridge_sel = true;
+			_flash->select();
+		} else {
+			_dr.load_value(0, 16);
+		}
+		return;
+	}
+	SimDevice::capture_dr();
+}
+
+bool SimLattice::shift_dr(bool tdi)
+{
+	if (_ir == LAT_BURST) {
+		_sync = (_sync << 1) | tdi;
+		if (_sync == LAT_PREAMBLE)
+			_synced = true;
+		return false;
+	}
+	if (_bridge_sel) {
+		bool tdo = _flash->miso();
+		_flash->clock(tdi);
+		return tdo;
+	}
+	return _dr.shift(tdi);
+}
+
+void SimLattice::exit_shift_dr()
+{
+	if (_bridge_sel) {
+		_flash->deselect();
+		_bridge_sel = false;
+	}
+}
+
+void SimLattice::update_dr()
+{
+	uint64_t val = _dr.value();
+
+	switch (_ir) {
+	case LAT_ISC_ENABLE:
+	case LAT_ISC_ENABLE_X:
+		_isc_en = true;
+		_busy = 1;
+		break;
+	case LAT_ERASE:
+		if (val & LAT_ERASE_SRAM) {
+			_done = false;
+			_synced = false;
+		}
+		if (val & LAT_ERASE_FEATURE) {
+			_features = 0;
+			_feabits = 0;
+		}
+		if (val & LAT_ERASE_CFG) {
+			_rows.clear();
+			_prog_done = false;
+		}
+		_busy = LAT_BUSY_ERASE;
+		break;
+	case LAT_PROG_INCR_NV: {
+		if (!_isc_en)
+			break;
+		size_t off = _row++ * LAT_ROW_SIZE;
+		if (_rows.size() < off + LAT_ROW_SIZE)
+			_rows.resize(off + LAT_ROW_SIZE, 0x00);
+		_dr.get(&_rows[off]);
+		_busy = 1;
+		break;
+	}
+	case LAT_PROG_FEATURE:
+		_features = val;
+		_busy = 1;
+		break;
+	case LAT_PROG_FEABITS:
+		_feabits = val & 0xffff;
+		_busy = 1;
+		break;
+	case LAT_PROG_SPI:
+		if (_flash && val == LAT_SPI_KEY)
+			_spi_en = true;
+		break;
+	}
+}
+
+/* -------- */
+/* SimGowin */
+/* -------- */
+
+#define GW_NOOP           0x02
+#define GW_ERASE_SRAM     0x05
+#define GW_XFER_DONE      0x09
+#define GW_READ_IDCODE    0x11
+#define GW_READ_USERCODE  0x13
+#define GW_CONFIG_ENABLE  0x15
+#define GW_XFER_WRITE     0x17
+#define GW_CONFIG_DISABLE 0x3A
+#define GW_RELOAD         0x3C
+#define GW_STATUS         0x41
+#  define GW_STATUS_MEMORY_ERASE (1 << 5)
+#  define GW_STATUS_EDIT_MODE    (1 << 7)
+#  define GW_STATUS_DONE_FINAL   (1 << 13)
+#  define GW_STATUS_READY        (1 << 15)
+#define GW_EF_PROGRAM     0x71
+#define GW_EFLASH_ERASE   0x75
+/* bitstream header commands */
+#define GW_HDR_CHECKSUM   0x0A
+#define GW_HDR_LAST       0x3B
+/* internal flash size limit */
+#define GW_EFLASH_MAX     (4 << 20)
+
+void SimGowin::FsHeader::clear()
+{
+	_state = PREAMBLE;
+	_rec_len = 0;
+	_nb_data = 0;
+	_usercode = 0;
+}
+
+/* header: 0xff preamble, 0xA5C3 sync then 64 bits commands up to
+ * the last one (0x3B)
+ */
+void SimGowin::FsHeader::feed(uint8_t val)
+{
+	switch (_state) {
+	case PREAMBLE:
+		if (val == 0xff)
+			return;
+		if (val == 0xa5) {
+			_state = SYNC;
+			return;
+		}
+		_state = RECORD;
+		break;
+	case SYNC:
+		_state = RECORD;
+		return;
+	case DATA:
+		_nb_data++;
+		return;
+	case RECORD:
+		break;
+	}
+
+	_rec[_rec_len++] = val;
+	if (_rec_len < 8)
+		return;
+	_rec_len = 0;
+	switch (_rec[0] & 0x7f) {
+	case GW_HDR_CHECKSUM:
+		_usercode = (_rec[6] << 8) | _rec[7];
+		break;
+	case GW_HDR_LAST:
+		_state = DATA;
+		break;
+	}
+}
+
+SimGowin::SimGowin(uint32_t idcode): SimDevice(idcode, 8, GW_READ_IDCODE),
+	_sram_byte(0), _sram_nb_bit(0), _ef_addr(0), _ef_first(false),
+	_edit_mode(false), _erased(false), _done(false), _usercode(0)
+{}
+
+uint32_t SimGowin::status()
+{
+	uint32_t reg = GW_STATUS_READY;
+	if (_erased)
+		reg |= GW_STATUS_MEMORY_ERASE;
+	if (_edit_mode)
+		reg |= GW_STATUS_EDIT_MODE;
+	if (_done)
+		reg |= GW_STATUS_DONE_FINAL;
+	return reg;
+}
+
+void SimGowin::reload()
+{
+	static const uint8_t bootcode[4] = {0x47, 0x57, 0x31, 0x4E};
+
+	_edit_mode = false;
+	_done = false;
+	_usercode = 0;
+	if (_eflash.size() < 4 || memcmp(_eflash.data(), bootcode, 4) != 0)
+		return;
+
+	FsHeader hdr;
+	for (size_t i = 4; i < _eflash.size() && !hdr.complete(); i++)
+		hdr.feed(_eflash[i]);
+	_done = true;
+	_usercode = hdr.usercode();
+}
+
+void SimGowin::update_ir(uint32_t ir)
+{
+	SimDevice::update_ir(ir);
+	switch (ir) {
+	case GW_CONFIG_ENABLE:
+		_edit_mode = true;
+		break;
+	case GW_CONFIG_DISABLE:
+		_edit_mode = false;
+		break;
+	case GW_ERASE_SRAM:
+		if (_edit_mode) {
+			_erased = true;
+			_done = false;
+			_usercode = 0;
+			_sram_hdr.clear();
+		}
+		break;
+	case GW_XFER_WRITE:
+		_sram_hdr.clear();
+		_sram_nb_bit = 0;
+		break;
+	case GW_XFER_DONE:
+		/* a broken header only gives a wrong usercode: the driver
+		 * reports it, rather than polling DONE forever
+		 */
+		if (_sram_hdr.received()) {
+			_done = true;
+			_usercode = _sram_hdr.usercode();
+		}
+		break;
+	case GW_RELOAD:
+		reload();
+		break;
+	case GW_EF_PROGRAM:
+		_ef_first = true;
+		break;
+	case GW_EFLASH_ERASE:
+		if (_edit_mode)
+			_eflash.clear();
+		break;
+	}
+}
+
+void SimGowin::capture_dr()
+{
+	switch (_ir) {
+	case GW_STATUS:
+		_dr.load_value(status(), 32);
+		return;
+	case GW_READ_USERCODE:
+		_dr.load_value(_usercode, 32);
+		return;
+	case GW_EF_PROGRAM:
+	case GW_EFLASH_ERASE:
+		_dr.load_value(0, 32);
+		return;
+	case GW_XFER_WRITE:
+		return;
+	}
+	SimDevice::capture_dr();
+}
+
+bool SimGowin::shift_dr(bool tdi)
+{
+	if (_ir == GW_XFER_WRITE) {
+		/* bitstream is sent MSB first */
+		_sram_byte = (_sram_byte << 1) | tdi;
+		if (++_sram_nb_bit == 8) {
+			_sram_nb_bit = 0;
+			_sram_hdr.feed(_sram_byte);
+		}
+		return false;
+	}
+	return _dr.shift(tdi);
+}
+
+void SimGowin::update_dr()
+{
+	if (_ir != GW_EF_PROGRAM)
+		return;
+
+	uint32_t val = _dr.value();
+	/* first word after EF_PROGRAM: address (32 bits words) */
+	if (_ef_first) {
+		_ef_addr = val * 4;
+		_ef_first = false;
+		return;
+	}
+	if (_ef_addr + 4 > GW_EFLASH_MAX)
+		return;
+	if (_eflash.size() < _ef_addr + 4)
+		_eflash.resize(_ef_addr + 4, 0xff);
+	for (int i = 0; i < 4; i++)
+		_eflash[_ef_addr + i] = (val >> (24 - 8 * i)) & 0xff;
+	_ef_addr += 4;
+}
+
+/* --------- */
+/* SimAltera */
+/* --------- */
+
+#define ALT_PULSE_NCONFIG 0x001
+#define ALT_PROGRAM       0x002
+#define ALT_STARTUP       0x003
+#define ALT_CHECK_STATUS  0x004
+#define ALT_IDCODE        0x006
+#define ALT_USERCODE      0x007
+#define ALT_USER0         0x00C
+#define ALT_USER1         0x00E
+#define ALT_CHECK_STATUS_LEN 864
+/* virtual IR: 14 bits, SPI bridge node address is bit 12 */
+#define ALT_VIR_LENGTH    14
+#define ALT_VIR_BRIDGE    0x1000
+
+SimAltera::SimAltera(uint32_t idcode): SimDevice(idcode, 10, ALT_IDCODE),
+	_flash(SIM_FLASH_ID, SIM_FLASH_SIZE), _cfg_bits(0), _startup(false),
+	_done(false), _vir(0), _bridge_sel(false), _delay(0), _miso(true)
+{}
+
+void SimAltera::update_ir(uint32_t ir)
+{
+	SimDevice::update_ir(ir);
+	switch (ir) {
+	case ALT_PULSE_NCONFIG:
+		_done = false;
+		break;
+	case ALT_PROGRAM:
+		_done = false;
+		_cfg_bits = 0;
+		break;
+	case ALT_STARTUP:
+		_startup = (_cfg_bits > 0);
+		break;
+	}
+}
+
+void SimAltera::capture_dr()
+{
+	switch (_ir) {
+	case ALT_PROGRAM:
+		return;
+	case ALT_CHECK_STATUS:
+		_dr.load(NULL, ALT_CHECK_STATUS_LEN);
+		return;
+	case ALT_USERCODE:
+		_dr.load_value(0xffffffff, 32);
+		return;
+	case ALT_USER1:
+		_dr.load_value(_vir, ALT_VIR_LENGTH);
+		return;
+	case ALT_USER0:
+		/* bridge: virtual IR holds SPI command (bit reversed) */
+		if (_done && (_vir & ALT_VIR_BRIDGE)) {
+			_bridge_sel = true;
+			_delay = ConfigBitstreamParser::reverseByte(_vir & 0xff);
+			_miso = true;
+			_flash.select();
+			return;
+		}
+		break;
+	}
+	SimDevice::capture_dr();
+}
+
+bool SimAltera::shift_dr(bool tdi)
+{
+	if (_ir == ALT_PROGRAM) {
+		_cfg_bits++;
+		return false;
+	}
+	if (_bridge_sel) {
+		/* command is sent first, TDI follows with 8 cycles delay,
+		 * MISO is captured one cycle late
+		 */
+		bool mosi = (_delay >> 7) & 0x01;
+		_delay = (_delay << 1) | tdi;
+		bool tdo = _miso;
+		_miso = _flash.miso();
+		_flash.clock(mosi);
+		return tdo;
+	}
+	return _dr.shift(tdi);
+}
+
+void SimAltera::exit_shift_dr()
+{
+	if (_bridge_sel) {
+		_flash.deselect();
+		_bridge_sel = false;
+	}
+}
+
+void SimAltera::update_dr()
+{
+	if (_ir == ALT_USER1)
+		_vir = _dr.value() & ((1 << ALT_VIR_LENGTH) - 1);
+}
+
+void SimAltera::idle(uint64_t nb_clk)
+{
+	/* startup completes in RUN_TEST_IDLE */
+	if (_startup && nb_clk > 0) {
+		_startup = false;
+		_done = true;
+	}
+}
@@ -0,0 +1,260 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#ifndef SRC_SIMDEVICES_HPP_
+#define SRC_SIMDEVICES_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "jtagSim.hpp"
+
+/*!
+ * \file simDevices.hpp
+ * \brief behavioral models of the configuration interfaces used by
+ *        the drivers, for the simulated cable (JtagSim)
+ */
+
+/*!
+ * \class SimSpiFlash
+ * \brief SPI NOR flash (mode 0, single I/O). Program and erase are
+ *        applied when chip select goes high, then WIP stays set for a
+ *        fixed number of status reads so polling loops are exercised.
+ *        Above 16MB, 4-byte opcodes, EN4B/EX4B and the extended
+ *        address register are all accepted. SFDP describes the part
+ */
+class SimSpiFlash {
+ public:
+	/*!
+	 * \param[in] jedec_id: manufacturer, type and capacity (24 bits)
+	 * \param[in] size: memory size (bytes)
+	 */
+	SimSpiFlash(uint32_t jedec_id, uint32_t size);
+
+	/*!
+	 * \brief chip select falling edge
+	 */
+	void select();
+	/*!
+	 * \brief chip select rising edge: pending command is executed
+	 */
+	void deselect();
+	/*!
+	 * \brief MISO value for the current SCK cycle
+	 */
+	bool miso() const { return (_out >> 7) & 0x01; }
+	/*!
+	 * \brief SCK rising edge
+	 * \param[in] mosi: MOSI value
+	 */
+	void clock(bool mosi)
+	{
+		if (!_selected)
+			return;
+		_in = (_in << 1) | mosi;
+		_out <<= 1;
+		if (++_nb_bit == 8) {
+			_nb_bit = 0;
+			rx_byte(_in);
+			_nb_byte++;
+		}
+	}
+	/*!
+	 * \brief search a byte pattern in the first len bytes
+	 */
+	bool contains(const uint8_t *pattern, uint32_t pattern_len,
+		uint32_t len) const;
+
+ private:
+	/*!
+	 * \brief a full byte was received: decode it and prepare next
+	 *        MISO byte
+	 */
+	void rx_byte(uint8_t val);
+	/*!
+	 * \brief status register value (WIP set while busy)
+	 */
+	uint8_t read_status();
+	/*!
+	 * \brief number of address bytes for current command
+	 */
+	uint32_t addr_len() const;
+	void erase(uint32_t addr, uint32_t size);
+
+	std::vector<uint8_t> _mem;  /*!< memory content */
+	std::vector<uint8_t> _page; /*!< page program buffer */
+	uint32_t _jedec_id;  /*!< RDID answer */
+	uint8_t _status;     /*!< status register (WIP excluded) */
+	uint32_t _busy;      /*!< status reads before WIP clear */
+	bool _selected;      /*!< chip select state */
+	uint8_t _in;         /*!< byte being received */
+	uint8_t _out;        /*!< byte being sent */
+	uint8_t _nb_bit;     /*!< bits received in current byte */
+	uint32_t _nb_byte;   /*!< bytes received since select */
+	uint8_t _cmd;        /*!< current command */
+	uint8_t _arg;        /*!< last argument byte */
+	uint32_t _addr;      /*!< current address */
+	bool _addr4;         /*!< 4-byte address mode (EN4B) */
+	uint8_t _ear;        /*!< extended address register */
+	std::vector<uint8_t> _sfdp; /*!< SFDP area */
+};
+
+/*!
+ * \class SimXilinx
+ * \brief Xilinx 7 series: JPROGRAM / CFG_IN / JSTART configuration
+ *        and SPI flash bridge (spiOverJtag) on USER1 once configured
+ */
+class SimXilinx : public SimDevice {
+ public:
+	explicit SimXilinx(uint32_t idcode);
+	std::string name() const override { return "artix7"; }
+
+	uint32_t capture_ir() override;
+	void update_ir(uint32_t ir) override;
+	void capture_dr() override;
+	bool shift_dr(bool tdi) override;
+	void exit_shift_dr() override;
+	void idle(uint64_t nb_clk) override;
+
+ private:
+	SimSpiFlash _flash;    /*!< configuration flash */
+	uint32_t _sync;        /*!< last 32 bits received with CFG_IN */
+	bool _synced;          /*!< sync word received */
+	bool _startup;         /*!< startup sequence running */
+	uint64_t _startup_clk; /*!< clock cycles since JSTART */
+	bool _done;            /*!< DONE pin */
+	bool _bridge_sel;      /*!< bridge: flash selected */
+	bool _miso;            /*!< bridge: MISO delayed by one cycle */
+};
+
+/*!
+ * \class SimLattice
+ * \brief Lattice sysCONFIG over JTAG: status/busy registers, SRAM
+ *        bitstream burst, internal flash rows (MachXO2), feature row
+ *        and SPI flash access (ECP5)
+ */
+class SimLattice : public SimDevice {
+ public:
+	/*!
+	 * \param[in] idcode: device IDCODE
+	 * \param[in] ecp5: true for ECP5 (SRAM + SPI flash), false for
+	 *            MachXO2 (internal flash)
+	 */
+	SimLattice(uint32_t idcode, bool ecp5);
+	~SimLattice();
+	std::string name() const override { return (_flash) ? "ecp5" : "machxo2"; }
+
+	void update_ir(uint32_t ir) override;
+	void capture_dr() override;
+	bool shift_dr(bool tdi) override;
+	void exit_shift_dr() override;
+	void update_dr() override;
+
+ private:
+	uint32_t status();
+
+	SimSpiFlash *_flash;   /*!< external flash, ECP5 only */
+	std::vector<uint8_t> _rows; /*!< internal flash (16 bytes rows) */
+	uint32_t _row;         /*!< row address */
+	uint64_t _features;    /*!< feature row */
+	uint16_t _feabits;     /*!< feabits */
+	bool _isc_en;          /*!< configuration mode */
+	bool _prog_done;       /*!< flash DONE bit programmed */
+	bool _done;            /*!< device configured */
+	uint32_t _busy;        /*!< busy polls before ready */
+	uint32_t _sync;        /*!< last 32 bits of bitstream burst */
+	bool _synced;          /*!< bitstream preamble received */
+	bool _spi_en;          /*!< SPI access unlocked */
+	bool _bridge_sel;      /*!< flash selected */
+};
+
+/*!
+ * \class SimGowin
+ * \brief Gowin GW1N: status register, SRAM load (XFER_WRITE) and
+ *        internal flash programming (EF_PROGRAM / RELOAD). The user
+ *        code is taken from the bitstream header
+ */
+class SimGowin : public SimDevice {
+ public:
+	explicit SimGowin(uint32_t idcode);
+	std::string name() const override { return "gw1n"; }
+
+	void update_ir(uint32_t ir) override;
+	void capture_dr() override;
+	bool shift_dr(bool tdi) override;
+	void update_dr() override;
+
+ private:
+	/*!
+	 * \brief bitstream header decoder
+	 */
+	class FsHeader {
+	 public:
+		FsHeader() { clear(); }
+		void clear();
+		void feed(uint8_t val);
+		/*!
+		 * \brief header fully received and followed by data
+		 */
+		bool complete() const { return _state == DATA && _nb_data > 0; }
+		/*!
+		 * \brief something else than preamble was received
+		 */
+		bool received() const { return _state != PREAMBLE; }
+		uint32_t usercode() const { return _usercode; }
+	 private:
+		enum { PREAMBLE, SYNC, RECORD, DATA } _state;
+		uint8_t _rec[8];
+		int _rec_len;
+		uint32_t _nb_data;
+		uint32_t _usercode;
+	};
+	uint32_t status();
+	void reload();
+
+	std::vector<uint8_t> _eflash; /*!< internal flash content */
+	FsHeader _sram_hdr;     /*!< SRAM bitstream decoder */
+	uint8_t _sram_byte;     /*!< SRAM bitstream byte being received */
+	uint8_t _sram_nb_bit;   /*!< bits in _sram_byte */
+	uint32_t _ef_addr;      /*!< flash write address (bytes) */
+	bool _ef_first;         /*!< next flash word is an address */
+	bool _edit_mode;        /*!< configuration enabled */
+	bool _erased;           /*!< SRAM erase done */
+	bool _done;             /*!< configuration done */
+	uint32_t _usercode;     /*!< usercode of loaded bitstream */
+};
+
+/*!
+ * \class SimAltera
+ * \brief Intel/Altera Cyclone: SRAM load (PROGRAM / STARTUP) and SPI
+ *        flash bridge behind virtual JTAG (USER1 selects node and SPI
+ *        command, USER0 carries data)
+ */
+class SimAltera : public SimDevice {
+ public:
+	explicit SimAltera(uint32_t idcode);
+	std::string name() const override { return "cyclone10"; }
+
+	void update_ir(uint32_t ir) override;
+	void capture_dr() override;
+	bool shift_dr(bool tdi) override;
+	void exit_shift_dr() override;
+	void update_dr() override;
+	void idle(uint64_t nb_clk) override;
+
+ private:
+	SimSpiFlash _flash;    /*!< configuration flash */
+	uint64_t _cfg_bits;    /*!< bits received with PROGRAM */
+	bool _startup;         /*!< STARTUP loaded */
+	bool _done;            /*!< CONF_DONE */
+	uint32_t _vir;         /*!< virtual instruction register */
+	bool _bridge_sel;      /*!< bridge: flash selected */
+	uint8_t _delay;        /*!< bridge: command then TDI delayed 8 bits */
+	bool _miso;            /*!< bridge: MISO delayed by one cycle */
+};
+
+#endif  // SRC_SIMDEVICES_HPP_
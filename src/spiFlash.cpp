@@ -3,19 +3,46 @@
  * Copyright (C) 2019 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <cmath>
+#include <fstream>
 #include <map>
 #include <iostream>
+#include <vector>
 
+#include "cacheDir.hpp"
 #include "progressBar.hpp"
 #include "display.hpp"
 #include "spiFlash.hpp"
 #include "spiFlashdb.hpp"
 #include "spiInterface.hpp"
+#include "usbStats.hpp"
+
+bool SPIFlash::_differential = false;
+
+/* datasheet worst case timings (us), used for spi_wait timeouts
+ * when neither the database entry nor SFDP provide them
+ */
+#define FLASH_TW_US    15000    /* write status register */
+#define FLASH_TPP_US   5000     /* page program */
+#define FLASH_TSE_US   800000   /* 4KB sector erase */
+#define FLASH_TBE32_US 1600000  /* 32KB block erase */
+#define FLASH_TBE_US   3000000  /* 64KB block erase */
+#define FLASH_TCE_US   1000000  /* chip erase, per 64KB sector */
+
+/* datasheet typical erase timings (us), used by the erase planner
+ * when neither the database entry nor SFDP provide them
+ */
+#define FLASH_TSE_TYP_US   45000
+#define FLASH_TBE32_TYP_US 120000
+#define FLASH_TBE_TYP_US   150000
+
+/* largest read sent as one command: bounds converter buffers */
+#define FLASH_RD_CHUNK 0x100000
 
 /* read/write status register : 0B addr + 0 dummy */
 #define FLASH_WRSR     0x01
@@ -24,9 +51,19 @@
 #	define FLASH_RDSR_WEL	(0x02)
 /* flash program */
 #define FLASH_PP       0x02
+/* 4-byte address opcodes */
+#define FLASH_4FAST_READ 0x0C
+#define FLASH_4PP      0x12
+#define FLASH_4READ    0x13
+#define FLASH_4SE      0x21
+#define FLASH_4BE64    0xDC
+/* read : 3B addr + 0 dummy */
+#define FLASH_READ     0x03
 /* write [en|dis]able : 0B addr + 0 dummy */
 #define FLASH_WRDIS    0x04
 #define FLASH_WREN     0x06
+/* fast read : 3B addr + 8 dummy cycles */
+#define FLASH_FAST_READ 0x0B
 /* sector (4Kb) erase */
 #define FLASH_SE       0x20
 /* read configuration register */
@@ -37,9 +74,14 @@
 #define FLASH_RDFR     0x48
 /* Read OTP : 3 B addr + 8 clk cycle*/
 #define FLASH_ROTP     0x4B
+/* Read SFDP : 3 B addr + 8 clk cycle */
+#define FLASH_RDSFDP   0x5A
 /* block (32Kb) erase */
 #define FLASH_BE32     0x52
 #define FLASH_POWER_UP 0xAB
+/* enter/exit 4-byte address mode */
+#define FLASH_EN4B     0xB7
+#define FLASH_EX4B     0xE9
 #define FLASH_POWER_DOWN 0xB9
 /* read/write non volatile register: 0B addr + 0 dummy */
 #define FLASH_RDNVCR   0xB5
@@ -47,6 +89,8 @@
 /* read/write volatile register */
 #define FLASH_RDVCR    0x85
 #define FLASH_WRVCR    0x81
+/* write extended address register (address bits 31:24) */
+#define FLASH_WREAR    0xC5
 /* bulk erase */
 #define FLASH_CE       0xC7
 /* block (64kb) erase */
@@ -67,19 +111,111 @@
 /* Global Block Protection unlock */
 #define FLASH_ULBPR 0x98
 
+/* SFDP header signature ("SFDP") and parameter IDs (MSB << 8 | LSB) */
+#define SFDP_SIGNATURE 0x50444653
+#define SFDP_BFPT_ID   0xFF00  /* Basic Flash Parameter Table */
+#define SFDP_SMPT_ID   0xFF81  /* Sector Map Parameter Table */
+
+/* index in flash_param_t erase arrays */
+static int erase_idx(int size)
+{
+	return (size == 0x1000) ? 0 : (size == 0x8000) ? 1 : 2;
+}
+
+/* spi_wait tries for an operation lasting up to twice its datasheet
+ * max duration, never less than min (historical values)
+ */
+static uint32_t wait_tries(uint64_t duration_us, uint32_t min)
+{
+	uint64_t tries = 2 * duration_us / SPI_WAIT_TRY_US;
+	if (tries > UINT32_MAX)
+		return UINT32_MAX;
+	return (tries < min) ? min : static_cast<uint32_t>(tries);
+}
+
 SPIFlash::SPIFlash(SPIInterface *spi, bool unprotect, int8_t verbose):
 	_spi(spi), _verbose(verbose), _jedec_id(0),
-	_flash_model(NULL), _unprotect(unprotect)
+	_flash_model(NULL), _unprotect(unprotect), _addr4_en(false), _ear(0),
+	_param()
 {
 	reset();
 	power_up();
 	read_id();
 }
 
+int SPIFlash::restore_addr_mode()
+{
+	/* FPGA loads its bitstream with 3-byte addresses in the first 16MB */
+	if (_addr4_en) {
+		if (write_enable() != 0)
+			return -1;
+		if (_spi->spi_put(FLASH_EX4B, NULL, NULL, 0) != 0)
+			return -1;
+		_addr4_en = false;
+	}
+	if (_ear != 0)
+		return set_ear(0);
+	return 0;
+}
+
+int SPIFlash::set_ear(uint8_t ear)
+{
+	if (write_enable() != 0)
+		return -1;
+	if (_spi->spi_put(FLASH_WREAR, &ear, NULL, 1) != 0)
+		return -1;
+	_ear = ear;
+	return 0;
+}
+
+int SPIFlash::set_addr_mode(int addr)
+{
+	addr_mode_t mode = _param.addr_mode;
+
+	if (mode == ADDR_EN4B && !_addr4_en && addr >= 0x1000000) {
+		if (write_enable() != 0)
+			return -1;
+		if (_spi->spi_put(FLASH_EN4B, NULL, NULL, 0) != 0)
+			return -1;
+		_addr4_en = true;
+	} else if (mode == ADDR_EAR && (addr >> 24) != _ear) {
+		return set_ear(addr >> 24);
+	}
+	return 0;
+}
+
+int SPIFlash::addr_cmd(uint8_t cmd, int addr, uint8_t *hdr)
+{
+	if (set_addr_mode(addr) != 0)
+		return -1;
+
+	int nb = (_addr4_en) ? 4 : 3;
+	if (_param.addr_mode == ADDR_4B_OPCODES) {
+		nb = 4;
+		switch (cmd) {
+		case FLASH_READ:      cmd = FLASH_4READ;      break;
+		case FLASH_FAST_READ: cmd = FLASH_4FAST_READ; break;
+		case FLASH_PP:        cmd = FLASH_4PP;        break;
+		case FLASH_SE:        cmd = FLASH_4SE;        break;
+		case FLASH_BE64:      cmd = FLASH_4BE64;      break;
+		default:
+			printError("no 4-byte address opcode for command " +
+				std::to_string(cmd));
+			return -1;
+		}
+	}
+
+	hdr[0] = cmd;
+	for (int i = 0; i < nb; i++)
+		hdr[1 + i] = static_cast<uint8_t>(0xff & (addr >> (8 * (nb - 1 - i))));
+	return nb + 1;
+}
+
 int SPIFlash::bulk_erase()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_ERASE);
 	int ret, ret2 = 0;
-	uint32_t timeout=100000;
+	uint32_t timeout = wait_tries(_param.ce_max_us, 100000);
 	uint8_t bp = get_bp();
 	if (bp != 0) {
 		if (!_unprotect) {
@@ -107,136 +243,251 @@ int SPIFlash::bulk_erase()
 /* sector -> subsector for micron */
 int SPIFlash::sector_erase(int addr)
 {
-	uint8_t tx[4];
-	tx[0] = (uint8_t)(FLASH_SE           );
-	tx[1] = (uint8_t)(0xff & (addr >> 16));
-	tx[2] = (uint8_t)(0xff & (addr >>  8));
-	tx[3] = (uint8_t)(0xff & (addr      ));
-	_spi->spi_put(tx, NULL, 4);
+	uint8_t tx[5];
+	int len = addr_cmd(FLASH_SE, addr, tx);
+	if (len < 0)
+		return -1;
+	_spi->spi_put(tx, NULL, len);
 	return 0;
 }
 
 int SPIFlash::block32_erase(int addr)
 {
-	uint8_t tx[4] = {
-		static_cast<uint8_t>(FLASH_BE32         ),
-		static_cast<uint8_t>(0xff & (addr >> 16)),
-		static_cast<uint8_t>(0xff & (addr >>  8)),
-		static_cast<uint8_t>(0xff & (addr      ))};
-	_spi->spi_put(tx, NULL, 4);
+	uint8_t tx[5];
+	int len = addr_cmd(FLASH_BE32, addr, tx);
+	if (len < 0)
+		return -1;
+	_spi->spi_put(tx, NULL, len);
 	return 0;
 }
 
 /* block64 -> sector for micron */
 int SPIFlash::block64_erase(int addr)
 {
-	uint8_t tx[4] = {
-		static_cast<uint8_t>(FLASH_BE64         ),
-		static_cast<uint8_t>(0xff & (addr >> 16)),
-		static_cast<uint8_t>(0xff & (addr >>  8)),
-		static_cast<uint8_t>(0xff & (addr      ))};
-	_spi->spi_put(tx, NULL, 4);
+	uint8_t tx[5];
+	int len = addr_cmd(FLASH_BE64, addr, tx);
+	if (len < 0)
+		return -1;
+	_spi->spi_put(tx, NULL, len);
 	return 0;
 }
 
 int SPIFlash::sectors_erase(int base_addr, int size)
 {
+	UsbStatsPhase phase(UsbStats::PHASE_ERASE);
 
-	// check if chip support sector and subsector erase
-	bool subsector_rdy = false, sector_rdy = true;
-	if (_flash_model) {
-		if (_flash_model->subsector_erase)
-			subsector_rdy = true;
-		if (!_flash_model->sector_erase)
-			sector_rdy = false;
-	}
 	int ret = 0;
-	int start_addr = base_addr;
-	/* compute end_addr to be multiple of 4Kb */
-	int end_addr = (base_addr + size + 0xfff) & ~0xfff;
-	if (!subsector_rdy)
-		end_addr = (base_addr + size + 0xffff) & ~0xffff;
-	ProgressBar progress("Erasing", end_addr, 50, _verbose < 0);
-	/* start with block size (64Kb) */
-	int step = 0x10000;
-	if (!sector_rdy)
-		step = 0x1000;
-
-	for (int addr = start_addr; addr < end_addr; addr += step) {
-		if (write_enable() == -1) {
-			ret = -1;
-			break;
-		}
+	const int unit = erase_min_size();
+	const int end_addr = base_addr + size;
+	/* area effectively erased: multiple of the smallest erase unit */
+	const int start_addr = base_addr & ~(unit - 1);
+	const int stop_addr = (end_addr + unit - 1) & ~(unit - 1);
+
+	/* keep content outside [base_addr, end_addr) sharing an erase unit */
+	std::vector<uint8_t> head(base_addr - start_addr);
+	std::vector<uint8_t> tail(stop_addr - end_addr);
+	if (!head.empty() && read(start_addr, head.data(), head.size()) != 0)
+		return -1;
+	if (!tail.empty() && read(end_addr, tail.data(), tail.size()) != 0)
+		return -1;
 
-		/* if block erase + addr end out of end_addr -> use sector_erase (4Kb) */
-		if (!sector_rdy || (addr + step > end_addr && subsector_rdy)) {
-			step = 0x1000;
-			ret = sector_erase(addr);
-		} else {
-			ret = block64_erase(addr);
-		}
+	std::vector<std::pair<int, int>> plan;
+	erase_plan(start_addr, stop_addr, plan);
 
-		if (ret == -1) {
-			break;
-		}
-		if (_spi->spi_wait(FLASH_RDSR, FLASH_RDSR_WIP, 0x00, 100000, false) == -1) {
-			ret = -1;
-			break;
+	/* area spans the whole part: one chip erase, unless known to be
+	 * slower than the block erases
+	 */
+	bool chip_erase = false;
+	if (_param.size != 0 && start_addr == 0 &&
+			stop_addr >= static_cast<int>(_param.size)) {
+		uint64_t plan_us = 0;
+		for (auto &op : plan)
+			plan_us += _param.erase_typ_us[erase_idx(op.second)];
+		chip_erase = (_param.ce_typ_us == 0 || _param.ce_typ_us <= plan_us);
+	}
+
+	if (chip_erase) {
+		printInfo("Erasing: full chip");
+		ret = bulk_erase();
+	} else {
+		ProgressBar progress("Erasing", stop_addr, 50, _verbose < 0);
+		for (auto &op : plan) {
+			if ((ret = erase_unit(op.first, op.second)) == -1)
+				break;
+			progress.display(op.first);
 		}
-		progress.display(addr);
+		if (ret == 0)
+			progress.done();
+		else
+			progress.fail();
 	}
-	if (ret == 0)
-		progress.done();
-	else
-		progress.fail();
+
+	if (ret == 0 && !head.empty())
+		ret = write_range(start_addr, head.data(), head.size());
+	if (ret == 0 && !tail.empty())
+		ret = write_range(end_addr, tail.data(), tail.size());
 
 	return ret;
 }
 
-int SPIFlash::write_page(int addr, uint8_t *data, int len)
+bool SPIFlash::erase_supported(int size)
+{
+	switch (size) {
+	case 0x1000:
+	case 0x10000:
+		return _param.erase[erase_idx(size)];
+	case 0x8000:
+		/* no common 4-byte address 32KB erase opcode */
+		return _param.erase[1] && _param.addr_mode != ADDR_4B_OPCODES;
+	default:
+		return false;
+	}
+}
+
+int SPIFlash::erase_min_size()
+{
+	if (erase_supported(0x1000))
+		return 0x1000;
+	if (erase_supported(0x8000))
+		return 0x8000;
+	return 0x10000;
+}
+
+void SPIFlash::erase_plan(int start_addr, int end_addr,
+		std::vector<std::pair<int, int>> &plan)
+{
+	static const int sizes[] = {0x1000, 0x8000, 0x10000};
+	const int unit = erase_min_size();
+	const int nb = (end_addr - start_addr) / unit;
+
+	/* cost[i]: minimal time to erase units i to nb - 1,
+	 * op_size[i]: first erase to issue at unit i
+	 */
+	std::vector<uint64_t> cost(nb + 1, 0);
+	std::vector<int> op_size(nb, unit);
+	for (int i = nb - 1; i >= 0; i--) {
+		int addr = start_addr + i * unit;
+		cost[i] = UINT64_MAX;
+		for (int size : sizes) {
+			int len = size / unit;
+			if (size < unit || !erase_supported(size) ||
+					(addr & (size - 1)) != 0 || i + len > nb)
+				continue;
+			uint64_t c = _param.erase_typ_us[erase_idx(size)] + cost[i + len];
+			if (c < cost[i]) {
+				cost[i] = c;
+				op_size[i] = size;
+			}
+		}
+	}
+
+	plan.clear();
+	for (int i = 0; i < nb; i += op_size[i] / unit)
+		plan.push_back(std::make_pair(start_addr + i * unit, op_size[i]));
+}
+
+int SPIFlash::erase_unit(int addr, int size)
+{
+	UsbStatsPhase phase(UsbStats::PHASE_ERASE);
+	/* addressing mode change must precede write enable */
+	if (set_addr_mode(addr) == -1 || write_enable() == -1)
+		return -1;
+
+	int ret;
+	switch (size) {
+	case 0x1000:
+		ret = sector_erase(addr);
+		break;
+	case 0x8000:
+		ret = block32_erase(addr);
+		break;
+	default:
+		ret = block64_erase(addr);
+		break;
+	}
+	if (ret == -1)
+		return -1;
+
+	if (_spi->spi_wait(FLASH_RDSR, FLASH_RDSR_WIP, 0x00,
+			wait_tries(_param.erase_max_us[erase_idx(size)], 100000),
+			false) < 0)
+		return -1;
+	return 0;
+}
+
+int SPIFlash::write_range(int addr, const uint8_t *data, int len)
 {
-	uint8_t tx[len+3];
-	tx[0] = (uint8_t)(0xff & (addr >> 16));
-	tx[1] = (uint8_t)(0xff & (addr >>  8));
-	tx[2] = (uint8_t)(0xff & (addr      ));
+	const int page_size = _param.page_size;
+	for (int size, pos = 0; pos < len; pos += size) {
+		size = page_size - ((addr + pos) % page_size);
+		if (pos + size > len)
+			size = len - pos;
+		/* erased flash content: nothing to write */
+		bool blank = true;
+		for (int i = 0; i < size && blank; i++)
+			blank = (data[pos + i] == 0xff);
+		if (blank)
+			continue;
+		if (write_page(addr + pos, const_cast<uint8_t *>(data) + pos,
+				size) == -1)
+			return -1;
+	}
+	return 0;
+}
 
-	memcpy(tx+3, data, len);
+int SPIFlash::write_page(int addr, uint8_t *data, int len)
+{
+	uint8_t tx[5];
+	int hdr_len = addr_cmd(FLASH_PP, addr, tx);
+	if (hdr_len < 0)
+		return -1;
+	const SPIInterface::spi_seg_t seg[2] = {
+		{tx + 1, NULL, static_cast<uint32_t>(hdr_len - 1)},
+		{data, NULL, static_cast<uint32_t>(len)}};
 
 	if (write_enable() == -1)
 		return -1;
 
-	_spi->spi_put(FLASH_PP, tx, NULL, len+3);
-	return _spi->spi_wait(FLASH_RDSR, FLASH_RDSR_WIP, 0x00, 1000);
+	_spi->spi_xfer(tx[0], seg, 2);
+	return _spi->spi_wait(FLASH_RDSR, FLASH_RDSR_WIP, 0x00,
+		wait_tries(_param.pp_max_us, 1000));
 }
 
 int SPIFlash::read(int base_addr, uint8_t *data, int len)
 {
-	uint8_t tx[len+3];
-	uint8_t rx[len+3];
-	tx[0] = (uint8_t)(0xff & (base_addr >> 16));
-	tx[1] = (uint8_t)(0xff & (base_addr >>  8));
-	tx[2] = (uint8_t)(0xff & (base_addr      ));
-
-	int ret = _spi->spi_put(0x03, tx, rx, len+3);
-	if (ret == 0)
-		memcpy(data, rx+3, len);
-	else
-		printf("error\n");
-	return ret;
+	/* fast read: allowed up to max SPI frequency, one dummy byte */
+	for (int size, pos = 0; pos < len; pos += size) {
+		int addr = base_addr + pos;
+		size = (len - pos > FLASH_RD_CHUNK) ? FLASH_RD_CHUNK : len - pos;
+		/* a read never crosses a 16MB bank (extended address) */
+		if ((addr & 0xffffff) + size > 0x1000000)
+			size = 0x1000000 - (addr & 0xffffff);
+		uint8_t tx[5];
+		int hdr_len = addr_cmd(FLASH_FAST_READ, addr, tx);
+		if (hdr_len < 0)
+			return -1;
+		const SPIInterface::spi_seg_t seg[3] = {
+			{tx + 1, NULL, static_cast<uint32_t>(hdr_len - 1)},
+			{NULL, NULL, 1},
+			{NULL, data + pos, static_cast<uint32_t>(size)}};
+
+		int ret = _spi->spi_xfer(tx[0], seg, 3);
+		if (ret != 0) {
+			printError("flash read error");
+			return ret;
+		}
+	}
+	return 0;
 }
 
 bool SPIFlash::dump(const std::string &filename, const int &base_addr,
 		const int &len, int rd_burst)
 {
-	if (rd_burst == 0)
-		rd_burst = len;
-
-	/* segfault with buffer > 1M */
-	if (rd_burst > 0x100000)
-		rd_burst = 0x100000;
+	UsbStatsPhase phase(UsbStats::PHASE_READ);
+	if (rd_burst == 0 || rd_burst > FLASH_RD_CHUNK)
+		rd_burst = FLASH_RD_CHUNK;
 
-	std::string data;
-	data.resize(rd_burst);
+	std::vector<uint8_t> data(rd_burst);
 
 	printInfo("dump flash (May take time)");
 
@@ -253,13 +504,19 @@ bool SPIFlash::dump(const std::string &filename, const int &base_addr,
 	for (int i = 0; i < len; i += rd_burst) {
 		if (rd_burst + i > len)
 			rd_burst = len - i;
-		if (0 != read(base_addr + i, (uint8_t*)&data[0], rd_burst)) {
+		if (0 != read(base_addr + i, data.data(), rd_burst)) {
 			progress.fail();
 			printError("Failed to read flash");
 			fclose(fd);
 			return false;
 		}
-		fwrite(data.c_str(), sizeof(uint8_t), rd_burst, fd);
+		if (fwrite(data.data(), sizeof(uint8_t), rd_burst, fd) !=
+				static_cast<size_t>(rd_burst)) {
+			progress.fail();
+			printError("Failed to write " + filename);
+			fclose(fd);
+			return false;
+		}
 		progress.display(i);
 	}
 
@@ -272,6 +529,7 @@ bool SPIFlash::dump(const std::string &filename, const int &base_addr,
 
 int SPIFlash::erase_and_prog(int base_addr, uint8_t *data, int len)
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PROGRAM);
 	if (_jedec_id == 0)
 		read_id();
 	bool must_relock = false;  // used to relock after write;
@@ -288,13 +546,13 @@ int SPIFlash::erase_and_prog(int base_addr, uint8_t *data, int len)
 	uint8_t status = read_status_reg() & ~0x03;
 	if (_verbose > 0)
 		display_status_reg(status);
+	/* check if offset + len fit in flash */
+	if (_param.size != 0 && (unsigned int)(base_addr + len) > _param.size) {
+		printError("flash overflow");
+		return -1;
+	}
 	/* if known chip */
 	if (_flash_model) {
-		/* check if offset + len fit in flash */
-		if ((unsigned int)(base_addr + len) > (_flash_model->nr_sector * 0x10000)) {
-			printError("flash overflow");
-			return -1;
-		}
 		// if device has block protect
 		if (_flash_model->bp_len != 0) {
 			/* compute protected area */
@@ -346,22 +604,27 @@ int SPIFlash::erase_and_prog(int base_addr, uint8_t *data, int len)
 	}
 
 	/* Now we can erase sector and write new data */
-	ProgressBar progress("Writing", len, 50, _verbose < 0);
-	if (sectors_erase(base_addr, len) == -1)
-		return -1;
+	if (_differential) {
+		if (diff_prog(base_addr, data, len) == -1)
+			return -1;
+	} else {
+		ProgressBar progress("Writing", len, 50, _verbose < 0);
+		if (sectors_erase(base_addr, len) == -1)
+			return -1;
 
-	uint8_t *ptr = data;
-	int size = 0;
-	for (int addr = 0; addr < len; addr += size, ptr+=size) {
-		size = (addr + 256 > len)?(len-addr) : 256;
-		if ((_jedec_id >> 8) == 0xbf258d) {
-			size = 1;
+		uint8_t *ptr = data;
+		int size = 0;
+		for (int addr = 0; addr < len; addr += size, ptr+=size) {
+			/* never cross a page boundary */
+			size = _param.page_size - ((base_addr + addr) % _param.page_size);
+			if (addr + size > len)
+				size = len - addr;
+			if (write_page(base_addr + addr, ptr, size) == -1)
+				return -1;
+			progress.display(addr);
 		}
-		if (write_page(base_addr + addr, ptr, size) == -1)
-			return -1;
-		progress.display(addr);
+		progress.done();
 	}
-	progress.done();
 
 	/* and if required: relock blocks */
 	if (must_relock) {
@@ -372,35 +635,137 @@ int SPIFlash::erase_and_prog(int base_addr, uint8_t *data, int len)
 	return 0;
 }
 
+/* erase unit state in differential mode */
+enum {
+	UNIT_SAME = 0,  /* content matches: nothing to do */
+	UNIT_PROG,      /* only 1 -> 0 changes: write without erase */
+	UNIT_ERASE      /* erase then write */
+};
+
+int SPIFlash::diff_prog(int base_addr, const uint8_t *data, int len)
+{
+	const int unit = erase_min_size();
+	const int nb_units = 0x10000 / unit;
+	const int page_size = _param.page_size;
+	const int end_addr = base_addr + len;
+	int nb_same = 0, nb_prog = 0, nb_erase = 0;
+	uint8_t state[16];
+
+	/* flash content and expected content for one 64KB block */
+	std::vector<uint8_t> flash(0x10000), want(0x10000);
+	std::vector<std::pair<int, int>> plan;
+
+	ProgressBar progress("Writing", len, 50, _verbose < 0);
+	for (int blk = base_addr & ~0xffff; blk < end_addr; blk += 0x10000) {
+		/* bitstream part of this block */
+		int lo = (blk > base_addr) ? blk : base_addr;
+		int hi = (blk + 0x10000 < end_addr) ? blk + 0x10000 : end_addr;
+		/* whole erase units are read: bytes outside the bitstream
+		 * are written back after an erase
+		 */
+		int rlo = lo & ~(unit - 1), rhi = (hi + unit - 1) & ~(unit - 1);
+		if (read(rlo, flash.data() + (rlo - blk), rhi - rlo) != 0) {
+			progress.fail();
+			return -1;
+		}
+		memcpy(want.data() + (rlo - blk), flash.data() + (rlo - blk),
+			rhi - rlo);
+		memcpy(want.data() + (lo - blk), data + (lo - base_addr), hi - lo);
+
+		for (int u = 0; u < nb_units; u++) {
+			int ulo = u * unit;
+			state[u] = UNIT_SAME;
+			if (blk + ulo < rlo || blk + ulo >= rhi)
+				continue;
+			for (int a = ulo; a < ulo + unit; a++) {
+				uint8_t cur = flash[a], val = want[a];
+				if (cur == val)
+					continue;
+				if ((cur & val) != val) {
+					state[u] = UNIT_ERASE;
+					break;
+				}
+				state[u] = UNIT_PROG;
+			}
+			if (state[u] == UNIT_SAME)
+				nb_same++;
+			else if (state[u] == UNIT_PROG)
+				nb_prog++;
+			else
+				nb_erase++;
+		}
+
+		/* erase consecutive dirty units with the cheapest erase mix */
+		for (int u = 0; u < nb_units; u++) {
+			if (state[u] != UNIT_ERASE)
+				continue;
+			int v = u;
+			while (v < nb_units && state[v] == UNIT_ERASE)
+				v++;
+			erase_plan(blk + u * unit, blk + v * unit, plan);
+			for (auto &op : plan) {
+				if (erase_unit(op.first, op.second) == -1) {
+					progress.fail();
+					return -1;
+				}
+			}
+			memset(flash.data() + u * unit, 0xff, (v - u) * unit);
+			u = v;
+		}
+
+		/* write only pages differing from flash content */
+		for (int addr = rlo, size; addr < rhi; addr += size) {
+			size = page_size - (addr % page_size);
+			if (addr + size > rhi)
+				size = rhi - addr;
+			uint8_t *ptr = want.data() + (addr - blk);
+			if (memcmp(flash.data() + (addr - blk), ptr, size) == 0)
+				continue;
+			if (write_page(addr, ptr, size) == -1) {
+				progress.fail();
+				return -1;
+			}
+		}
+		progress.display(hi - base_addr);
+	}
+	progress.done();
+
+	printInfo("flash diff: " + std::to_string(nb_same) + " unchanged, " +
+		std::to_string(nb_prog) + " written without erase, " +
+		std::to_string(nb_erase) + " erased (" + std::to_string(unit / 1024) +
+		"KB units)");
+	return 0;
+}
+
 bool SPIFlash::verify(const int &base_addr, const uint8_t *data,
 		const int &len, int rd_burst)
 {
-	if (rd_burst == 0)
-		rd_burst = len;
+	UsbStatsPhase phase(UsbStats::PHASE_VERIFY);
+	if (rd_burst == 0 || rd_burst > FLASH_RD_CHUNK)
+		rd_burst = FLASH_RD_CHUNK;
 
 	printInfo("Verifying write (May take time)");
 
-	std::string verify_data;
-	verify_data.resize(rd_burst);
+	std::vector<uint8_t> verify_data(rd_burst);
 
 	ProgressBar progress("Read flash ", len, 50, false);
 	for (int i = 0; i < len; i += rd_burst) {
 		if (rd_burst + i > len)
 			rd_burst = len - i;
-		if (0 != read(base_addr + i, (uint8_t*)&verify_data[0], rd_burst)) {
+		if (0 != read(base_addr + i, verify_data.data(), rd_burst)) {
 			progress.fail();
 			printError("Failed to read flash");
 			return false;
 		}
 
-
-		for (int ii = 0; ii < rd_burst; ii++) {
-			if ((uint8_t)verify_data[ii] != data[i+ii]) {
-				progress.fail();
-				printError("Verification failed at " +
-						std::to_string(base_addr + i + ii));
-				return false;
-			}
+		if (memcmp(verify_data.data(), data + i, rd_burst) != 0) {
+			int ii = 0;
+			while (verify_data[ii] == data[i + ii])
+				ii++;
+			progress.fail();
+			printError("Verification failed at " +
+					std::to_string(base_addr + i + ii));
+			return false;
 		}
 		progress.display(i);
 	}
@@ -469,6 +834,312 @@ void SPIFlash::read_id()
 			}
 		}
 	}
+
+	init_param();
+}
+
+void SPIFlash::init_param()
+{
+	/* database entry or conservative defaults: 64KB erase, 3-byte address */
+	_param.size = (_flash_model) ? _flash_model->nr_sector * 0x10000 : 0;
+	/* SST25VF040B: byte program */
+	_param.page_size = ((_jedec_id >> 8) == 0xbf258d) ? 1 : 256;
+	_param.addr_mode = (_flash_model) ? _flash_model->addr_mode : ADDR_3B;
+	_param.erase[0] = (_flash_model) ? _flash_model->subsector_erase : false;
+	_param.erase[1] = (_flash_model) ? _flash_model->block32_erase : false;
+	_param.erase[2] = (_flash_model) ? _flash_model->sector_erase : true;
+	_param.erase_typ_us[0] = FLASH_TSE_TYP_US;
+	_param.erase_typ_us[1] = FLASH_TBE32_TYP_US;
+	_param.erase_typ_us[2] = FLASH_TBE_TYP_US;
+	_param.erase_max_us[0] = FLASH_TSE_US;
+	_param.erase_max_us[1] = FLASH_TBE32_US;
+	_param.erase_max_us[2] = FLASH_TBE_US;
+	_param.pp_max_us = FLASH_TPP_US;
+	_param.ce_typ_us = 0;
+	_param.ce_max_us = static_cast<uint64_t>(FLASH_TCE_US) *
+		((_flash_model) ? _flash_model->nr_sector : 512);
+
+	flash_param_t sfdp = _param;
+	if (!load_param_cache(sfdp)) {
+		if (!sfdp_param(sfdp)) {
+			db_timings();
+			return;
+		}
+		save_param_cache(sfdp);
+	}
+
+	/* timings come from the chip itself (database ones win, see db_timings) */
+	for (int i = 0; i < 3; i++) {
+		_param.erase_typ_us[i] = sfdp.erase_typ_us[i];
+		_param.erase_max_us[i] = sfdp.erase_max_us[i];
+	}
+	_param.pp_max_us = sfdp.pp_max_us;
+	_param.ce_typ_us = sfdp.ce_typ_us;
+	_param.ce_max_us = sfdp.ce_max_us;
+	if (_param.page_size != 1)
+		_param.page_size = sfdp.page_size;
+
+	/* geometry: database entry wins */
+	if (!_flash_model) {
+		_param.size = sfdp.size;
+		_param.addr_mode = sfdp.addr_mode;
+		for (int i = 0; i < 3; i++)
+			_param.erase[i] = sfdp.erase[i];
+		char content[128];
+		snprintf(content, 128, "SFDP: size %uKB, page %uB, erase%s%s%s",
+			_param.size / 1024, _param.page_size,
+			(_param.erase[0]) ? " 4KB" : "", (_param.erase[1]) ? " 32KB" : "",
+			(_param.erase[2]) ? " 64KB" : "");
+		printInfo(content);
+	}
+
+	db_timings();
+}
+
+void SPIFlash::db_timings()
+{
+	if (!_flash_model)
+		return;
+	if (_flash_model->pp_max_us != 0)
+		_param.pp_max_us = _flash_model->pp_max_us;
+	for (int i = 0; i < 3; i++) {
+		if (_flash_model->erase_max_us[i] != 0)
+			_param.erase_max_us[i] = _flash_model->erase_max_us[i];
+	}
+	if (_flash_model->ce_max_us != 0)
+		_param.ce_max_us = _flash_model->ce_max_us;
+	for (int i = 0; i < 3; i++) {
+		if (_flash_model->erase_typ_us[i] != 0)
+			_param.erase_typ_us[i] = _flash_model->erase_typ_us[i];
+	}
+	if (_flash_model->ce_typ_us != 0)
+		_param.ce_typ_us = _flash_model->ce_typ_us;
+}
+
+int SPIFlash::read_sfdp(int addr, uint8_t *data, int len)
+{
+	uint8_t tx[3] = {
+		static_cast<uint8_t>(0xff & (addr >> 16)),
+		static_cast<uint8_t>(0xff & (addr >>  8)),
+		static_cast<uint8_t>(0xff & (addr      ))};
+	const SPIInterface::spi_seg_t seg[3] = {
+		{tx, NULL, 3},
+		{NULL, NULL, 1},
+		{NULL, data, static_cast<uint32_t>(len)}};
+	return _spi->spi_xfer(FLASH_RDSFDP, seg, 3);
+}
+
+/* SFDP durations: (count + 1) * unit, count on count_bits bits
+ * followed by unit index
+ */
+static uint64_t sfdp_time(uint32_t val, int count_bits, const uint64_t *units)
+{
+	uint32_t count = val & ((1 << count_bits) - 1);
+	return (count + 1) * units[val >> count_bits];
+}
+
+bool SPIFlash::sfdp_param(flash_param_t &param)
+{
+	/* header: signature, revision, number of parameter headers - 1 */
+	uint8_t hdr[8];
+	if (read_sfdp(0, hdr, 8) != 0)
+		return false;
+	uint32_t sig = hdr[0] | (hdr[1] << 8) | (hdr[2] << 16) |
+		(static_cast<uint32_t>(hdr[3]) << 24);
+	if (sig != SFDP_SIGNATURE)
+		return false;
+
+	/* parameter headers: ID LSB, minor, major, length (DWORDs),
+	 * pointer (3 Bytes), ID MSB
+	 */
+	int nb_hdr = hdr[6] + 1;
+	std::vector<uint8_t> ph(8 * nb_hdr);
+	if (read_sfdp(8, ph.data(), ph.size()) != 0)
+		return false;
+	uint32_t bfpt_ptr = 0;
+	int bfpt_len = 0;
+	bool sector_map = false;
+	for (int i = 0; i < nb_hdr; i++) {
+		const uint8_t *h = &ph[8 * i];
+		uint16_t id = (h[7] << 8) | h[0];
+		if (id == SFDP_BFPT_ID && h[3] > bfpt_len) {
+			bfpt_len = h[3];
+			bfpt_ptr = h[4] | (h[5] << 8) | (h[6] << 16);
+		} else if (id == SFDP_SMPT_ID) {
+			sector_map = true;
+		}
+	}
+	/* JESD216 first revision: 9 DWORDs, JESD216B: 16 DWORDs */
+	if (bfpt_len < 9)
+		return false;
+	if (bfpt_len > 16)
+		bfpt_len = 16;
+
+	uint8_t raw[64];
+	if (read_sfdp(bfpt_ptr, raw, 4 * bfpt_len) != 0)
+		return false;
+	uint32_t dw[16] = {0};
+	for (int i = 0; i < bfpt_len; i++)
+		dw[i] = raw[4 * i] | (raw[4 * i + 1] << 8) | (raw[4 * i + 2] << 16) |
+			(static_cast<uint32_t>(raw[4 * i + 3]) << 24);
+
+	/* DW2: density in bits */
+	uint64_t bits = (dw[1] & 0x80000000) ? (1ULL << (dw[1] & 0x7fffffff)) :
+		static_cast<uint64_t>(dw[1]) + 1;
+	if (bits < 8 || bits / 8 > 0x80000000ULL)
+		return false;
+	param.size = bits / 8;
+
+	/* DW10: erase types typical time and max multiplier */
+	static const uint64_t erase_units[] = {1000, 16000, 128000, 1000000};
+	uint32_t erase_mult = 2 * ((dw[9] & 0x0f) + 1);
+
+	/* DW8-9: erase types size (2^N) and opcode. Only standard opcodes
+	 * are used, and with a sector map (non uniform) only 64KB erase
+	 */
+	static const uint8_t erase_cmd[] = {FLASH_SE, FLASH_BE32, FLASH_BE64};
+	for (int i = 0; i < 3; i++)
+		param.erase[i] = false;
+	for (int t = 0; t < 4; t++) {
+		uint32_t type = (dw[7 + t / 2] >> (16 * (t % 2))) & 0xffff;
+		int size_n = type & 0xff;
+		if (size_n != 12 && size_n != 15 && size_n != 16)
+			continue;
+		int idx = erase_idx(1 << size_n);
+		if ((type >> 8) != erase_cmd[idx] || (sector_map && idx != 2))
+			continue;
+		param.erase[idx] = true;
+		if (bfpt_len >= 10) {
+			uint64_t typ = sfdp_time((dw[9] >> (4 + 7 * t)) & 0x7f, 5,
+				erase_units);
+			param.erase_typ_us[idx] = typ;
+			param.erase_max_us[idx] = typ * erase_mult;
+		}
+	}
+	if (!param.erase[0] && !param.erase[1] && !param.erase[2])
+		return false;
+
+	/* DW11: page size, page program and chip erase times */
+	if (bfpt_len >= 11) {
+		static const uint64_t pp_units[] = {8, 64};
+		static const uint64_t ce_units[] = {16000, 256000, 4000000, 64000000};
+		param.page_size = 1 << ((dw[10] >> 4) & 0x0f);
+		param.pp_max_us = sfdp_time((dw[10] >> 8) & 0x3f, 5, pp_units) *
+			2 * ((dw[10] & 0x0f) + 1);
+		param.ce_typ_us = sfdp_time((dw[10] >> 24) & 0x7f, 5, ce_units);
+		param.ce_max_us = param.ce_typ_us * erase_mult;
+	}
+
+	/* DW16: methods to reach addresses above 16MB */
+	param.addr_mode = ADDR_3B;
+	if (param.size > 0x1000000 && bfpt_len >= 16) {
+		uint8_t en4b = dw[15] >> 24;
+		if (en4b & (1 << 5))
+			param.addr_mode = ADDR_4B_OPCODES;
+		else if (en4b & 0x03)
+			param.addr_mode = ADDR_EN4B;
+		else if (en4b & (1 << 2))
+			param.addr_mode = ADDR_EAR;
+	}
+
+	return true;
+}
+
+/* SFDP cache file: one file by JEDEC ID */
+static std::string param_cache_path(uint32_t jedec_id)
+{
+	std::string dir = cache_dir();
+	if (dir.empty())
+		return "";
+	char name[32];
+	snprintf(name, sizeof(name), "/sfdp_%06x.txt", jedec_id & 0xffffff);
+	return dir + name;
+}
+
+bool SPIFlash::load_param_cache(flash_param_t &param)
+{
+	std::string path = param_cache_path(_jedec_id >> 8);
+	if (path.empty())
+		return false;
+	std::ifstream fd(path);
+	if (!fd.is_open())
+		return false;
+
+	flash_param_t p = param;
+	int fields = 0;
+	std::string line;
+	while (std::getline(fd, line)) {
+		unsigned int val, size, mode;
+		unsigned long long typ, max;
+		if (line.empty() || line[0] == '#')
+			continue;
+		if (sscanf(line.c_str(), "size %u", &val) == 1) {
+			p.size = val;
+			fields |= 1 << 0;
+		} else if (sscanf(line.c_str(), "page_size %u", &val) == 1 &&
+				val != 0) {
+			p.page_size = val;
+			fields |= 1 << 1;
+		} else if (sscanf(line.c_str(), "addr_mode %u", &mode) == 1 &&
+				mode <= ADDR_EAR) {
+			p.addr_mode = static_cast<addr_mode_t>(mode);
+			fields |= 1 << 2;
+		} else if (sscanf(line.c_str(), "erase %u %llu %llu", &size, &typ,
+				&max) == 3 && (size == 0x1000 || size == 0x8000 ||
+				size == 0x10000)) {
+			int idx = erase_idx(size);
+			if (!(fields & (1 << 3))) {
+				for (int i = 0; i < 3; i++)
+					p.erase[i] = false;
+			}
+			p.erase[idx] = true;
+			p.erase_typ_us[idx] = typ;
+			p.erase_max_us[idx] = max;
+			fields |= 1 << 3;
+		} else if (sscanf(line.c_str(), "program %llu", &max) == 1) {
+			p.pp_max_us = max;
+			fields |= 1 << 4;
+		} else if (sscanf(line.c_str(), "chip %llu %llu", &typ, &max) == 2) {
+			p.ce_typ_us = typ;
+			p.ce_max_us = max;
+			fields |= 1 << 5;
+		} else {
+			return false;
+		}
+	}
+	if (fields != 0x3f)
+		return false;
+
+	param = p;
+	return true;
+}
+
+void SPIFlash::save_param_cache(const flash_param_t &param)
+{
+	std::string path = param_cache_path(_jedec_id >> 8);
+	if (path.empty())
+		return;
+	std::ofstream fd(path);
+	if (!fd.is_open())
+		return;
+	char line[128];
+	snprintf(line, sizeof(line),
+		"# openFPGALoader SFDP parameters, JEDEC ID %06x\n"
+		"size %u\npage_size %u\naddr_mode %u\n",
+		_jedec_id >> 8, param.size, param.page_size, param.addr_mode);
+	fd << line;
+	static const unsigned int sizes[] = {0x1000, 0x8000, 0x10000};
+	for (int i = 0; i < 3; i++) {
+		if (!param.erase[i])
+			continue;
+		snprintf(line, sizeof(line), "erase %u %u %u\n", sizes[i],
+			param.erase_typ_us[i], param.erase_max_us[i]);
+		fd << line;
+	}
+	snprintf(line, sizeof(line), "program %u\nchip %llu %llu\n",
+		param.pp_max_us, static_cast<unsigned long long>(param.ce_typ_us),
+		static_cast<unsigned long long>(param.ce_max_us));
+	fd << line;
 }
 
 void SPIFlash::display_status_reg(uint8_t reg)
@@ -600,7 +1271,8 @@ int SPIFlash::disable_protection()
 	if (write_enable() == -1)
 		return -1;
 	_spi->spi_put(FLASH_WRSR, &data, NULL, 1);
-	if (_spi->spi_wait(FLASH_RDSR, 0xff, 0, 1000) < 0)
+	if (_spi->spi_wait(FLASH_RDSR, 0xff, 0,
+		wait_tries(FLASH_TW_US, 1000)) < 0)
 		return -1;
 
 	/* read status */
@@ -691,7 +1363,8 @@ int SPIFlash::enable_protection(uint32_t length)
 		uint8_t cfg[2] = {bp, status};
 		cfg[1] |= _flash_model->tb_offset;
 		_spi->spi_put(FLASH_WRSR, cfg, NULL, 2);
-		if (_spi->spi_wait(FLASH_RDSR, 0x03, 0, 1000) < 0) {
+		if (_spi->spi_wait(FLASH_RDSR, 0x03, 0,
+				wait_tries(FLASH_TW_US, 1000)) < 0) {
 			printError("Error: enable protection failed\n");
 			return -1;
 		}
@@ -727,7 +1400,8 @@ int SPIFlash::enable_protection(uint32_t length)
 
 		/* write status register and wait until Flash idle */
 		_spi->spi_put(reg_wr, &val, NULL, 1);
-		if (_spi->spi_wait(FLASH_RDSR, 0x03, 0, 1000) < 0) {
+		if (_spi->spi_wait(FLASH_RDSR, 0x03, 0,
+				wait_tries(FLASH_TW_US, 1000)) < 0) {
 			printError("Error: enable protection failed\n");
 			return -1;
 		}
@@ -845,7 +1519,8 @@ bool SPIFlash::global_unlock()
 		return false;
 	_spi->spi_put(FLASH_ULBPR, NULL, NULL, 0);
 
-	if (_spi->spi_wait(FLASH_RDSR, 0xff, 0, 1000) < 0)
+	if (_spi->spi_wait(FLASH_RDSR, 0xff, 0,
+		wait_tries(FLASH_TW_US, 1000)) < 0)
 		return false;
 
 	/* check if all sectors are unlocked */
@@ -6,15 +6,41 @@
 #ifndef SRC_SPIFLASH_HPP_
 #define SRC_SPIFLASH_HPP_
 
+#include <exception>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "display.hpp"
 #include "spiInterface.hpp"
 #include "spiFlashdb.hpp"
 
+/*!
+ * \brief flash geometry and timings used by SPIFlash: from database
+ *        entry, SFDP tables or conservative defaults
+ */
+typedef struct {
+	uint32_t size;            /**< flash size (Byte), 0: unknown */
+	uint32_t page_size;       /**< page program size (Byte) */
+	addr_mode_t addr_mode;    /**< access above 16MB */
+	bool erase[3];            /**< 4KB, 32KB and 64KB erase support */
+	uint32_t erase_typ_us[3]; /**< 4KB, 32KB and 64KB typical erase time */
+	uint32_t erase_max_us[3]; /**< 4KB, 32KB and 64KB maximum erase time */
+	uint32_t pp_max_us;       /**< maximum page program time */
+	uint64_t ce_typ_us;       /**< typical chip erase time, 0: unknown */
+	uint64_t ce_max_us;       /**< maximum chip erase time */
+} flash_param_t;
+
 class SPIFlash {
 	public:
 		SPIFlash(SPIInterface *spi, bool unprotect, int8_t verbose);
+		/*!
+		 * \brief restore 3-byte addressing / extended address 0,
+		 *        must be called before the FPGA leaves reset
+		 * \return -1 if write enable or mode change fails
+		 */
+		int restore_addr_mode();
 		/* power */
 		virtual void power_up();
 		virtual void power_down();
@@ -60,12 +86,18 @@ class SPIFlash {
 		 */
 		int block64_erase(int addr);
 		/*!
-		 * \brief erase n sectors starting at base_addr
+		 * \brief erase area starting at base_addr with the fastest
+		 *        mix of 4KB/32KB/64KB/chip erase. Content sharing an
+		 *        erase unit with the area but outside it is kept
 		 */
 		int sectors_erase(int base_addr, int len);
 		/* write */
 		int write_page(int addr, uint8_t *data, int len);
-		/* read */
+		/*!
+		 * \brief read len Byte with fast read command, split in
+		 *        commands of bounded size
+		 * \return 0 when success
+		 */
 		int read(int base_addr, uint8_t *data, int len);
 		/*!
 		 * \brief read len Byte starting at base_addr and store
@@ -80,6 +112,14 @@ class SPIFlash {
 				const int &len, int rd_burst = 0);
 		/* combo flash + erase */
 		int erase_and_prog(int base_addr, uint8_t *data, int len);
+		/*!
+		 * \brief select erase_and_prog mode for all instances: when
+		 *        enabled flash content is read first, unchanged erase
+		 *        units are skipped and units where only bits 1->0 change
+		 *        are written without erase
+		 * \param[in] en: enable differential mode
+		 */
+		static void set_differential(bool en) {_differential = en;}
 		/*!
 		 * \brief check if area base_addr to base_addr + len match
 		 *        data content
@@ -129,12 +169,125 @@ class SPIFlash {
 		 * \return bp code (based on chip bp[x] position)
 		 */
 		uint8_t len_to_bp(uint32_t len);
+		/*!
+		 * \brief erase one 4KB sector, 32KB or 64KB block and wait
+		 * \param[in] addr: sector/block address
+		 * \param[in] size: 0x1000, 0x8000 or 0x10000
+		 * \return -1 if write enable, erase or wait fails
+		 */
+		int erase_unit(int addr, int size);
+		/*!
+		 * \brief check if the flash supports an erase size
+		 * \param[in] size: 0x1000, 0x8000 or 0x10000
+		 */
+		bool erase_supported(int size);
+		/*!
+		 * \brief smallest supported erase size
+		 */
+		int erase_min_size();
+		/*!
+		 * \brief compute erase sequence with minimal typical duration
+		 * \param[in] start_addr: first address, erase_min_size() aligned
+		 * \param[in] end_addr: last address + 1, erase_min_size() aligned
+		 * \param[out] plan: list of (address, size) erase_unit arguments
+		 */
+		void erase_plan(int start_addr, int end_addr,
+				std::vector<std::pair<int, int>> &plan);
+		/*!
+		 * \brief write len Byte split on page boundaries, blank pages
+		 *        are skipped (area must be erased)
+		 * \return -1 if a page write fails
+		 */
+		int write_range(int addr, const uint8_t *data, int len);
+		/*!
+		 * \brief select addressing able to reach addr: enter 4-byte
+		 *        mode or update extended address register, depending
+		 *        on flash model
+		 * \return -1 if mode change fails
+		 */
+		int set_addr_mode(int addr);
+		/*!
+		 * \brief write extended address register (address bits 31:24)
+		 * \return -1 if write enable or write fails
+		 */
+		int set_ear(uint8_t ear);
+		/*!
+		 * \brief build command header: opcode (4-byte address variant
+		 *        when required) followed by 3 or 4 address bytes
+		 * \param[in] cmd: 3-byte address opcode
+		 * \param[in] addr: flash address
+		 * \param[out] hdr: header, at least 5 Bytes
+		 * \return header length, -1 if addressing mode can't be set
+		 */
+		int addr_cmd(uint8_t cmd, int addr, uint8_t *hdr);
+		/*!
+		 * \brief fill _param from database entry and SFDP (cached
+		 *        by JEDEC ID): timings always come from SFDP,
+		 *        geometry only for chips missing in database
+		 */
+		void init_param();
+		/*!
+		 * \brief read SFDP area (3-byte address, 8 dummy cycles)
+		 * \return 0 when success
+		 */
+		int read_sfdp(int addr, uint8_t *data, int len);
+		/*!
+		 * \brief read and decode SFDP Basic Flash Parameter Table,
+		 *        fields not described keep their value
+		 * \param[in,out] param: flash parameters
+		 * \return false if SFDP is not supported
+		 */
+		bool sfdp_param(flash_param_t &param);
+		/*!
+		 * \brief load/save SFDP decoded parameters for current
+		 *        JEDEC ID from/to the cache directory
+		 * \return false if no cache file is available
+		 */
+		bool load_param_cache(flash_param_t &param);
+		void save_param_cache(const flash_param_t &param);
+		/*!
+		 * \brief override _param timings with the database entry
+		 *        ones, when known
+		 */
+		void db_timings();
+		/*!
+		 * \brief differential erase_and_prog: only erase/write units
+		 *        whose content differs from data
+		 */
+		int diff_prog(int base_addr, const uint8_t *data, int len);
+
+		static bool _differential; /**< erase_and_prog mode */
 
 		SPIInterface *_spi;
 		int8_t _verbose;
 		uint32_t _jedec_id; /**< CHIP ID */
 		flash_t *_flash_model; /**< detect flash model */
 		bool _unprotect; /**< allows to unprotect memory before write */
+		bool _addr4_en; /**< 4-byte address mode entered (EN4B) */
+		uint8_t _ear; /**< extended address register content */
+		flash_param_t _param; /**< geometry and timings */
+};
+
+/*!
+ * \brief restore flash 3-byte addressing when leaving scope, including
+ *        on exception or early return. Must be destroyed before the
+ *        FPGA leaves reset
+ */
+class SPIFlashAddrGuard {
+	public:
+		explicit SPIFlashAddrGuard(SPIFlash &flash): _flash(flash) {}
+		~SPIFlashAddrGuard()
+		{
+			try {
+				if (_flash.restore_addr_mode() != 0)
+					printError("Error: failed to restore flash address mode");
+			} catch (std::exception &e) {
+				printError("Error: failed to restore flash address mode: " +
+					std::string(e.what()));
+			}
+		}
+	private:
+		SPIFlash &_flash;
 };
 
 #endif  // SRC_SPIFLASH_HPP_
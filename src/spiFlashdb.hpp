@@ -18,12 +18,19 @@ typedef enum {
 	NONER = 99, /* "none" register */
 } tb_loc_t;
 
+typedef enum {
+	ADDR_3B = 0,      /* 3-byte address only (up to 16MB) */
+	ADDR_4B_OPCODES,  /* dedicated 4-byte address opcodes */
+	ADDR_EN4B,        /* 4-byte address mode (EN4B/EX4B) */
+	ADDR_EAR,         /* 3-byte address + extended address register */
+} addr_mode_t;
+
 typedef struct {
 	std::string manufacturer; /**< manufacturer name */
 	std::string model;        /**< chip name */
 	uint32_t nr_sector;       /**< number of sectors */
 	bool sector_erase;        /**< 64KB erase support */
-	/* missing 32KB erase */
+	bool block32_erase;       /**< 32KB erase support */
 	bool subsector_erase;     /**< 4KB erase support */
 	bool has_extended;
 	bool tb_otp;              /**< TOP/BOTTOM One Time Programming */
@@ -31,6 +38,14 @@ typedef struct {
 	tb_loc_t tb_register;     /**< TOP/BOTTOM location (register) */
 	uint8_t bp_len;           /**< BPx length */
 	uint8_t bp_offset[4];     /**< BP[0:3] bit offset */
+	addr_mode_t addr_mode;    /**< access above 16MB */
+	/* datasheet maximum timings (us), 0: unknown (SFDP or default) */
+	uint32_t pp_max_us;       /**< page program */
+	uint32_t erase_max_us[3]; /**< 4KB/32KB/64KB erase */
+	uint32_t ce_max_us;       /**< chip erase */
+	/* datasheet typical timings (us), used by the erase planner */
+	uint32_t erase_typ_us[3]; /**< 4KB/32KB/64KB erase */
+	uint32_t ce_typ_us;       /**< chip erase */
 } flash_t;
 
 static std::map <uint32_t, flash_t> flash_list = {
@@ -39,208 +54,320 @@ static std::map <uint32_t, flash_t> flash_list = {
 		.model = "S25FL064P / EPCS64",
 		.nr_sector = 128,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = true,
 		.has_extended = true,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
 		.tb_register = CONFR,
 		.bp_len = 3,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 0,
+		.erase_max_us = {0, 0, 0},
+		.ce_max_us = 0,
+		.erase_typ_us = {0, 0, 0},
+		.ce_typ_us = 0}
 	},
 	{0x010219, {
 		.manufacturer = "spansion",
 		.model = "S25FL256S",
 		.nr_sector = 512,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = false,
 		.has_extended = true,
 		.tb_otp = true,
 		.tb_offset = (1 << 5),
 		.tb_register = CONFR,
 		.bp_len = 3,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0},
+		.addr_mode = ADDR_4B_OPCODES,
+		.pp_max_us = 0,
+		.erase_max_us = {0, 0, 0},
+		.ce_max_us = 0,
+		.erase_typ_us = {0, 0, 0},
+		.ce_typ_us = 0}
 	},
 	{0x012018, {
 		.manufacturer = "spansion",
 		.model = "S25FL128S",
 		.nr_sector = 256,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = false,
 		.has_extended = true,
 		.tb_otp = true,
 		.tb_offset = (1 << 5),
 		.tb_register = CONFR,
 		.bp_len = 3,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 0,
+		.erase_max_us = {0, 0, 0},
+		.ce_max_us = 0,
+		.erase_typ_us = {0, 0, 0},
+		.ce_typ_us = 0}
 	},
 	{0x016019, {
 		.manufacturer = "spansion",
 		.model = "S25FL256L",
 		.nr_sector = 512,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = false,
 		.has_extended = true,
 		.tb_otp = false,
 		.tb_offset = (1 << 6),
 		.tb_register = STATR,
 		.bp_len = 4,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 5)}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 5)},
+		.addr_mode = ADDR_4B_OPCODES,
+		.pp_max_us = 0,
+		.erase_max_us = {0, 0, 0},
+		.ce_max_us = 0,
+		.erase_typ_us = {0, 0, 0},
+		.ce_typ_us = 0}
 	},
 	{0x0020ba16, {
 		.manufacturer = "micron",
 		.model = "N25Q32",
 		.nr_sector = 64,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = true,
 		.has_extended = true,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
 		.tb_register = STATR,
 		.bp_len = 3,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 5000,
+		.erase_max_us = {800000, 0, 3000000},
+		.ce_max_us = 60000000,
+		.erase_typ_us = {250000, 0, 700000},
+		.ce_typ_us = 30000000}
 	},
 	{0x0020ba18, {
 		.manufacturer = "micron",
 		.model = "N25Q128",
 		.nr_sector = 256,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = true,
 		.has_extended = true,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
 		.tb_register = STATR,
 		.bp_len = 4,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 6)}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 6)},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 5000,
+		.erase_max_us = {800000, 0, 3000000},
+		.ce_max_us = 250000000,
+		.erase_typ_us = {250000, 0, 700000},
+		.ce_typ_us = 170000000}
 	},
 	{0x0020ba19, {
 		.manufacturer = "micron",
 		.model = "N25Q256",
 		.nr_sector = 512,
 		.sector_erase = true,
+		.block32_erase = false,
 		.subsector_erase = true,
 		.has_extended = true,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
 		.tb_register = STATR,
 		.bp_len = 4,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 6)}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 6)},
+		.addr_mode = ADDR_EN4B,
+		.pp_max_us = 5000,
+		.erase_max_us = {800000, 0, 3000000},
+		.ce_max_us = 480000000,
+		.erase_typ_us = {250000, 0, 700000},
+		.ce_typ_us = 240000000}
 	},
 	{0xbf258d, {
 		.manufacturer = "microchip",
 		.model = "SST25VF040B",
 		.nr_sector = 8,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
 		.has_extended = false,
 		.tb_otp = false,
 		.tb_offset = 0,
 		.tb_register = NONER,
 		.bp_len = 4,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 5)}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 5)},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 10,
+		.erase_max_us = {25000, 25000, 25000},
+		.ce_max_us = 50000,
+		.erase_typ_us = {18000, 18000, 18000},
+		.ce_typ_us = 35000}
 	},
 	{0xBF2642, {
 		.manufacturer = "microchip",
 		.model = "SST26VF032B",
 		.nr_sector = 64,
 		.sector_erase = false,
+		.block32_erase = false,
 		.subsector_erase = true,
 		.has_extended = false,
 		.tb_otp = false,
 		.tb_offset = 0,
 		.tb_register = NONER,
 		.bp_len = 0,
-		.bp_offset = {0, 0, 0, 0}}
+		.bp_offset = {0, 0, 0, 0},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 1500,
+		.erase_max_us = {25000, 25000, 25000},
+		.ce_max_us = 50000,
+		.erase_typ_us = {18000, 18000, 18000},
+		.ce_typ_us = 35000}
 	},
 	{0x9d6016, {
 		.manufacturer = "ISSI",
 		.model = "IS25LP032",
 		.nr_sector = 64,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
 		.has_extended = false,
 		.tb_otp = true,
 		.tb_offset = (1 << 1),
 		.tb_register = FUNCR,
 		.bp_len = 4,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 5)}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 5)},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 0,
+		.erase_max_us = {0, 0, 0},
+		.ce_max_us = 0,
+		.erase_typ_us = {0, 0, 0},
+		.ce_typ_us = 0}
 	},
 	{0x9d6017, {
 		.manufacturer = "ISSI",
 		.model = "IS25LP064",
 		.nr_sector = 128,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
 		.has_extended = false,
 		.tb_otp = true,
 		.tb_offset = (1 << 1),
 		.tb_register = FUNCR,
 		.bp_len = 4,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 5)}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 5)},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 0,
+		.erase_max_us = {0, 0, 0},
+		.ce_max_us = 0,
+		.erase_typ_us = {0, 0, 0},
+		.ce_typ_us = 0}
 	},
 	{0x9d6018, {
 		.manufacturer = "ISSI",
 		.model = "IS25LP128",
 		.nr_sector = 256,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
 		.has_extended = false,
 		.tb_otp = true,
 		.tb_offset = (1 << 1),
 		.tb_register = FUNCR,
 		.bp_len = 4,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 5)}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), (1 << 5)},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 0,
+		.erase_max_us = {0, 0, 0},
+		.ce_max_us = 0,
+		.erase_typ_us = {0, 0, 0},
+		.ce_typ_us = 0}
 	},
 	{0xef4015, {
 		.manufacturer = "Winbond",
 		.model = "W25Q16",
 		.nr_sector = 32,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
 		.has_extended = false,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
 		.tb_register = STATR,
 		.bp_len = 3,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 3000,
+		.erase_max_us = {400000, 1600000, 2000000},
+		.ce_max_us = 25000000,
+		.erase_typ_us = {45000, 120000, 150000},
+		.ce_typ_us = 5000000}
 	},
 	{0xef4016, {
 		.manufacturer = "Winbond",
 		.model = "W25Q32",
 		.nr_sector = 64,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
 		.has_extended = false,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
 		.tb_register = STATR,
 		.bp_len = 3,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 3000,
+		.erase_max_us = {400000, 1600000, 2000000},
+		.ce_max_us = 50000000,
+		.erase_typ_us = {45000, 120000, 150000},
+		.ce_typ_us = 10000000}
 	},
 	{0xef4017, {
 		.manufacturer = "Winbond",
 		.model = "W25Q64",
 		.nr_sector = 128,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
 		.has_extended = false,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
 		.tb_register = STATR,
 		.bp_len = 3,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 3000,
+		.erase_max_us = {400000, 1600000, 2000000},
+		.ce_max_us = 100000000,
+		.erase_typ_us = {45000, 120000, 150000},
+		.ce_typ_us = 20000000}
 	},
 	{0xef4018, {
 		.manufacturer = "Winbond",
 		.model = "W25Q128",
 		.nr_sector = 256,
 		.sector_erase = true,
+		.block32_erase = true,
 		.subsector_erase = true,
 		.has_extended = false,
 		.tb_otp = false,
 		.tb_offset = (1 << 5),
 		.tb_register = STATR,
 		.bp_len = 3,
-		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0}}
+		.bp_offset = {(1 << 2), (1 << 3), (1 << 4), 0},
+		.addr_mode = ADDR_3B,
+		.pp_max_us = 3000,
+		.erase_max_us = {400000, 1600000, 2000000},
+		.ce_max_us = 200000000,
+		.erase_typ_us = {45000, 120000, 150000},
+		.ce_typ_us = 40000000}
 	},
 };
 
@@ -3,6 +3,8 @@
  * Copyright (C) 2021 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
  */
 
+#include <string.h>
+
 #include <iostream>
 #include <vector>
 
@@ -20,6 +22,33 @@ SPIInterface::SPIInterface(const std::string &filename, uint8_t verbose,
 	_spif_verify(verify), _spif_filename(filename)
 {}
 
+int SPIInterface::spi_xfer(uint8_t cmd, const spi_seg_t *seg, int nb_seg)
+{
+	uint32_t len = 0, pos = 0;
+	bool has_rx = false;
+	for (int i = 0; i < nb_seg; i++) {
+		len += seg[i].len;
+		has_rx |= (seg[i].rx != NULL);
+	}
+
+	std::vector<uint8_t> tx(len, 0), rx((has_rx) ? len : 0);
+	for (int i = 0; i < nb_seg; pos += seg[i++].len) {
+		if (seg[i].tx)
+			memcpy(tx.data() + pos, seg[i].tx, seg[i].len);
+	}
+
+	int ret = spi_put(cmd, tx.data(), (has_rx) ? rx.data() : NULL, len);
+	if (ret != 0 || !has_rx)
+		return ret;
+
+	pos = 0;
+	for (int i = 0; i < nb_seg; pos += seg[i++].len) {
+		if (seg[i].rx)
+			memcpy(seg[i].rx, rx.data() + pos, seg[i].len);
+	}
+	return 0;
+}
+
 /* spiFlash generic acces */
 bool SPIInterface::protect_flash(uint32_t len)
 {
@@ -93,6 +122,8 @@ bool SPIInterface::write(uint32_t offset, uint8_t *data, uint32_t len,
 	/* test SPI */
 	try {
 		SPIFlash flash(this, unprotect_flash, _spif_verbose);
+		/* 3-byte addressing restored before post_flash_access */
+		SPIFlashAddrGuard addr_guard(flash);
 		flash.read_status_reg();
 		if (flash.erase_and_prog(offset, data, len) == -1)
 			ret = false;
@@ -116,6 +147,7 @@ bool SPIInterface::dump(uint32_t base_addr, uint32_t len)
 
 	try {
 		SPIFlash flash(this, false, _spif_verbose);
+		SPIFlashAddrGuard addr_guard(flash);
 		ret = flash.dump(_spif_filename, base_addr, len, _spif_rd_burst);
 	} catch (std::exception &e) {
 		printError(e.what());
@@ -9,6 +9,12 @@
 #include <iostream>
 #include <vector>
 
+/* minimal duration of one spi_wait try (one USB high-speed round trip):
+ * converters reading status faster also wait until timeout *
+ * SPI_WAIT_TRY_US is elapsed
+ */
+#define SPI_WAIT_TRY_US 125
+
 /*!
  * \file SPIInterface.hpp
  * \class SPIInterface
@@ -18,6 +24,15 @@
 
 class SPIInterface {
  public:
+	/*!
+	 * \brief part of a transfer (address, dummy bytes, payload, ...)
+	 */
+	typedef struct {
+		const uint8_t *tx;  /*!< bytes to send, NULL: don't care (0x00) */
+		uint8_t *rx;        /*!< received bytes, NULL: discarded */
+		uint32_t len;       /*!< number of bytes */
+	} spi_seg_t;
+
 	SPIInterface();
 	SPIInterface(const std::string &filename, uint8_t verbose,
 			uint32_t rd_burst, bool verify);
@@ -73,12 +88,24 @@ class SPIInterface {
 	 */
 	virtual int spi_put(uint8_t *tx, uint8_t *rx, uint32_t len) = 0;
 
+	/*!
+	 * \brief send a command followed by segments, CS stays low during
+	 *        the whole transfer. Default implementation gathers segments
+	 *        and uses spi_put
+	 * \param[in] cmd: command/opcode to send
+	 * \param[in] seg: segments to send/receive after cmd
+	 * \param[in] nb_seg: number of segments
+	 * \return 0 when success
+	 */
+	virtual int spi_xfer(uint8_t cmd, const spi_seg_t *seg, int nb_seg);
+
 	/*!
 	 * \brief wait until register content and mask match cond, or timeout
 	 * \param[in] cmd: register to read
 	 * \param[in] mask: mask used with read byte
 	 * \param[in] cond: condition to wait
-	 * \param[in] timeout: number of try before fail
+	 * \param[in] timeout: number of try before fail (and at least
+	 *            timeout * SPI_WAIT_TRY_US)
 	 * \return 0 when success, -ETIME when timeout occur
 	 */
 	virtual int spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
@@ -12,10 +12,12 @@
 #include <vector>
 #include <string>
 
+#include "bitOps.hpp"
 #include "display.hpp"
 #include "usbBlaster.hpp"
 #include "ftdipp_mpsse.hpp"
 #include "fx2_ll.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -201,10 +203,11 @@ int UsbBlaster::writeTDI(uint8_t *tx, uint8_t *rx, uint32_t len, bool end)
 			if (rx)
 				rx_ptr += num_read;
 		}
+		uint8_t tdi_bits[8] = {0};
+		if (tx)
+			expandBits(tdi_bits, tx_ptr, nb_bit);
 		for (uint32_t i = 0; i < nb_bit; i++) {
-			uint8_t val = 0;
-			if (tx)
-				val |= ((tx_ptr[i >> 3] & (1 << (i & 0x07)))? _tdi_pin : 0);
+			uint8_t val = tdi_bits[i] & _tdi_pin;
 			_in_buf[_nb_bit++] = mask | val;
 			_in_buf[_nb_bit++] = mask | mode | val | _tck_pin;
 		}
@@ -390,7 +393,9 @@ int UsbBlasterI::write(uint8_t *wr_buf, int wr_len,
 {
 	int ret = 0;
 
+	uint64_t start = UsbStats::now();
 	ret = ftdi_write_data(_ftdi, wr_buf, wr_len);
+	UsbStats::write(wr_len, start);
 	if (ret != wr_len) {
 		printf("problem %d written %d\n", ret, wr_len);
 		return ret;
@@ -399,6 +404,7 @@ int UsbBlasterI::write(uint8_t *wr_buf, int wr_len,
 	if (rd_buf) {
 		int timeout = 100;
 		uint8_t byte_read = 0;
+		start = UsbStats::now();
 		while (byte_read < rd_len && timeout != 0) {
 			timeout--;
 			ret = ftdi_read_data(_ftdi, rd_buf + byte_read, rd_len - byte_read);
@@ -408,6 +414,7 @@ int UsbBlasterI::write(uint8_t *wr_buf, int wr_len,
 			}
 			byte_read += ret;
 		}
+		UsbStats::read(byte_read, start);
 
 		if (timeout == 0) {
 			printError("Error: timeout " + std::to_string(byte_read) +
@@ -463,7 +470,9 @@ int UsbBlasterII::write(uint8_t *wr_buf, int wr_len,
 {
 	int ret = 0;
 
+	uint64_t start = UsbStats::now();
 	ret = fx2->write(4, wr_buf, wr_len);
+	UsbStats::write(wr_len, start);
 	if (ret != wr_len) {
 		printf("problem %d written %d\n", ret, wr_len);
 		return ret;
@@ -479,6 +488,7 @@ int UsbBlasterII::write(uint8_t *wr_buf, int wr_len,
 
 		int timeout = 100;
 		uint8_t byte_read = 0;
+		start = UsbStats::now();
 		while (byte_read < rd_len && timeout != 0) {
 			timeout--;
 			ret = fx2->read(8, rd_buf + byte_read, rd_len - byte_read);
@@ -488,6 +498,7 @@ int UsbBlasterII::write(uint8_t *wr_buf, int wr_len,
 			}
 			byte_read += ret;
 		}
+		UsbStats::read(byte_read, start);
 
 		if (timeout == 0) {
 			printError("Error: timeout " + std::to_string(byte_read) +
@@ -66,6 +66,10 @@ class UsbBlaster : public JtagInterface {
 	 * \return number of clock cycle
 	 * */
 	int toggleClk(uint8_t tms, uint8_t tdi, uint32_t clk_len) override;
+	/* delay: host sleep (clock cycles are sent in bitbang mode) */
+	int waitUs(uint32_t min_us, uint32_t min_clocks, uint8_t tms) override {
+		return sleepUs(min_us, min_clocks, tms);
+	}
 
 	/*!
 	 * \brief return internal buffer size (in byte).
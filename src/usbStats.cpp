@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "usbStats.hpp"
+
+static UsbStats::counters_t counters[UsbStats::PHASE_MAX] = {};
+static UsbStats::phase_t cur_phase = UsbStats::PHASE_OTHER;
+static uint64_t phase_start = UsbStats::now();
+
+uint64_t UsbStats::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void UsbStats::write(uint32_t len, uint64_t start)
+{
+	counters_t &c = counters[cur_phase];
+	c.xfer++;
+	c.wr_bytes += len;
+	c.usb_ns += now() - start;
+}
+
+void UsbStats::read(uint32_t len, uint64_t start)
+{
+	counters_t &c = counters[cur_phase];
+	c.xfer++;
+	c.blocking_rd++;
+	c.rd_bytes += len;
+	c.usb_ns += now() - start;
+}
+
+void UsbStats::wait(uint64_t start)
+{
+	counters[cur_phase].usb_ns += now() - start;
+}
+
+void UsbStats::sleep(uint64_t us)
+{
+	counters[cur_phase].sleep_ns += us * 1000;
+}
+
+UsbStats::phase_t UsbStats::set_phase(phase_t phase)
+{
+	uint64_t t = now();
+	phase_t prev = cur_phase;
+	counters[cur_phase].elapsed_ns += t - phase_start;
+	phase_start = t;
+	cur_phase = phase;
+	return prev;
+}
+
+const char *UsbStats::phase_name(phase_t phase)
+{
+	switch (phase) {
+	case PHASE_OTHER:   return "other";
+	case PHASE_OPEN:    return "open";
+	case PHASE_DETECT:  return "detect";
+	case PHASE_PARSE:   return "parse";
+	case PHASE_ERASE:   return "erase";
+	case PHASE_PROGRAM: return "program";
+	case PHASE_VERIFY:  return "verify";
+	case PHASE_READ:    return "read";
+	case PHASE_BRIDGE:  return "bridge";
+	case PHASE_RESET:   return "reset";
+	default:            return "unknown";
+	}
+}
+
+UsbStats::counters_t UsbStats::get(phase_t phase)
+{
+	counters_t c = counters[phase];
+	if (phase == cur_phase)
+		c.elapsed_ns += now() - phase_start;
+	return c;
+}
+
+void UsbStats::reset()
+{
+	for (int i = 0; i < PHASE_MAX; i++)
+		counters[i] = counters_t();
+	phase_start = now();
+}
+
+static void print_counters(FILE *fd, const UsbStats::counters_t &c)
+{
+	fprintf(fd, "{\"transfers\": %llu, \"bytes_written\": %llu, "
+		"\"bytes_read\": %llu, \"blocking_reads\": %llu, "
+		"\"usb_us\": %llu, \"sleep_us\": %llu, \"elapsed_us\": %llu}",
+		static_cast<unsigned long long>(c.xfer),
+		static_cast<unsigned long long>(c.wr_bytes),
+		static_cast<unsigned long long>(c.rd_bytes),
+		static_cast<unsigned long long>(c.blocking_rd),
+		static_cast<unsigned long long>(c.usb_ns / 1000),
+		static_cast<unsigned long long>(c.sleep_ns / 1000),
+		static_cast<unsigned long long>(c.elapsed_ns / 1000));
+}
+
+/* "phases" and "total" members for one run, indent: members level */
+static void print_run(FILE *fd, const UsbStats::counters_t *c,
+		const char *indent)
+{
+	UsbStats::counters_t total = {};
+	fprintf(fd, "%s\"phases\": {\n", indent);
+	for (int i = 0; i < UsbStats::PHASE_MAX; i++) {
+		UsbStats::phase_t phase = static_cast<UsbStats::phase_t>(i);
+		fprintf(fd, "%s\t\"%s\": ", indent, UsbStats::phase_name(phase));
+		print_counters(fd, c[i]);
+		fprintf(fd, "%s\n", (i == UsbStats::PHASE_MAX - 1) ? "" : ",");
+
+		total.xfer += c[i].xfer;
+		total.wr_bytes += c[i].wr_bytes;
+		total.rd_bytes += c[i].rd_bytes;
+		total.blocking_rd += c[i].blocking_rd;
+		total.usb_ns += c[i].usb_ns;
+		total.sleep_ns += c[i].sleep_ns;
+		total.elapsed_ns += c[i].elapsed_ns;
+	}
+	fprintf(fd, "%s},\n%s\"total\": ", indent, indent);
+	print_counters(fd, total);
+	fprintf(fd, "\n");
+}
+
+static FILE *open_report(const std::string &filename,
+		const std::string &cable, uint32_t freq)
+{
+	FILE *fd = (filename == "-") ? stdout : fopen(filename.c_str(), "w");
+	if (!fd)
+		return NULL;
+	fprintf(fd, "{\n\t\"version\": \"%s\",\n\t\"cable\": \"%s\",\n"
+		"\t\"frequency\": %u,\n", VERSION, cable.c_str(), freq);
+	return fd;
+}
+
+bool UsbStats::write_json(const std::string &filename,
+		const std::string &cable, uint32_t freq)
+{
+	FILE *fd = open_report(filename, cable, freq);
+	if (!fd)
+		return false;
+
+	counters_t c[PHASE_MAX];
+	for (int i = 0; i < PHASE_MAX; i++)
+		c[i] = get(static_cast<phase_t>(i));
+	print_run(fd, c, "\t");
+	fprintf(fd, "}\n");
+
+	if (fd != stdout)
+		fclose(fd);
+	return true;
+}
+
+bool UsbStats::write_json(const std::string &filename,
+		const std::string &cable, uint32_t freq,
+		const std::vector<std::vector<counters_t>> &runs)
+{
+	FILE *fd = open_report(filename, cable, freq);
+	if (!fd)
+		return false;
+
+	fprintf(fd, "\t\"runs\": [\n");
+	for (size_t i = 0; i < runs.size(); i++) {
+		fprintf(fd, "\t\t{\n");
+		print_run(fd, runs[i].data(), "\t\t\t");
+		fprintf(fd, "\t\t}%s\n", (i == runs.size() - 1) ? "" : ",");
+	}
+	fprintf(fd, "\t]\n}\n");
+
+	if (fd != stdout)
+		fclose(fd);
+	return true;
+}
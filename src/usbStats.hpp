@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (C) 2026 openFPGALoader contributors <https://github.com/trabucayre/openFPGALoader>
+ */
+
+#ifndef SRC_USBSTATS_HPP_
+#define SRC_USBSTATS_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/*!
+ * \file usbStats.hpp
+ * \class UsbStats
+ * \brief transfer statistics collected by cable backends (USB calls
+ *        and sleeps), attributed to the current logical phase
+ */
+class UsbStats {
+ public:
+	enum phase_t {
+		PHASE_OTHER = 0,  /*!< not attributed */
+		PHASE_OPEN,       /*!< cable open and configuration */
+		PHASE_DETECT,     /*!< JTAG chain detection */
+		PHASE_PARSE,      /*!< bitstream read, decompress and parse */
+		PHASE_ERASE,      /*!< flash erase */
+		PHASE_PROGRAM,    /*!< SRAM load or flash write */
+		PHASE_VERIFY,     /*!< flash verify */
+		PHASE_READ,       /*!< flash dump */
+		PHASE_BRIDGE,     /*!< spiOverJtag bridge load */
+		PHASE_RESET,      /*!< FPGA reset / reload */
+		PHASE_MAX
+	};
+
+	typedef struct {
+		uint64_t xfer;         /*!< USB transfers */
+		uint64_t wr_bytes;     /*!< bytes sent to the converter */
+		uint64_t rd_bytes;     /*!< bytes received from the converter */
+		uint64_t blocking_rd;  /*!< reads waiting for converter answer */
+		uint64_t usb_ns;       /*!< time spent in USB calls */
+		uint64_t sleep_ns;     /*!< time spent sleeping */
+		uint64_t elapsed_ns;   /*!< wall time spent in the phase */
+	} counters_t;
+
+	/*!
+	 * \brief monotonic timestamp, used as start of a USB call
+	 * \return time (ns)
+	 */
+	static uint64_t now();
+	/*!
+	 * \brief account a write transfer
+	 * \param[in] len: bytes written
+	 * \param[in] start: timestamp before USB call (now())
+	 */
+	static void write(uint32_t len, uint64_t start);
+	/*!
+	 * \brief account a blocking read transfer
+	 * \param[in] len: bytes read
+	 * \param[in] start: timestamp before USB call (now())
+	 */
+	static void read(uint32_t len, uint64_t start);
+	/*!
+	 * \brief account time spent waiting asynchronous transfers
+	 * \param[in] start: timestamp before waiting (now())
+	 */
+	static void wait(uint64_t start);
+	/*!
+	 * \brief account a sleep
+	 * \param[in] us: sleep duration (us)
+	 */
+	static void sleep(uint64_t us);
+	/*!
+	 * \brief change current phase
+	 * \return previous phase
+	 */
+	static phase_t set_phase(phase_t phase);
+	static const char *phase_name(phase_t phase);
+	/*!
+	 * \brief counters for a phase (elapsed time up to now)
+	 */
+	static counters_t get(phase_t phase);
+	/*!
+	 * \brief clear all counters (new run)
+	 */
+	static void reset();
+	/*!
+	 * \brief write report
+	 * \param[in] filename: JSON file, "-" for stdout
+	 * \param[in] cable: cable name
+	 * \param[in] freq: requested TCK frequency (Hz)
+	 * \return false if file can't be written
+	 */
+	static bool write_json(const std::string &filename,
+		const std::string &cable, uint32_t freq);
+	/*!
+	 * \brief write report for several runs (benchmark)
+	 * \param[in] filename: JSON file, "-" for stdout
+	 * \param[in] cable: cable name
+	 * \param[in] freq: requested TCK frequency (Hz)
+	 * \param[in] runs: per run counters, indexed by phase
+	 * \return false if file can't be written
+	 */
+	static bool write_json(const std::string &filename,
+		const std::string &cable, uint32_t freq,
+		const std::vector<std::vector<counters_t>> &runs);
+};
+
+/*!
+ * \class UsbStatsPhase
+ * \brief select a phase up to end of scope (nested phases allowed)
+ */
+class UsbStatsPhase {
+ public:
+	explicit UsbStatsPhase(UsbStats::phase_t phase):
+		_prev(UsbStats::set_phase(phase)) {}
+	~UsbStatsPhase() { UsbStats::set_phase(_prev); }
+ private:
+	UsbStats::phase_t _prev;
+};
+
+#endif  // SRC_USBSTATS_HPP_
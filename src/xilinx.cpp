@@ -5,6 +5,7 @@
 
 #include <unistd.h>
 
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
@@ -24,6 +25,7 @@
 #include "xilinxMapParser.hpp"
 #include "part.hpp"
 #include "progressBar.hpp"
+#include "usbStats.hpp"
 
 Xilinx::Xilinx(Jtag *jtag, const std::string &filename,
 	const std::string &file_type,
@@ -191,7 +193,7 @@ void Xilinx::reset()
 	_jtag->shiftIR(JSHUTDOWN, 6);
 	_jtag->shiftIR(JPROGRAM, 6);
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(10000*12);
+	_jtag->waitUs(20000, 10000);
 
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
 	_jtag->toggleClk(2000);
@@ -264,7 +266,8 @@ void Xilinx::program(unsigned int offset, bool unprotect_flash)
 		return;
 	}
 
-	if (_mode == Device::MEM_MODE || _fpga_family == XCF_FAMILY)
+	/* SRAM load: bitstream is shifted MSB first by the interface */
+	if (_fpga_family == XCF_FAMILY)
 		reverse = true;
 
 	printInfo("Open file ", false);
@@ -314,6 +317,7 @@ void Xilinx::program(unsigned int offset, bool unprotect_flash)
 
 bool Xilinx::load_bridge()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_BRIDGE);
 	if (_device_package.empty()) {
 		printError("Can't program SPI flash: missing device-package information");
 		return false;
@@ -327,7 +331,7 @@ bool Xilinx::load_bridge()
 
 	/* first: load spi over jtag */
 	try {
-		BitParser bridge(bitname, true, _verbose);
+		BitParser bridge(bitname, false, _verbose);
 		bridge.parse();
 		if (_fpga_family == SPARTAN3_FAMILY)
 			xc3s_flow_program(&bridge);
@@ -381,7 +385,7 @@ void Xilinx::program_mem(ConfigBitstreamParser *bitfile)
 	 * 8: Move into the RTI state.                        X     0   10,000(1)
 	 */
 	_jtag->set_state(Jtag::RUN_TEST_IDLE);
-	_jtag->toggleClk(10000*12);
+	_jtag->waitUs(20000, 10000);
 	/*
 	 * 9: Start loading the CFG_IN instruction,
 	 *    LSB first:                                    00101   0   5
@@ -404,29 +408,15 @@ void Xilinx::program_mem(ConfigBitstreamParser *bitfile)
 	/* GGM: TODO */
 	int byte_length = bitfile->getLength() / 8;
 	uint8_t *data = bitfile->getData();
-	int tx_len, tx_end;
-	int burst_len = byte_length / 100;
 
 	ProgressBar progress("Flash SRAM", byte_length, 50, _quiet);
 
-	for (int i=0; i < byte_length; i+=burst_len) {
-		if (i + burst_len > byte_length) {
-			tx_len = (byte_length - i) * 8;
-			/*
-			 * 15: Enter UPDATE-DR state.                 X     1   1
-			 */
-			tx_end = Jtag::UPDATE_DR;
-		} else {
-			tx_len = burst_len * 8;
-	        /*
-	         * 12: Enter the SHIFT-DR state.              X     0   2
-	         */
-			tx_end = Jtag::SHIFT_DR;
-		}
-		_jtag->shiftDR(data+i, NULL, tx_len, tx_end);
-		_jtag->flush();
-		progress.display(i);
-	}
+	/*
+	 * 12: Enter the SHIFT-DR state.                  X     0   2
+	 * 15: Enter UPDATE-DR state.                     X     1   1
+	 */
+	_jtag->shiftDR_stream(data, byte_length, Jtag::UPDATE_DR,
+		[&progress](uint32_t done) { progress.display(done); }, true);
 	progress.done();
 	/*
 	 * 16: Move into RTI state.                           X     0   1
@@ -502,9 +492,7 @@ bool Xilinx::dumpFlash(uint32_t base_addr, uint32_t len)
 bool Xilinx::xc3s_flow_program(ConfigBitstreamParser *bit)
 {
 	int byte_length = bit->getLength() / 8;
-	int burst_len = byte_length / 100;
 	uint8_t *data = bit->getData();
-	int tx_len = burst_len * 8, tx_end = Jtag::SHIFT_DR;
 	ProgressBar progress("Flash SRAM", byte_length, 50, _quiet);
 
 	flow_enable();
@@ -525,18 +513,10 @@ bool Xilinx::xc3s_flow_program(ConfigBitstreamParser *bit)
 	if (_jtag->shiftIR(CFG_IN, _irlen) < 0)
 		return false;
 
-	for (int i = 0;byte_length > 0; byte_length-=burst_len, data+=burst_len) {
-		if (burst_len > byte_length) {
-			tx_len = byte_length * 8;
-			tx_end = Jtag::RUN_TEST_IDLE;
-		}
-		if (_jtag->shiftDR(data, NULL, tx_len, tx_end) < 0) {
-			progress.fail();
-			return false;
-		}
-		_jtag->flush();
-		progress.display(i);
-		i+= burst_len;
+	if (_jtag->shiftDR_stream(data, byte_length, Jtag::RUN_TEST_IDLE,
+			[&progress](uint32_t done) { progress.display(done); }, true) < 0) {
+		progress.fail();
+		return false;
 	}
 	progress.done();
 	_jtag->toggleClk(1);
@@ -746,7 +726,7 @@ std::string Xilinx::flow_read()
 	uint8_t mode;
 	std::string buffer;
 	uint8_t wr_buf[16+2];  // largest section length
-	uint8_t rd_buf[16+2];
+	uint8_t rd_buf[15][16+2];  // one section
 	memset(wr_buf, 0xff, 16);
 
 	/* limit JTAG clock frequency to 1MHz */
@@ -755,6 +735,9 @@ std::string Xilinx::flow_read()
 
 	ProgressBar progress("Read Flash", 108, 50, _quiet);
 
+	/* a full section is read before to resolve tdo */
+	_jtag->queue_begin();
+
 	for (size_t section = 0; section < 108; section++) {
 		uint16_t addr2 = section * 32;
 		for (int subsection = 0; subsection < 15; subsection++) {
@@ -770,13 +753,16 @@ std::string Xilinx::flow_read()
 
 			mode = 0;
 			_jtag->shiftDR(&mode, NULL, 2, Jtag::SHIFT_DR);
-			_jtag->shiftDR(NULL, rd_buf, 8 * (_xc95_line_len + 2));
-			for (int pos = 0; pos < _xc95_line_len; pos++)
-				buffer += rd_buf[pos];
+			_jtag->shiftDR(NULL, rd_buf[subsection], 8 * (_xc95_line_len + 2));
 			addr2 += ((subsection+1) % 0x05) ? 1 : 4;
 		}
+		_jtag->queue_flush();
+		for (int subsection = 0; subsection < 15; subsection++)
+			for (int pos = 0; pos < _xc95_line_len; pos++)
+				buffer += rd_buf[subsection][pos];
 		progress.display(section);
 	}
+	_jtag->queue_end();
 	progress.done();
 
 	return buffer;
@@ -807,6 +793,7 @@ void Xilinx::xcf_flow_enable(uint8_t mode)
 void Xilinx::xcf_flow_disable()
 {
 	_jtag->shiftIR(XCF_ISC_DISABLE, 8);
+	_jtag->flush();
 	usleep(110000);
 	_jtag->shiftIR(BYPASS, 8);
 	_jtag->toggleClk(1);
@@ -824,11 +811,13 @@ bool Xilinx::xcf_flow_erase()
 	_jtag->toggleClk(1);
 
 	_jtag->shiftIR(XCF_ISC_ERASE, 8);
+	_jtag->flush();
 	usleep(500000);
 
 	int i;
 	for (i = 0; i < 32; i++) {
 		_jtag->shiftIR(XCF_ISCTESTSTATUS, 8);
+		_jtag->flush();
 		usleep(500000);
 		_jtag->shiftDR(NULL, xfer_buf, 8);
 		if ((xfer_buf[0] & 0x04))
@@ -902,12 +891,14 @@ bool Xilinx::xcf_program(ConfigBitstreamParser *bitfile)
 
 		/* send program instruction */
 		_jtag->shiftIR(XCF_ISC_PROGRAM, 8);
+		_jtag->flush();
 		usleep((addr == 0) ? 14000: 500);
 
 		/* wait until bit 3 != 1 */
 		int i;
 		for (i = 0; i < 29; i++) {
 			_jtag->shiftIR(XCF_ISCTESTSTATUS, 8);
+			_jtag->flush();
 			usleep(500);
 			_jtag->shiftDR(NULL, tx_buf, 8);
 			if ((tx_buf[0] & 0x04))
@@ -995,6 +986,7 @@ std::string Xilinx::xcf_read()
 
 		/* send data to PROM */
 		_jtag->shiftIR(XCF_ISC_READ, 8);
+		_jtag->flush();
 		usleep(50);
 		_jtag->shiftDR(NULL, rx_buf, pkt_len * 8);
 
@@ -1299,25 +1291,24 @@ int Xilinx::spi_put(uint8_t cmd,
 			uint8_t *tx, uint8_t *rx, uint32_t len)
 {
 	int xfer_len = len + 1 + ((rx == NULL) ? 0 : 1);
-	uint8_t jtx[xfer_len];
-	jtx[0] = McsParser::reverseByte(cmd);
-	/* uint8_t jtx[xfer_len] = {McsParser::reverseByte(cmd)}; */
-	uint8_t jrx[xfer_len];
-	if (tx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			jtx[i+1] = McsParser::reverseByte(tx[i]);
-	}
+	std::vector<uint8_t> jtx(xfer_len);
+	jtx[0] = cmd;
+	std::vector<uint8_t> jrx(xfer_len);
+	if (tx != NULL)
+		memcpy(jtx.data() + 1, tx, len);
 	/* addr BSCAN user1 */
 	_jtag->shiftIR(USER1, 6);
 	/* send first already stored cmd,
 	 * in the same time store each byte
 	 * to next
 	 */
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
+	_jtag->shiftDR(jtx.data(), (rx == NULL)? NULL: jrx.data(), 8*xfer_len,
+		Jtag::RUN_TEST_IDLE, true);
 
+	/* SPI bytes are one bit late (BSCAN register) */
 	if (rx != NULL) {
 		for (uint32_t i=0; i < len; i++)
-			rx[i] = McsParser::reverseByte(jrx[i+1] >> 1) | (jrx[i+2] & 0x01);
+			rx[i] = (jrx[i+1] << 1) | (jrx[i+2] >> 7);
 	}
 	return 0;
 }
@@ -1325,55 +1316,77 @@ int Xilinx::spi_put(uint8_t cmd,
 int Xilinx::spi_put(uint8_t *tx, uint8_t *rx, uint32_t len)
 {
 	int xfer_len = len + ((rx == NULL) ? 0 : 1);
-	uint8_t jtx[xfer_len];
-	uint8_t jrx[xfer_len];
-	if (tx != NULL) {
-		for (uint32_t i=0; i < len; i++)
-			jtx[i] = McsParser::reverseByte(tx[i]);
-	}
+	std::vector<uint8_t> jtx(xfer_len);
+	std::vector<uint8_t> jrx(xfer_len);
+	if (tx != NULL)
+		memcpy(jtx.data(), tx, len);
 	/* addr BSCAN user1 */
 	_jtag->shiftIR(USER1, 6);
 	/* send first already stored cmd,
 	 * in the same time store each byte
 	 * to next
 	 */
-	_jtag->shiftDR(jtx, (rx == NULL)? NULL: jrx, 8*xfer_len);
+	_jtag->shiftDR(jtx.data(), (rx == NULL)? NULL: jrx.data(), 8*xfer_len,
+		Jtag::RUN_TEST_IDLE, true);
 
+	/* SPI bytes are one bit late (BSCAN register) */
 	if (rx != NULL) {
 		for (uint32_t i=0; i < len; i++)
-			rx[i] = McsParser::reverseByte(jrx[i] >> 1) | (jrx[i+1] & 0x01);
+			rx[i] = (jrx[i] << 1) | (jrx[i+1] >> 7);
 	}
 	return 0;
 }
 
+/* number of status reads queued before checking them */
+#define SPI_WAIT_BATCH 16
+
 int Xilinx::spi_wait(uint8_t cmd, uint8_t mask, uint8_t cond,
 			uint32_t timeout, bool verbose)
 {
-	uint8_t rx[2];
+	uint8_t rx[SPI_WAIT_BATCH][2];
 	uint8_t dummy[2];
-	uint8_t tmp;
-	uint8_t tx = McsParser::reverseByte(cmd);
+	uint8_t tmp = 0;
 	uint32_t count = 0;
+	bool done = false, match = false;
+	/* fail after timeout reads and timeout * SPI_WAIT_TRY_US: batched
+	 * reads are faster than one try, slow cables are slower
+	 */
+	auto deadline = std::chrono::steady_clock::now() +
+		std::chrono::microseconds(static_cast<uint64_t>(timeout) *
+		SPI_WAIT_TRY_US);
 
 	_jtag->shiftIR(USER1, 6, Jtag::UPDATE_IR);
-	_jtag->shiftDR(&tx, NULL, 8, Jtag::SHIFT_DR);
+	_jtag->shiftDR(&cmd, NULL, 8, Jtag::SHIFT_DR, true);
+
+	/* when the interface defers reads, status is polled by batch
+	 * with one round trip per batch
+	 */
+	int batch = (_jtag->queue_begin()) ? SPI_WAIT_BATCH : 1;
 
 	do {
-		_jtag->shiftDR(dummy, rx, 8*2, Jtag::SHIFT_DR);
-		tmp = (McsParser::reverseByte(rx[0]>>1)) | (0x01 & rx[1]);
-		count++;
-		if (count == timeout){
-			printf("timeout: %x %x %x\n", tmp, rx[0], rx[1]);
-			break;
+		for (int i = 0; i < batch; i++)
+			_jtag->shiftDR(dummy, rx[i], 8*2, Jtag::SHIFT_DR, true);
+		_jtag->queue_flush();
+		for (int i = 0; i < batch && !match; i++) {
+			tmp = (rx[i][0] << 1) | (rx[i][1] >> 7);
+			count++;
+			if (verbose) {
+				printf("%x %x %x %u\n", tmp, mask, cond, count);
+			}
+			match = ((tmp & mask) == cond);
 		}
-		if (verbose) {
-			printf("%x %x %x %u\n", tmp, mask, cond, count);
+		done = match;
+		if (!match && count >= timeout &&
+				std::chrono::steady_clock::now() >= deadline) {
+			printf("timeout: %x %u\n", tmp, count);
+			done = true;
 		}
-	} while ((tmp & mask) != cond);
-	_jtag->shiftDR(dummy, rx, 8*2, Jtag::EXIT1_DR);
+	} while (!done);
+	_jtag->shiftDR(dummy, rx[0], 8*2, Jtag::EXIT1_DR, true);
+	_jtag->queue_end();
 	_jtag->go_test_logic_reset();
 
-	if (count == timeout) {
+	if (!match) {
 		printf("%x\n", tmp);
 		std::cout << "wait: Error" << std::endl;
 		return -ETIME;
@@ -13,6 +13,7 @@
 
 #include "jedParser.hpp"
 #include "xilinxMapParser.hpp"
+#include "usbStats.hpp"
 
 using namespace std;
 
@@ -35,6 +36,7 @@ XilinxMapParser::XilinxMapParser(const string &filename,
  */
 int XilinxMapParser::parse()
 {
+	UsbStatsPhase phase(UsbStats::PHASE_PARSE);
 	int col = 0;
 	std::stringstream ss;
 	ss.str(_raw_data);